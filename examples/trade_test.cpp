@@ -17,7 +17,6 @@
 #include <iostream>
 #include <spdlog/spdlog.h>
 #include <td365/td365.h>
-#include <variant>
 #include <vector>
 
 struct candle_agg {
@@ -156,7 +155,7 @@ struct strategy {
             .stake = 1,
             .stop = t.ask - 10,
             .limit = t.ask + 10,
-            .key = t.hash,
+            .key = t.hash.str(),
         });
 
         if (response.accepted) {
@@ -175,7 +174,7 @@ struct strategy {
             .stake = 1,
             .stop = t.bid + 10,
             .limit = t.bid - 10,
-            .key = t.hash,
+            .key = t.hash.str(),
         });
 
         if (response.accepted) {
@@ -230,45 +229,8 @@ struct strategy {
     }
 
     void run() {
-        while (true) {
-            auto evt = client.wait();
-
-            bool should_exit = false;
-            std::visit(
-                [this, &should_exit](auto &&e) {
-                    using T = std::decay_t<decltype(e)>;
-                    if constexpr (std::is_same_v<T, td365::tick_event>) {
-                        spdlog::info("on_tick");
-                        on_tick(std::move(e.data));
-                    } else if constexpr (std::is_same_v<
-                                             T, td365::account_summary_event>) {
-                        on_account_summary(std::move(e.data));
-                    } else if constexpr (std::is_same_v<
-                                             T, td365::account_details_event>) {
-                        on_account_details(std::move(e.data));
-                    } else if constexpr (std::is_same_v<
-                                             T,
-                                             td365::trade_established_event>) {
-                        on_trade_established(std::move(e.data));
-                    } else if constexpr (std::is_same_v<T,
-                                                        td365::error_event>) {
-                        spdlog::error("Error: {}", e.message);
-                    } else if constexpr (std::is_same_v<
-                                             T,
-                                             td365::connection_closed_event>) {
-                        spdlog::info("Connection closed");
-                        should_exit = true;
-                    } else if constexpr (std::is_same_v<T,
-                                                        td365::timeout_event>) {
-                        // Timeout - continue waiting
-                    }
-                },
-                evt);
-
-            if (should_exit) {
-                break;
-            }
-        }
+        client.run(*this);
+        spdlog::info("Connection closed");
     }
 
     td365::td365 client;
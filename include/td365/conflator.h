@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <td365/quote_index.h>
+#include <td365/types.h>
+#include <vector>
+
+namespace td365 {
+
+struct conflation_options {
+    // Deliver each quote at most once per min_interval; newer ticks replace
+    // the held one in the meantime. Zero for no limit.
+    std::chrono::nanoseconds min_interval{0};
+};
+
+struct conflation_metrics {
+    // ticks fed in and handed out
+    std::uint64_t updates;
+    std::uint64_t delivered;
+    // ticks replaced by a newer tick of the same quote before delivery
+    std::uint64_t dropped;
+    // distinct quotes seen
+    std::size_t quotes;
+};
+
+// Latest-value table for a consumer that can't keep up with every tick.
+// update() overwrites each quote's slot and marks it dirty; take() returns
+// the newest tick of every dirty quote, in the order they first changed.
+// update() and take() may be called from different threads.
+class conflator {
+  public:
+    explicit conflator(const conflation_options &opts = {});
+
+    void update(std::span<const tick> ticks);
+
+    // Quotes held back by min_interval stay dirty for a later call. The
+    // span is valid until the next take().
+    std::span<const tick>
+    take(std::chrono::steady_clock::time_point now =
+             std::chrono::steady_clock::now());
+
+    // When the earliest quote held back by min_interval falls due, or
+    // time_point::max() if none is
+    std::chrono::steady_clock::time_point next_due() const;
+
+    // Whether the last take() held any quote back
+    bool holding() const;
+
+    conflation_metrics metrics() const;
+
+  private:
+    conflation_options opts_;
+
+    mutable std::mutex mutex_;
+    quote_index index_;
+    // per slot
+    std::vector<tick> latest_;
+    std::vector<std::uint8_t> dirty_;
+    std::vector<std::chrono::steady_clock::time_point> delivered_at_;
+    // dirty slots, oldest change first
+    std::vector<std::uint32_t> dirty_slots_;
+    std::vector<std::uint32_t> held_;
+    std::chrono::steady_clock::time_point next_due_ =
+        std::chrono::steady_clock::time_point::max();
+
+    std::uint64_t updates_ = 0;
+    std::uint64_t delivered_ = 0;
+    std::uint64_t dropped_ = 0;
+
+    // consumer side only
+    std::vector<tick> out_;
+};
+} // namespace td365
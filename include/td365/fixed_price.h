@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <string>
+#include <td365/verify.h>
+
+namespace td365 {
+
+inline constexpr std::array<std::int64_t, 19> pow10_table = [] {
+    std::array<std::int64_t, 19> arr{1};
+    for (size_t i = 1; i < arr.size(); ++i) {
+        arr[i] = arr[i - 1] * 10;
+    }
+    return arr;
+}();
+
+// 10^n for the 0..18 decimals a fixed_price can hold
+constexpr std::int64_t pow10_of(std::int32_t n) {
+    if (n < 0 || n >= static_cast<std::int32_t>(pow10_table.size())) {
+        throw fail("fixed_price: {} decimals is out of range", n);
+    }
+    return pow10_table[static_cast<size_t>(n)];
+}
+
+// Decimal price stored as mantissa * 10^-decimals, e.g. "104850.50" is
+// {10485050, 2}. Exact for comparisons and P&L, unlike double.
+struct fixed_price {
+    std::int64_t mantissa = 0;
+    std::int32_t decimals = 0;
+
+    constexpr double to_double() const {
+        return static_cast<double>(mantissa) /
+               static_cast<double>(pow10_of(decimals));
+    }
+
+    // Same value with `d` decimals. Dropped digits round half away from zero;
+    // throws if the mantissa would overflow.
+    constexpr fixed_price rescale(std::int32_t d) const {
+        pow10_of(d);
+        if (d >= decimals) {
+            auto mul = pow10_of(d - decimals);
+            if (mantissa > std::numeric_limits<std::int64_t>::max() / mul ||
+                mantissa < std::numeric_limits<std::int64_t>::min() / mul) {
+                throw fail("fixed_price: {} overflows at {} decimals",
+                           mantissa, d);
+            }
+            return {mantissa * mul, d};
+        }
+        auto div = pow10_of(decimals - d);
+        auto q = mantissa / div;
+        auto r = mantissa % div;
+        if (2 * (r < 0 ? -r : r) >= div) {
+            q += mantissa < 0 ? -1 : 1;
+        }
+        return {q, d};
+    }
+
+    static fixed_price from_double(double value, std::int32_t decimals);
+
+    std::string to_string() const;
+
+    friend constexpr std::strong_ordering operator<=>(fixed_price a,
+                                                      fixed_price b) {
+        auto d = std::max(a.decimals, b.decimals);
+        return a.rescale(d).mantissa <=> b.rescale(d).mantissa;
+    }
+
+    friend constexpr bool operator==(fixed_price a, fixed_price b) {
+        return (a <=> b) == 0;
+    }
+
+    friend constexpr fixed_price operator+(fixed_price a, fixed_price b) {
+        auto d = std::max(a.decimals, b.decimals);
+        return {a.rescale(d).mantissa + b.rescale(d).mantissa, d};
+    }
+
+    friend constexpr fixed_price operator-(fixed_price a, fixed_price b) {
+        auto d = std::max(a.decimals, b.decimals);
+        return {a.rescale(d).mantissa - b.rescale(d).mantissa, d};
+    }
+};
+
+std::ostream &operator<<(std::ostream &os, const fixed_price &p);
+
+} // namespace td365
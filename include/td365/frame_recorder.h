@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace td365 {
+
+// Capture file layout, all little-endian as written by the host:
+//
+//   file_header, then records back to back, each
+//   record_header + payload, padded to 8 bytes
+//
+// Files are preallocated and zero-filled, so a zeroed record_header (no
+// direction) marks the end, including after a crash mid-file.
+namespace capture {
+inline constexpr char magic[8] = {'T', 'D', '3', '6', '5', 'C', 'A', 'P'};
+inline constexpr std::uint32_t version = 1;
+
+enum class direction : std::uint8_t { none = 0, inbound = 1, outbound = 2 };
+
+struct file_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    // system_clock at file creation, to place the steady stamps in time
+    std::int64_t created_unix_ns;
+    std::int64_t created_steady_ns;
+};
+
+struct record_header {
+    // payload bytes
+    std::uint32_t size;
+    // none ends the file
+    direction dir;
+    std::uint8_t reserved[3];
+    // steady_clock when the frame was read or queued
+    std::int64_t steady_ns;
+};
+
+static_assert(sizeof(file_header) == 32);
+static_assert(sizeof(record_header) == 16);
+} // namespace capture
+
+struct capture_options {
+    std::filesystem::path directory = ".";
+    // files are named <prefix>-<unix ms>-<n>.cap
+    std::string prefix = "td365";
+    // start a new file once the current one would grow past this...
+    std::size_t max_file_size = std::size_t{256} << 20;
+    // ...or has been open this long
+    std::optional<std::chrono::seconds> max_file_age;
+};
+
+struct capture_metrics {
+    std::uint64_t frames;
+    std::uint64_t bytes;
+    std::uint64_t files;
+};
+
+// Appends every frame to a memory-mapped capture file: a header and a
+// memcpy per frame, no syscalls until the file is full. Not thread-safe;
+// use from the thread running the connection. metrics() may be called from
+// anywhere.
+class frame_recorder {
+  public:
+    explicit frame_recorder(capture_options opts);
+    ~frame_recorder();
+
+    frame_recorder(const frame_recorder &) = delete;
+    frame_recorder &operator=(const frame_recorder &) = delete;
+
+    void record(capture::direction dir, std::string_view payload) {
+        record(dir, payload, std::chrono::steady_clock::now());
+    }
+
+    void record(capture::direction dir, std::string_view payload,
+                std::chrono::steady_clock::time_point at);
+
+    // Close the current file and start the next one
+    void rotate();
+
+    // Push written frames to disk; the kernel does this lazily otherwise
+    void flush();
+
+    const std::filesystem::path &current_file() const { return path_; }
+
+    capture_metrics metrics() const;
+
+  private:
+    // open and map the next file, big enough for at least `min_size`
+    void open_next(std::size_t min_size);
+    void close_current();
+
+    capture_options opts_;
+    std::filesystem::path path_;
+    int fd_ = -1;
+    char *map_ = nullptr;
+    std::size_t map_size_ = 0;
+    std::size_t offset_ = 0;
+    std::chrono::steady_clock::time_point opened_at_{};
+    std::uint64_t file_index_ = 0;
+
+    std::atomic<std::uint64_t> frames_{0};
+    std::atomic<std::uint64_t> bytes_{0};
+    std::atomic<std::uint64_t> files_{0};
+};
+
+struct captured_frame {
+    capture::direction dir;
+    std::chrono::steady_clock::time_point at;
+    // points into the mapped file, valid while the reader lives
+    std::string_view payload;
+};
+
+// Reads one capture file back, frame by frame
+class capture_reader {
+  public:
+    explicit capture_reader(const std::filesystem::path &path);
+    ~capture_reader();
+
+    capture_reader(const capture_reader &) = delete;
+    capture_reader &operator=(const capture_reader &) = delete;
+
+    const capture::file_header &header() const { return header_; }
+
+    // std::nullopt at the end of the file
+    std::optional<captured_frame> next();
+
+  private:
+    void close();
+
+    int fd_ = -1;
+    const char *map_ = nullptr;
+    std::size_t map_size_ = 0;
+    std::size_t offset_ = 0;
+    capture::file_header header_{};
+};
+} // namespace td365
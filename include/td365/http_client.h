@@ -12,6 +12,7 @@
 #include <boost/beast/http/message.hpp>
 #include <boost/beast/ssl.hpp>
 #include <map>
+#include <memory>
 #include <string>
 #include <td365/cookiejar.h>
 #include <td365/http.h>
@@ -23,6 +24,10 @@ extern http_headers const application_json_headers;
 struct http_client {
     http_client(boost::urls::url url);
 
+    // Open sockets on `ioc`, which may be shared with other clients and
+    // threads. Requests are synchronous, so it needn't be running.
+    http_client(boost::urls::url url, boost::asio::io_context &ioc);
+
     virtual ~http_client() = default;
 
     http_client(const http_client &) = delete;
@@ -54,7 +59,9 @@ struct http_client {
                        std::optional<std::string> body,
                        std::optional<http_headers> headers);
 
-    boost::asio::io_context io_context_;
+    // null when the io_context was passed in
+    std::unique_ptr<boost::asio::io_context> own_io_;
+    boost::asio::io_context &io_context_;
     using stream_t = boost::asio::ssl::stream<boost::asio::ip::tcp::socket>;
     stream_t stream_;
 
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <td365/conflator.h>
+#include <td365/latency.h>
+#include <td365/spsc_ring.h>
+#include <td365/types.h>
+#include <td365/wake_signal.h>
+#include <thread>
+#include <vector>
+
+namespace td365 {
+
+class session_pool;
+class ws_client;
+
+struct ring_metrics {
+    std::size_t depth;
+    std::size_t capacity;
+    std::size_t high_water;
+    // tick batches discarded because the consumer let the ring fill up.
+    // Their quotes are stale until they next tick; use conflation to
+    // always have the latest price instead.
+    std::uint64_t dropped_batches;
+};
+
+// Runs a connected ws_client on its own thread. Heartbeats are answered and
+// frames decoded there; events are handed to a single consumer through an
+// spsc_ring. The ws_client must not be used directly while this is running,
+// go through post() instead.
+class io_thread {
+  public:
+    using command = std::function<void(ws_client &)>;
+
+    // housekeeping runs on the I/O thread after every read, so it must be
+    // cheap when it has nothing to do. With a conflator, ticks bypass the
+    // ring and wait()/try_pop() hand out its changed quotes instead.
+    // `also_notify` is notified along with wait()'s own wake-up, for a
+    // consumer of several io_threads to block on.
+    io_thread(ws_client &client, std::size_t capacity,
+              std::function<void()> housekeeping = {},
+              conflator *conflate = nullptr,
+              wake_signal *also_notify = nullptr);
+
+    // Instead of a thread of its own, share the session_pool thread that
+    // runs the client's io_context; the client must have been made with
+    // one from session_pool::context(). The pool must outlive this.
+    io_thread(ws_client &client, session_pool &pool, std::size_t capacity,
+              std::function<void()> housekeeping = {},
+              conflator *conflate = nullptr);
+
+    ~io_thread();
+
+    // Blocks until an event is available. Returns timeout_event if none
+    // arrives within `timeout`, and connection_closed_event once the ring
+    // is drained and the thread has stopped. The returned event (and the
+    // span of a tick_batch_event) is valid until the next wait()/try_pop().
+    event wait(std::optional<std::chrono::milliseconds> timeout);
+
+    std::optional<event> try_pop();
+
+    // Run `cmd` against the ws_client on the I/O thread. If it throws, the
+    // exception is handed to the consumer as an error_event.
+    void post(command cmd);
+
+    ring_metrics metrics() const;
+
+    // false once the connection has closed or failed for good; the event
+    // saying so may still be in the ring
+    bool running() const { return running_.load(std::memory_order_acquire); }
+
+  private:
+    friend class session_pool;
+
+    enum class step_result { idle, busy, done };
+
+    struct slot {
+        event evt;
+        // owns the ticks of a tick_batch_event, evt.data points here
+        std::vector<tick> ticks;
+        // and evt.exact here, in price_mode::fixed
+        std::vector<tick_prices> exact;
+        // no event, just a wake-up: conflated ticks are waiting
+        bool conflated = false;
+        // for parse_to_delivery, when the client records latency
+        std::chrono::system_clock::time_point decoded_at{};
+    };
+
+    void run(std::stop_token stop);
+    // Read and hand on at most one event, waiting up to `timeout`. done
+    // once the connection has closed or failed for good.
+    step_result step(std::chrono::milliseconds timeout,
+                     const std::stop_token &stop);
+    // step() has something to do without waiting
+    bool ready() const;
+    void push(event &&evt, const std::stop_token &stop);
+    // hand on what fits of deferred_; true once it is empty
+    bool flush_deferred();
+    // no more events will be pushed; wakes a blocked wait()
+    void stopped();
+    void notify();
+    // a command that throws is reported as an error_event
+    void drain_commands(const std::stop_token &stop);
+    event take_front();
+    // the next event, if one is ready
+    std::optional<event> next();
+
+    ws_client &client_;
+    spsc_ring<slot> ring_;
+    std::function<void()> housekeeping_;
+    std::atomic<std::uint64_t> dropped_batches_{0};
+    std::atomic<bool> running_{true};
+    // Pooled only: control events that found the ring full, in order. The
+    // pool thread's other sessions can't wait for this one's consumer, so
+    // later steps hand these on as room frees up. I/O thread only.
+    std::deque<event> deferred_;
+    // the connection has ended; running_ is cleared once deferred_ drains
+    bool closing_ = false;
+    // notified on every push and when the thread stops
+    wake_signal wakeup_;
+    wake_signal *also_notify_ = nullptr;
+
+    conflator *conflator_;
+    latency_recorder *latency_;
+    // a wake-up slot is in the ring and hasn't been consumed yet
+    std::atomic<bool> conflated_signalled_{false};
+
+    // slot handed out by the last wait()/try_pop(), popped on the next call
+    bool front_taken_ = false;
+
+    std::mutex commands_mutex_;
+    std::vector<command> commands_;
+    std::atomic<bool> has_commands_{false};
+    // an own thread waits on this for the command that connects the client
+    std::condition_variable_any commands_posted_;
+
+    session_pool *pool_ = nullptr;
+    // not started when pooled
+    std::jthread thread_;
+};
+} // namespace td365
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <td365/quote_index.h>
+#include <td365/types.h>
+#include <vector>
+
+namespace td365 {
+
+// Point-in-time copy of a latency_histogram
+struct latency_snapshot {
+    std::uint64_t count = 0;
+    std::chrono::nanoseconds min{};
+    std::chrono::nanoseconds max{};
+    std::chrono::nanoseconds mean{};
+    // per-bucket counts, see latency_histogram::bucket_lower()
+    std::vector<std::uint64_t> buckets;
+
+    // Upper bound of the bucket holding the p-th percentile (0-100),
+    // capped at max
+    std::chrono::nanoseconds percentile(double p) const;
+
+    // "n=... min=... p50=... p90=... p99=... p99.9=... max=..." in
+    // microseconds
+    std::string summary() const;
+};
+
+// HDR-style histogram of nanosecond durations: exact below 16ns, then 16
+// linear sub-buckets per power of two, so any value is within ~6% of its
+// bucket. Values from 2^40ns (about 18 minutes) up share the last bucket,
+// negative ones (clock skew) count as 0. record() is lock-free and may be
+// called from several threads.
+class latency_histogram {
+  public:
+    static constexpr int sub_bucket_bits = 4;
+    // highest power of two with buckets of its own
+    static constexpr int max_magnitude = 39;
+    static constexpr std::size_t bucket_count =
+        std::size_t{max_magnitude - sub_bucket_bits + 2} << sub_bucket_bits;
+
+    latency_histogram() = default;
+
+    latency_histogram(const latency_histogram &) = delete;
+    latency_histogram &operator=(const latency_histogram &) = delete;
+
+    void record(std::chrono::nanoseconds value);
+
+    latency_snapshot snapshot() const;
+
+    // Not atomic with respect to concurrent record() calls; a value
+    // recorded meanwhile may be partly kept
+    void reset();
+
+    static std::size_t bucket_of(std::uint64_t ns);
+    static std::uint64_t bucket_lower(std::size_t bucket);
+
+  private:
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets_{};
+    std::atomic<std::uint64_t> sum_{0};
+    std::atomic<std::uint64_t> min_{~std::uint64_t{0}};
+    std::atomic<std::uint64_t> max_{0};
+};
+
+enum class latency_stage {
+    // tick::timestamp to the frame being read off the socket, per tick
+    server_to_receive,
+    // frame read to its ticks being decoded, per frame
+    receive_to_parse,
+    // decoded to handed to the caller, per batch
+    parse_to_delivery,
+    // with kernel receive timestamps (td365::set_rx_timestamps) the first
+    // stage splits in two: tick::timestamp to the kernel's receive time,
+    // per tick
+    server_to_wire,
+    // kernel receive time to the frame being read, per frame
+    wire_to_receive,
+    _count
+};
+
+// Totals for each stage, plus server_to_receive per quote for the first
+// `max_quotes` quotes seen
+class latency_recorder {
+  public:
+    explicit latency_recorder(std::size_t max_quotes = 512);
+
+    // server_to_receive for each tick of a frame read at `received`
+    void record_ticks(std::span<const tick> ticks,
+                      std::chrono::system_clock::time_point received);
+
+    void record(latency_stage stage, std::chrono::nanoseconds value) {
+        stages_[static_cast<std::size_t>(stage)].record(value);
+    }
+
+    // Any thread
+    latency_snapshot snapshot(latency_stage stage) const;
+
+    // server_to_receive of one quote, std::nullopt if it isn't tracked
+    std::optional<latency_snapshot> snapshot(int quote_id) const;
+
+    void reset();
+
+  private:
+    static constexpr auto stage_count =
+        static_cast<std::size_t>(latency_stage::_count);
+
+    struct per_quote {
+        int quote_id = 0;
+        latency_histogram histogram;
+    };
+
+    std::array<latency_histogram, stage_count> stages_;
+    std::unique_ptr<per_quote[]> quotes_;
+    std::size_t max_quotes_;
+    // recording thread only; holds at most max_quotes_ quotes
+    quote_index index_;
+    // quotes_[0, used_) are in use; published by the recording thread
+    std::atomic<std::size_t> used_{0};
+};
+} // namespace td365
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <boost/url/url.hpp>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <td365/timestamped_stream.h>
+#include <td365/transport.h>
+#include <utility>
+
+namespace td365 {
+
+// ws connects URLs with this scheme in-process, see memory_server
+inline constexpr std::string_view memory_scheme = "memory";
+
+class memory_connection;
+
+namespace detail {
+// what a memory_server and its connections share, so connections can
+// outlive the server
+struct memory_endpoint {
+    std::function<void(memory_connection &)> on_open;
+    std::function<void(memory_connection &, std::string_view)> on_frame;
+    std::atomic<std::size_t> connections{0};
+};
+} // namespace detail
+
+// The server end of one in-process connection
+class memory_connection
+    : public std::enable_shared_from_this<memory_connection> {
+  public:
+    explicit memory_connection(std::shared_ptr<detail::memory_endpoint> ep)
+        : endpoint_(std::move(ep)) {}
+
+    // Queue a frame for the client. Safe to call from any thread.
+    void send(std::string frame);
+
+    // The client reads a normal close once it has read what was queued
+    void close();
+
+    // The client's next read fails as if the connection was reset
+    void drop();
+
+    // false once the client went away
+    bool is_open() const;
+
+  private:
+    friend class memory_transport;
+
+    enum class state { open, closed, dropped, aborted };
+
+    // client side, under mutex_
+    void attach(boost::asio::io_context &ioc, boost::asio::steady_timer &t);
+    void detach();
+    // a queued frame into `buffer`, or the error that ends the connection;
+    // std::nullopt while there is nothing to read
+    std::optional<std::pair<boost::system::error_code, std::size_t>>
+    receive(boost::beast::flat_buffer &buffer);
+    void deliver(std::string_view frame);
+    // have a waiting read look again
+    void wake();
+
+    std::shared_ptr<detail::memory_endpoint> endpoint_;
+
+    mutable std::mutex mutex_;
+    std::deque<std::string> inbound_;
+    state state_ = state::open;
+    bool wake_posted_ = false;
+    boost::asio::io_context *ioc_ = nullptr;
+    boost::asio::steady_timer *signal_ = nullptr;
+};
+
+// In-process stand-in for a websocket server: ws connects to
+// memory://<name> without sockets. The handlers run on the client's
+// thread, from inside its connect() and read_message().
+class memory_server {
+  public:
+    // Listen on memory://<name> until destroyed
+    explicit memory_server(std::string name);
+    ~memory_server();
+
+    memory_server(const memory_server &) = delete;
+    memory_server &operator=(const memory_server &) = delete;
+
+    // Called as a client connects, before connect() returns
+    void on_open(std::function<void(memory_connection &)> handler) {
+        endpoint_->on_open = std::move(handler);
+    }
+
+    // Called with each frame a client writes
+    void on_frame(
+        std::function<void(memory_connection &, std::string_view)> handler) {
+        endpoint_->on_frame = std::move(handler);
+    }
+
+    std::string url() const;
+
+    std::size_t connections() const { return endpoint_->connections.load(); }
+
+  private:
+    std::string name_;
+    std::shared_ptr<detail::memory_endpoint> endpoint_;
+};
+
+// The client end of a connection to a memory_server
+class memory_transport {
+  public:
+    explicit memory_transport(boost::asio::io_context &ioc)
+        : ioc_(ioc), signal_(ioc) {}
+    ~memory_transport();
+
+    memory_transport(const memory_transport &) = delete;
+    memory_transport &operator=(const memory_transport &) = delete;
+
+    // Connect to the memory_server named by the host of `url`
+    void connect(const boost::urls::url &url);
+
+    template <typename Handler>
+    void async_read(boost::beast::flat_buffer &buffer, Handler &&handler) {
+        read(buffer, std::forward<Handler>(handler), false);
+    }
+
+    template <typename Handler>
+    void async_write(boost::asio::const_buffer frame, Handler &&handler) {
+        boost::asio::post(ioc_, [this, frame,
+                                 h = std::forward<Handler>(handler)]() mutable {
+            if (!conn_ || !conn_->is_open()) {
+                h(boost::asio::error::not_connected, 0);
+                return;
+            }
+            conn_->deliver(std::string_view(
+                static_cast<const char *>(frame.data()), frame.size()));
+            h(boost::system::error_code{}, frame.size());
+        });
+    }
+
+    template <typename Handler> void async_close(Handler &&handler) {
+        abort();
+        boost::asio::post(ioc_, [h = std::forward<Handler>(handler)]() mutable {
+            h(boost::system::error_code{}, 0);
+        });
+    }
+
+    void abort();
+
+    std::optional<rx_time> last_received() const { return std::nullopt; }
+
+  private:
+    // wait on signal_ until the connection has something for us
+    template <typename Handler>
+    void read(boost::beast::flat_buffer &buffer, Handler &&handler,
+              bool in_handler) {
+        auto result = conn_ ? conn_->receive(buffer)
+                            : std::make_optional(std::make_pair(
+                                  boost::system::error_code(
+                                      boost::asio::error::not_connected),
+                                  std::size_t{0}));
+        if (!result) {
+            signal_.expires_at(std::chrono::steady_clock::time_point::max());
+            signal_.async_wait([this, &buffer,
+                                h = std::forward<Handler>(handler)](
+                                   boost::system::error_code) mutable {
+                read(buffer, std::move(h), true);
+            });
+            return;
+        }
+        auto [ec, n] = *result;
+        if (in_handler) {
+            handler(ec, n);
+            return;
+        }
+        boost::asio::post(ioc_, [h = std::forward<Handler>(handler), ec,
+                                 n]() mutable { h(ec, n); });
+    }
+
+    boost::asio::io_context &ioc_;
+    boost::asio::steady_timer signal_;
+    std::shared_ptr<memory_connection> conn_;
+};
+
+static_assert(TransportLike<memory_transport>);
+} // namespace td365
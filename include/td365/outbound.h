@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <array>
+#include <boost/asio/buffer.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace td365 {
+
+// Raw JSON text of a heartbeat's "d" members, spliced unchanged into the
+// reply. Views point into the received frame.
+struct heartbeat_fields {
+    std::string_view sent_by_server;
+    std::string_view messages_received;
+    std::string_view prices_received;
+    std::string_view messages_sent;
+    std::string_view prices_sent;
+};
+
+// Encodes the fixed-schema outbound messages without a JSON DOM. Output is
+// byte for byte what nlohmann::json::dump() produced for the same message
+// (keys sorted). Returned views/buffers are valid until the next call.
+class outbound_encoder {
+  public:
+    std::string_view subscribe(int quote_id);
+
+    std::string_view unsubscribe(int quote_id);
+
+    // Subscribe to account summary and account details updates
+    static std::string_view account_options();
+
+    // Gather list for the heartbeat reply. Nothing is copied: the list
+    // references `f`, which must stay valid until it has been sent.
+    std::span<const boost::asio::const_buffer>
+    heartbeat(const heartbeat_fields &f);
+
+  private:
+    std::string_view quote_action(std::string_view action, int quote_id);
+
+    std::string buffer_;
+    std::array<boost::asio::const_buffer, 11> gather_;
+};
+} // namespace td365
@@ -9,8 +9,10 @@
 
 #include <optional>
 #include <string_view>
+#include <td365/outbound.h>
 #include <td365/td365.h>
 #include <unordered_map>
+#include <vector>
 
 namespace td365 {
 static const std::unordered_map<std::string_view, grouping> grouping_map = {
@@ -40,7 +42,31 @@ grouping string_to_price_type(std::string_view key);
 // Parse tick from a comma-separated string
 // Format:
 // "quote_id,bid,ask,daily_change,direction,field6,high,low,hash,field10,mid_price,timestamp,field13"
-tick parse_td_tick(std::string_view price_string, grouping price_type);
+// With `exact`, prices go through the fixed-point parser, the doubles are
+// derived from it and the exact values are stored in `*exact`.
+tick parse_td_tick(std::string_view price_string, grouping price_type,
+                   tick_prices *exact = nullptr);
 
-candle parse_candle(std::string_view candle_string);
+// Parse a plain decimal ("-104850.50") straight into a scaled mantissa, keeping
+// as many decimals as the string has.
+fixed_price parse_fixed_price(std::string_view s);
+
+// Fast path for {"t":"p","d":{"sp":["...",...]}} frames. Walks the
+// gp/sp/dp/c1m arrays in place and parses each price straight into `out`
+// without building a JSON DOM. Returns false (with `out` cleared) when the
+// frame isn't a price frame or has a shape the scanner doesn't handle, e.g.
+// escaped strings; callers should then fall back to nlohmann::json.
+// With `exact`, it gets the exact prices of out[i] at (*exact)[i], as
+// parse_td_tick does.
+bool parse_price_frame(std::string_view frame, std::vector<tick> &out,
+                       std::vector<tick_prices> *exact = nullptr);
+
+// Fast path for {"t":"heartbeat","d":{...}} frames: points `out` at the raw
+// JSON text of the counters the reply has to echo. Returns false for any
+// other frame, or one the scanner can't handle.
+bool parse_heartbeat_frame(std::string_view frame, heartbeat_fields &out);
+
+// With `exact`, as parse_td_tick
+candle parse_candle(std::string_view candle_string,
+                    candle_prices *exact = nullptr);
 } // namespace td365
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <td365/types.h>
+#include <vector>
+
+namespace td365 {
+
+// Latest tick of every quote, written by the decoding thread and readable
+// from any other thread without locks. Each slot is a seqlock: the writer
+// never waits, a reader retries only if it overlapped a write of the same
+// quote.
+//
+// Capacity is fixed up front since readers probe the table concurrently;
+// quotes beyond it are counted in overflow() and not cached.
+class quote_cache {
+  public:
+    explicit quote_cache(std::size_t max_quotes = 4096);
+
+    quote_cache(const quote_cache &) = delete;
+    quote_cache &operator=(const quote_cache &) = delete;
+
+    // Writer side, one thread only
+    void update(std::span<const tick> ticks);
+    void update(const tick &t);
+
+    // Any thread. std::nullopt if no tick for `quote_id` was seen yet.
+    std::optional<tick> get_quote(int quote_id) const;
+
+    std::size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+    std::uint64_t overflow() const {
+        return overflow_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static constexpr int empty_key = std::numeric_limits<int>::min();
+    static constexpr std::size_t words =
+        (sizeof(tick) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    // one cache line per slot header so neighbouring quotes don't share
+    struct alignas(64) slot {
+        std::atomic<int> quote_id{empty_key};
+        // odd while a write is in progress
+        std::atomic<std::uint32_t> seq{0};
+        // the tick, copied word by word so concurrent reads aren't a race
+        std::array<std::atomic<std::uint64_t>, words> data{};
+    };
+
+    std::size_t home(int quote_id) const;
+
+    // index of the slot holding `quote_id`, or of the empty slot where it
+    // would go
+    std::size_t find(int quote_id) const;
+
+    std::vector<slot> slots_;
+    std::size_t max_quotes_;
+    int shift_;
+    std::atomic<std::size_t> size_{0};
+    std::atomic<std::uint64_t> overflow_{0};
+};
+} // namespace td365
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace td365 {
+
+// Maps sparse quote ids onto dense slots 0, 1, 2, ... in the order they are
+// first seen, so per-quote state can live in a plain vector indexed by
+// slot. Open addressing with linear probing, kept at most half full.
+class quote_index {
+  public:
+    static constexpr std::uint32_t npos = ~std::uint32_t{0};
+
+    explicit quote_index(std::size_t expected_quotes = 64) {
+        resize(std::bit_ceil(std::max<std::size_t>(expected_quotes * 2, 16)));
+    }
+
+    // Slot of `quote_id`, assigning the next free one if it is new
+    std::uint32_t insert(int quote_id) {
+        auto i = probe(quote_id);
+        if (table_[i].slot != npos) {
+            return table_[i].slot;
+        }
+        if ((size_ + 1) * 2 > table_.size()) {
+            resize(table_.size() * 2);
+            i = probe(quote_id);
+        }
+        auto slot = static_cast<std::uint32_t>(size_++);
+        table_[i] = {quote_id, slot};
+        return slot;
+    }
+
+    // Slot of `quote_id`, or npos
+    std::uint32_t find(int quote_id) const {
+        return table_[probe(quote_id)].slot;
+    }
+
+    std::size_t size() const { return size_; }
+
+  private:
+    struct entry {
+        int quote_id = 0;
+        std::uint32_t slot = npos;
+    };
+
+    std::size_t probe(int quote_id) const {
+        // Fibonacci hashing: quote ids tend to come in runs, the multiply
+        // spreads them across the table
+        auto key = static_cast<std::uint32_t>(quote_id);
+        auto h = static_cast<std::uint64_t>(key) * 0x9e3779b97f4a7c15ULL;
+        auto i = static_cast<std::size_t>(h >> shift_);
+        auto mask = table_.size() - 1;
+        while (table_[i].slot != npos && table_[i].quote_id != quote_id) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    void resize(std::size_t capacity) {
+        std::vector<entry> old(capacity);
+        old.swap(table_);
+        shift_ = 64 - std::countr_zero(capacity);
+        for (const auto &e : old) {
+            if (e.slot != npos) {
+                table_[probe(e.quote_id)] = e;
+            }
+        }
+    }
+
+    std::vector<entry> table_;
+    int shift_ = 0;
+    std::size_t size_ = 0;
+};
+} // namespace td365
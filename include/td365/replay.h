@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <td365/frame_recorder.h>
+#include <vector>
+
+namespace td365 {
+
+struct replay_options {
+    // capture files, played in order, see capture_files()
+    std::vector<std::filesystem::path> files;
+    // 0 plays frames as fast as they are read; otherwise the recorded gaps
+    // are kept, divided by `speed` (2.0 plays twice as fast). Gaps between
+    // files are wall-clock time, so files from different runs keep theirs
+    // too.
+    double speed = 0.0;
+};
+
+// Capture files written by frame_recorder in `directory`, oldest first
+std::vector<std::filesystem::path>
+capture_files(const std::filesystem::path &directory,
+              const std::string &prefix = "td365");
+
+// An inbound frame and when to play it
+struct replay_frame {
+    std::chrono::steady_clock::time_point due;
+    // valid until the next replay_feed::next()
+    std::string_view payload;
+};
+
+// Plays back the inbound frames of capture files; outbound ones are
+// skipped. Read through replay_transport, see ws_client::replay.
+class replay_feed {
+  public:
+    explicit replay_feed(replay_options opts);
+    ~replay_feed();
+
+    replay_feed(const replay_feed &) = delete;
+    replay_feed &operator=(const replay_feed &) = delete;
+
+    // The next frame, std::nullopt at the end of the last file. Frames are
+    // due at once unless paced; the first paced frame sets the clock.
+    std::optional<replay_frame> next();
+
+  private:
+    // the next inbound frame of any file, without pacing
+    std::optional<captured_frame> advance();
+
+    replay_options opts_;
+    std::size_t file_index_ = 0;
+    std::unique_ptr<capture_reader> reader_;
+
+    // pacing: wall time the first frame was recorded at, since the epoch,
+    // and when it was played
+    std::optional<std::chrono::nanoseconds> origin_;
+    std::chrono::steady_clock::time_point started_{};
+};
+} // namespace td365
@@ -29,6 +29,9 @@ class rest_api : public std::enable_shared_from_this<rest_api> {
     enum session_token_response { RETRY, FAILURE, LOGOUT, OK };
 
     explicit rest_api();
+
+    // Make HTTP connections on `ioc` instead of an io_context per client
+    explicit rest_api(boost::asio::io_context &ioc);
     ~rest_api();
 
     // `connect` simulates opening the web client page. Returns a token used to
@@ -40,13 +43,19 @@ class rest_api : public std::enable_shared_from_this<rest_api> {
     auto get_market_quote(int group_id) -> std::vector<market>;
     auto get_market_details(int market_id) -> market_details_response;
     // auto get_chart_url(int market_id) -> boost::urls::url;
-    auto backfill(int market_id, int quote_id, size_t sz, chart_duration dur)
+    // with `exact`, it gets the exact prices of the i-th candle at
+    // (*exact)[i]
+    auto backfill(int market_id, int quote_id, size_t sz, chart_duration dur,
+                  std::vector<candle_prices> *exact = nullptr)
         -> std::vector<candle>;
     auto trade(const trade_request &request) -> trade_response;
     auto sim_trade(const trade_request &request) -> void;
     auto update_client_session_id() -> void;
 
   private:
+    auto make_client(boost::urls::url url) -> std::unique_ptr<http_client>;
+
+    boost::asio::io_context *io_context_ = nullptr;
     std::unique_ptr<http_client> client_;
     std::string account_id_;
     std::string get_market_details_url_;
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <td365/quote_index.h>
+#include <td365/types.h>
+#include <vector>
+
+namespace td365 {
+
+struct sequence_metrics {
+    std::uint64_t ticks;
+    // forward jumps of more than one, and the sequence numbers they skipped
+    std::uint64_t gaps;
+    std::uint64_t missed;
+    // the quote's last sequence number again
+    std::uint64_t duplicates;
+    // older than the quote's last sequence number
+    std::uint64_t out_of_order;
+};
+
+// Checks tick::field13, which counts up by one per quote, for loss and
+// reordering. Only the highest sequence number seen per quote is kept.
+class sequence_tracker {
+  public:
+    // Check a batch. Gaps are appended to `gaps` when it is non-null.
+    void check(std::span<const tick> ticks, std::vector<gap_event> *gaps);
+
+    // Safe to call from any thread
+    sequence_metrics metrics() const;
+
+  private:
+    quote_index index_;
+    // highest sequence per slot
+    std::vector<int> last_;
+
+    // only the decoding thread writes these
+    std::atomic<std::uint64_t> ticks_{0};
+    std::atomic<std::uint64_t> gaps_{0};
+    std::atomic<std::uint64_t> missed_{0};
+    std::atomic<std::uint64_t> duplicates_{0};
+    std::atomic<std::uint64_t> out_of_order_{0};
+};
+} // namespace td365
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace td365 {
+
+class io_thread;
+
+// A few threads that read and decode the connections of many sessions
+// between them, instead of a blocking thread per session. Each thread runs
+// one io_context: make a session on context(), then start its io_thread on
+// the pool (td365::start_io_thread(session_pool &)). Its frames are then
+// read by that thread along with the others on the same io_context, and
+// consumed through wait()/try_pop() as usual.
+//
+// A session's reconnects run on the pool thread too, so a slow handshake
+// holds up the thread's other sessions for that long; session refresh has
+// a thread of its own. A consumer that falls behind doesn't: its ticks are
+// dropped and its other events held by its session until the ring has
+// room. The pool must outlive its sessions.
+class session_pool {
+  public:
+    explicit session_pool(std::size_t threads);
+
+    ~session_pool();
+
+    session_pool(const session_pool &) = delete;
+    session_pool &operator=(const session_pool &) = delete;
+
+    // The io_context to make the next session on, round-robin over the
+    // threads
+    boost::asio::io_context &context();
+
+    std::size_t threads() const { return workers_.size(); }
+
+    // sessions running on each thread
+    std::vector<std::size_t> sessions() const;
+
+  private:
+    friend class io_thread;
+
+    struct worker {
+        boost::asio::io_context ioc;
+        boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+            guard{ioc.get_executor()};
+        std::mutex mutex;
+        std::condition_variable removed;
+        std::vector<io_thread *> joining;
+        std::vector<io_thread *> leaving;
+        // tickets handed to remove() and the last one the thread has done
+        std::uint64_t requested = 0;
+        std::uint64_t completed = 0;
+        std::atomic<std::size_t> sessions{0};
+        std::jthread thread;
+    };
+
+    // From io_thread's constructor and destructor. remove() returns once
+    // the pool thread is done with `t` and has dropped its connection.
+    void add(io_thread &t);
+    void remove(io_thread &t);
+    // have the pool thread look at `t` again
+    void wake(io_thread &t);
+
+    worker &worker_of(const io_thread &t);
+    void run(worker &w, std::stop_token stop);
+
+    std::vector<std::unique_ptr<worker>> workers_;
+    std::atomic<std::size_t> next_{0};
+};
+} // namespace td365
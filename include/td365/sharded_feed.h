@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <boost/url/url_view.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <td365/io_thread.h>
+#include <td365/sequence_tracker.h>
+#include <td365/types.h>
+#include <td365/wake_signal.h>
+#include <td365/ws.h>
+#include <td365/ws_client.h>
+#include <unordered_map>
+#include <vector>
+
+namespace td365 {
+
+// How sharded_feed picks a connection for a new quote
+enum class shard_policy {
+    // a fixed hash of the quote id; stable across runs
+    hash,
+    // the connection with the fewest ticks per second from the quotes it
+    // already carries, see sharded_feed::rebalance()
+    rate,
+};
+
+struct sharded_feed_options {
+    std::size_t shards = 4;
+    shard_policy policy = shard_policy::hash;
+    // per shard, see io_thread
+    std::size_t ring_capacity = 4096;
+};
+
+struct shard_metrics {
+    // quotes assigned to the shard
+    std::size_t quotes;
+    // ticks handed out by wait()/try_pop()
+    std::uint64_t ticks;
+    ring_metrics ring;
+    send_metrics send;
+    sequence_metrics sequence;
+};
+
+// Spreads quote subscriptions over several authenticated connections, each
+// read and decoded by its own io_thread, so one busy socket doesn't hold up
+// the others. wait()/try_pop() merge the shards into one event stream.
+//
+// Everything except metrics() belongs to a single consumer thread.
+class sharded_feed {
+  public:
+    explicit sharded_feed(const sharded_feed_options &opts);
+
+    ~sharded_feed();
+
+    // Open and authenticate every shard, then start their I/O threads.
+    // `housekeeping` runs on the first shard's I/O thread, see io_thread.
+    void connect(boost::urls::url_view url, const std::string &login_id,
+                 const std::string &token,
+                 std::function<void()> housekeeping = {});
+
+    void subscribe(int quote_id);
+    void subscribe(std::span<const int> quote_ids);
+    void unsubscribe(int quote_id);
+    void unsubscribe(std::span<const int> quote_ids);
+
+    // With shard_policy::rate, reassign every quote by the tick rate seen so
+    // far, heaviest first onto the least loaded shard. A moved quote is
+    // only unsubscribed on its old connection once its new one has sent
+    // the subscribe, by a later wait()/try_pop(), so a few of its ticks
+    // may arrive twice. Quotes still being handed over stay put. Returns
+    // how many quotes moved.
+    std::size_t rebalance();
+
+    // The shard `quote_id` is subscribed on, if it is
+    std::optional<std::size_t> shard_of(int quote_id) const;
+
+    // Blocks until any shard has an event, taking from the shards in turn.
+    // connection_closed_event and error_event are passed on for each shard
+    // (see shard()); connection_closed_event is also returned once every
+    // shard has closed. Events are valid until the next wait()/try_pop().
+    event wait(std::optional<std::chrono::milliseconds> timeout);
+
+    std::optional<event> try_pop();
+
+    // The shard the last event from wait()/try_pop() came from
+    std::size_t shard() const { return last_; }
+
+    std::size_t shards() const { return shards_.size(); }
+
+    // For per-connection settings (reconnect, compression, ...) before
+    // connect(); afterwards it belongs to the shard's I/O thread
+    ws_client &client(std::size_t shard);
+
+    // Safe from any thread; quotes and ticks may lag the consumer thread
+    std::vector<shard_metrics> metrics() const;
+
+    // Run `cmd` against one shard's ws_client on its I/O thread
+    void post(std::size_t shard, io_thread::command cmd);
+
+  private:
+    struct shard_state {
+        ws_client client;
+        std::unique_ptr<io_thread> io;
+        // written by the consumer thread only, atomic for metrics()
+        std::atomic<std::size_t> quotes{0};
+        std::atomic<std::uint64_t> ticks{0};
+        bool closed = false;
+    };
+
+    struct quote_state {
+        std::size_t shard;
+        std::uint64_t ticks = 0;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    // quotes moved off `from` by rebalance(), to be unsubscribed there
+    // once `sent` is set by the I/O thread of the shard they moved to
+    struct handover {
+        std::size_t from;
+        std::vector<int> ids;
+        std::shared_ptr<std::atomic<bool>> sent;
+    };
+
+    std::size_t hashed(int quote_id) const;
+    // ticks per second of the quotes on each shard
+    std::vector<double> loads() const;
+    // the least loaded shard, fewest quotes breaking ties
+    static std::size_t lightest(std::span<const double> loads,
+                                std::span<const std::size_t> quotes);
+    void send_subscribe(std::size_t shard, std::vector<int> ids);
+    void send_unsubscribe(std::size_t shard, std::vector<int> ids);
+    // subscribe `ids` on `to`, then unsubscribe them on `from`
+    void move(std::size_t from, std::size_t to, std::vector<int> ids);
+    // unsubscribe the handovers whose subscribes have gone out
+    void finish_handovers();
+    // bookkeeping for an event taken from `shard`
+    void account(std::size_t shard, const event &evt);
+    static double quote_rate(const quote_state &q,
+                             std::chrono::steady_clock::time_point now);
+
+    sharded_feed_options opts_;
+    // notified by every shard's pushes; declared before the shards so it
+    // outlives their I/O threads
+    wake_signal wakeup_;
+    std::vector<std::unique_ptr<shard_state>> shards_;
+    std::unordered_map<int, quote_state> quotes_;
+    std::vector<handover> handovers_;
+    // where the next try_pop() starts looking
+    std::size_t next_ = 0;
+    std::size_t last_ = 0;
+};
+} // namespace td365
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+namespace td365 {
+
+// Bounded lock-free single-producer/single-consumer ring. Slots are
+// constructed up front and reused, so a slot that owns storage (e.g. a
+// vector) keeps its capacity from one lap to the next.
+//
+// Producer: claim() a free slot, fill it in place, publish().
+// Consumer: front() the oldest slot, read it, pop().
+template <typename T> class spsc_ring {
+  public:
+    // capacity is rounded up to a power of two
+    explicit spsc_ring(std::size_t capacity)
+        : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1),
+          slots_(mask_ + 1) {}
+
+    spsc_ring(const spsc_ring &) = delete;
+    spsc_ring &operator=(const spsc_ring &) = delete;
+
+    // Producer side. Returns nullptr when the ring is full.
+    T *claim() {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_) {
+                return nullptr;
+            }
+        }
+        return &slots_[tail & mask_];
+    }
+
+    // Producer side. Makes the slot returned by claim() visible.
+    void publish() {
+        auto tail = tail_.load(std::memory_order_relaxed) + 1;
+        tail_.store(tail, std::memory_order_release);
+
+        auto depth = tail - head_.load(std::memory_order_relaxed);
+        if (depth > high_water_.load(std::memory_order_relaxed)) {
+            high_water_.store(depth, std::memory_order_relaxed);
+        }
+    }
+
+    // Consumer side. Returns nullptr when the ring is empty.
+    T *front() {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return nullptr;
+            }
+        }
+        return &slots_[head & mask_];
+    }
+
+    // Consumer side. Releases the slot returned by front().
+    void pop() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    }
+
+    std::size_t size() const {
+        return tail_.load(std::memory_order_acquire) -
+               head_.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    std::size_t high_water() const {
+        return high_water_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // producer and consumer indices live on separate cache lines, each next
+    // to the producer/consumer's private copy of the other index
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    std::size_t head_cache_ = 0;
+
+    alignas(64) std::atomic<std::size_t> head_{0};
+    std::size_t tail_cache_ = 0;
+
+    alignas(64) std::atomic<std::size_t> high_water_{0};
+    std::size_t mask_;
+    std::vector<T> slots_;
+};
+} // namespace td365
@@ -7,32 +7,61 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
 #include <td365/authenticator.h>
+#include <td365/conflator.h>
+#include <td365/frame_recorder.h>
+#include <td365/io_thread.h>
+#include <td365/latency.h>
+#include <td365/quote_cache.h>
 #include <td365/rest_api.h>
+#include <td365/session_pool.h>
+#include <td365/sharded_feed.h>
 #include <td365/types.h>
+#include <td365/verify.h>
 #include <td365/ws_client.h>
+#include <thread>
 #include <vector>
 
 namespace td365 {
 
 template <typename H>
-concept UserCallbacksLike = requires(H h, tick &&t, account_summary &&a,
-                                     account_details &&d, trade_details &&e) {
-    { h.on_tick(std::move(t)) } -> std::same_as<void>;
-    { h.on_account_summary(std::move(a)) } -> std::same_as<void>;
-    { h.on_account_details(std::move(d)) } -> std::same_as<void>;
-    { h.on_trade_established(std::move(e)) } -> std::same_as<void>;
-};
+concept ControlCallbacksLike =
+    requires(H h, account_summary &&a, account_details &&d, trade_details &&e) {
+        { h.on_account_summary(std::move(a)) } -> std::same_as<void>;
+        { h.on_account_details(std::move(d)) } -> std::same_as<void>;
+        { h.on_trade_established(std::move(e)) } -> std::same_as<void>;
+    };
+
+template <typename H>
+concept UserCallbacksLike =
+    ControlCallbacksLike<H> && requires(H h, tick &&t) {
+        { h.on_tick(std::move(t)) } -> std::same_as<void>;
+    };
+
+// Takes each decoded frame's ticks in one call. The span is only valid for
+// the duration of the call.
+template <typename H>
+concept BatchCallbacksLike =
+    ControlCallbacksLike<H> && requires(H h, std::span<const tick> s) {
+        { h.on_ticks(s) } -> std::same_as<void>;
+    };
 
 class td365 {
   public:
     explicit td365();
 
+    // Make HTTP and websocket connections on `ioc`, e.g. one of a
+    // session_pool's, instead of io_contexts of our own
+    explicit td365(boost::asio::io_context &ioc);
+
     ~td365();
 
     void connect(const std::string &username, const std::string &password,
@@ -40,11 +69,145 @@ class td365 {
 
     void connect();
 
+    // Play back captured frames (see start_capture) in place of a live
+    // connection, for backtests and reproducing incidents. No login needed.
+    void replay(const replay_options &opts);
+
     void subscribe(int quote_id);
+    void subscribe(std::span<const int> quote_ids);
     void unsubscribe(int quote_id);
+    void unsubscribe(std::span<const int> quote_ids);
+
+    // Make `quote_ids` the complete subscription set; only the difference
+    // is sent
+    void set_subscriptions(std::span<const int> quote_ids);
+
+    // Send at most `burst` subscribe/unsubscribe frames per `interval`
+    void set_subscription_pacing(std::size_t burst,
+                                 std::chrono::milliseconds interval);
+
+    // Opt in to exact fixed-point prices on ticks, see
+    // tick_batch_event::exact
+    void set_price_mode(price_mode mode);
+
+    // Move socket reads, frame decoding and heartbeats onto a dedicated
+    // thread, and session refresh onto another, so REST calls never hold up
+    // the socket. Call after connect(). wait() and try_pop() then consume
+    // from a ring of `ring_capacity` events.
+    void start_io_thread(std::size_t ring_capacity = 4096);
+
+    // Like start_io_thread(), but share a thread of `pool` with other
+    // sessions. This object must have been made on pool.context(). Call
+    // before connect(), which then connects on the pool's thread.
+    void start_io_thread(session_pool &pool, std::size_t ring_capacity = 4096);
+
+    // Open `opts.shards` further connections on this session, each read
+    // and decoded on its own thread, and spread quotes over them (see
+    // sharded_feed). Use the feed's subscribe() and wait() instead of this
+    // object's. Call after connect(); the feed must not outlive this
+    // object.
+    std::unique_ptr<sharded_feed>
+    open_sharded_feed(const sharded_feed_options &opts);
+
+    // Opt in to latest-value delivery for consumers that fall behind:
+    // wait() and try_pop() return only the newest tick of each quote that
+    // changed since the last batch, skipping the stale ones. Call before
+    // start_io_thread(). Applies to run() only with the I/O thread started;
+    // without one, run() delivers every tick.
+    void set_conflation(const conflation_options &opts);
+
+    // Requires set_conflation()
+    conflation_metrics conflation_stats() const;
+
+    // Keep the latest tick of up to `max_quotes` quotes for get_quote().
+    // Call before start_io_thread().
+    void enable_quote_cache(std::size_t max_quotes = 4096);
+
+    // Latest tick of `quote_id`, or std::nullopt if none arrived yet. Safe
+    // from any thread and never blocks the feed. Requires
+    // enable_quote_cache().
+    std::optional<tick> get_quote(int quote_id) const;
+
+    // Record latency histograms for each stage of tick delivery, totals and
+    // per quote for the first `max_quotes` quotes. Call before
+    // start_io_thread().
+    void enable_latency_recording(std::size_t max_quotes = 512);
+
+    // Requires enable_latency_recording(). Snapshots and reset() are safe
+    // from any thread.
+    latency_recorder &latency();
+
+    // Have the kernel timestamp each received frame, so wire-to-application
+    // latency can be told apart from server-to-wire. Stamps show up in
+    // tick_batch_event::received and, with latency recording, as the
+    // server_to_wire and wire_to_receive stages. Those always use the
+    // kernel's stamp, which needs no privileges; rx_timestamping::hardware
+    // also has the NIC stamp, in its own clock (see rx_timestamping).
+    void set_rx_timestamps(rx_timestamping mode);
+
+    // Ask the server to compress frames with permessage-deflate. Takes
+    // effect from the next connect, so call before connect(); later calls
+    // apply from the next reconnect. Price frames are repetitive JSON and
+    // typically shrink several times over, at the cost of inflating them.
+    void set_compression(const compression_options &opts);
+
+    // Compression ratio (payload_bytes / wire_bytes) and inflate CPU time
+    compression_metrics compression_stats() const {
+        return ws_client_.compression_stats();
+    }
+
+    // Append every websocket frame in and out to memory-mapped capture
+    // files (see frame_recorder), replacing any capture already running
+    void start_capture(const capture_options &opts);
+
+    void stop_capture();
+
+    // Requires start_capture()
+    capture_metrics capture_stats() const;
+
+    // Opt in to busy-polling the socket (see spin_options). Call after
+    // connect(). The receiving thread - the I/O thread if started, else the
+    // caller - is pinned/rescheduled as requested.
+    void set_spin_mode(const spin_options &opts);
 
     event wait(std::optional<std::chrono::milliseconds> timeout = std::nullopt);
 
+    // Event loop that calls `handler` directly instead of returning events.
+    // Batch handlers (on_ticks) take precedence over on_tick. Returns when
+    // stop() is called or the connection closes; throws on errors.
+    template <typename H>
+        requires UserCallbacksLike<H> || BatchCallbacksLike<H>
+    void run(H &handler);
+
+    // Make run() return after the current frame. Safe from any thread.
+    void stop() { stop_.store(true, std::memory_order_relaxed); }
+
+    // Non-blocking wait(), requires start_io_thread()
+    std::optional<event> try_pop();
+
+    // Ring depth/high-water mark, requires start_io_thread()
+    ring_metrics io_metrics() const;
+
+    // Outbound websocket queue depth and write latency
+    send_metrics write_metrics() const { return ws_client_.write_metrics(); }
+
+    // How dropped connections are retried. Subscriptions are replayed after
+    // each reconnect, which is reported as reconnected_event (or
+    // on_reconnected in run()).
+    void set_reconnect_options(const reconnect_options &opts);
+
+    reconnect_metrics reconnect_stats() const {
+        return ws_client_.reconnect_stats();
+    }
+
+    // Report per-quote sequence gaps as gap_event (or on_gap in run())
+    void set_gap_events(bool enabled);
+
+    // Gap/duplicate/reordering counters over tick::field13
+    sequence_metrics sequence_stats() const {
+        return ws_client_.sequence_stats();
+    }
+
     std::vector<market_group> get_market_super_group();
     std::vector<market_group> get_market_group(int id);
     std::vector<market> get_market_quote(int id);
@@ -52,10 +215,97 @@ class td365 {
     trade_response trade(const trade_request &&request);
     std::vector<candle> backfill(int market_id, int quote_id, size_t sz,
                                  chart_duration dur);
+    // As above, with the exact prices of the i-th candle in exact[i]
+    std::vector<candle> backfill(int market_id, int quote_id, size_t sz,
+                                 chart_duration dur,
+                                 std::vector<candle_prices> &exact);
 
   private:
+    // the websocket half of connect(), on the I/O thread if there is one
+    void connect_ws();
+
+    void refresh_session();
+
+    // Refresh the session on a thread of its own from now on, for when the
+    // websocket is read elsewhere: refresh_session() blocks on rest_mutex_
+    // and HTTP, which the reading thread must never wait for. Does nothing
+    // until connect() has logged in.
+    void start_session_refresh();
+
+    event wait_conflated(std::optional<std::chrono::milliseconds> timeout);
+
+    template <typename H> bool dispatch(event &&evt, H &handler);
+
     rest_api rest_client_;
+    // rest_client_ is shared with the session refresh thread
+    std::mutex rest_mutex_;
     ws_client ws_client_;
-    std::chrono::steady_clock::time_point last_session_update_;
+    // where connect() logged in, for open_sharded_feed()
+    boost::urls::url sock_host_;
+    rest_api::auth_info auth_info_;
+    // refresh_session() may run on the refresh thread and the caller's
+    std::atomic<std::chrono::steady_clock::time_point> last_session_update_;
+    price_mode price_mode_ = price_mode::floating;
+    std::atomic<bool> stop_{false};
+    std::unique_ptr<conflator> conflator_;
+    std::unique_ptr<quote_cache> quote_cache_;
+    std::unique_ptr<latency_recorder> latency_;
+    // shared with commands posted to the I/O thread, which may still be
+    // writing to it
+    std::shared_ptr<frame_recorder> recorder_;
+    // declared last so they stop before everything they use is destroyed
+    std::unique_ptr<io_thread> io_thread_;
+    std::jthread refresh_thread_;
 };
+
+template <typename H>
+    requires UserCallbacksLike<H> || BatchCallbacksLike<H>
+void td365::run(H &handler) {
+    constexpr auto poll_interval = std::chrono::milliseconds(100);
+
+    while (!stop_.load(std::memory_order_relaxed)) {
+        if (io_thread_) {
+            if (!dispatch(io_thread_->wait(poll_interval), handler)) {
+                break;
+            }
+        } else {
+            refresh_session();
+            if (!ws_client_.pump(handler, poll_interval)) {
+                break;
+            }
+        }
+    }
+    stop_.store(false, std::memory_order_relaxed);
+}
+
+// Events from the I/O thread's ring arrive already built
+template <typename H> bool td365::dispatch(event &&evt, H &handler) {
+    return std::visit(
+        [&handler](auto &&e) -> bool {
+            using T = std::decay_t<decltype(e)>;
+            if constexpr (std::is_same_v<T, tick_batch_event>) {
+                deliver_ticks(handler, e.data, e.exact);
+            } else if constexpr (std::is_same_v<T, account_summary_event>) {
+                handler.on_account_summary(std::move(e.data));
+            } else if constexpr (std::is_same_v<T, account_details_event>) {
+                handler.on_account_details(std::move(e.data));
+            } else if constexpr (std::is_same_v<T, trade_established_event>) {
+                handler.on_trade_established(std::move(e.data));
+            } else if constexpr (std::is_same_v<T, error_event>) {
+                throw fail("td365: {}", e.message);
+            } else if constexpr (std::is_same_v<T, connection_closed_event>) {
+                return false;
+            } else if constexpr (std::is_same_v<T, reconnected_event>) {
+                if constexpr (requires { handler.on_reconnected(e); }) {
+                    handler.on_reconnected(e);
+                }
+            } else if constexpr (std::is_same_v<T, gap_event>) {
+                if constexpr (requires { handler.on_gap(e); }) {
+                    handler.on_gap(e);
+                }
+            }
+            return true;
+        },
+        std::move(evt));
+}
 } // namespace td365
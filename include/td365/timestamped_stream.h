@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <array>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket/teardown.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <sys/uio.h>
+#include <utility>
+
+namespace td365 {
+
+// Kernel receive timestamps on the websocket socket, see
+// ws::set_rx_timestamps
+enum class rx_timestamping {
+    off,
+    // SO_TIMESTAMPNS: stamped by the kernel as the packet comes in
+    software,
+    // SO_TIMESTAMPING: stamped by the kernel, and also by the NIC where
+    // the driver has RX timestamping enabled. The NIC's stamp is in its
+    // PHC's clock, which needn't follow system_clock, so it is kept apart
+    // (timestamped_stream::last_hardware_received) from the one latencies
+    // are measured with.
+    hardware,
+};
+
+using rx_time = std::chrono::time_point<std::chrono::system_clock,
+                                        std::chrono::nanoseconds>;
+
+// tcp_stream that reads with recvmsg() to pick up the kernel's receive
+// timestamp of each read. Sits under the TLS and websocket layers; with
+// timestamping off it forwards straight to the tcp_stream. Reads bypass
+// the tcp_stream's expiry, which is disarmed after the handshake anyway.
+class timestamped_stream {
+  public:
+    using next_layer_type = boost::beast::tcp_stream;
+    using lowest_layer_type = boost::asio::ip::tcp::socket;
+    using executor_type = next_layer_type::executor_type;
+
+    explicit timestamped_stream(boost::asio::io_context &ioc) : next_(ioc) {}
+
+    executor_type get_executor() noexcept { return next_.get_executor(); }
+
+    next_layer_type &next_layer() noexcept { return next_; }
+    const next_layer_type &next_layer() const noexcept { return next_; }
+
+    lowest_layer_type &lowest_layer() noexcept { return next_.socket(); }
+    const lowest_layer_type &lowest_layer() const noexcept {
+        return next_.socket();
+    }
+
+    // Turn timestamping on or off for the connected socket. Returns false,
+    // leaving it off, if the kernel refuses.
+    bool set_mode(rx_timestamping mode);
+
+    rx_timestamping mode() const { return mode_; }
+
+    // Receive time of the data returned by the last async read, empty if
+    // timestamping is off or the kernel attached none
+    std::optional<rx_time> last_received() const { return last_received_; }
+
+    // The NIC's raw stamp of the same data with rx_timestamping::hardware,
+    // as time since the epoch of the NIC's PHC. It only compares with
+    // system_clock where the PHC is synchronised to it (e.g. phc2sys).
+    std::optional<std::chrono::nanoseconds> last_hardware_received() const {
+        return last_hardware_received_;
+    }
+
+    // bytes read so far, for compression_metrics::wire_bytes
+    std::uint64_t bytes_received() const { return bytes_received_; }
+
+    // Synchronous I/O (handshakes) is never timestamped
+    template <class MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence &buffers) {
+        auto n = next_.read_some(buffers);
+        bytes_received_ += n;
+        return n;
+    }
+
+    template <class MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence &buffers,
+                          boost::system::error_code &ec) {
+        auto n = next_.read_some(buffers, ec);
+        bytes_received_ += n;
+        return n;
+    }
+
+    template <class ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence &buffers) {
+        return next_.write_some(buffers);
+    }
+
+    template <class ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence &buffers,
+                           boost::system::error_code &ec) {
+        return next_.write_some(buffers, ec);
+    }
+
+    template <class ConstBufferSequence, class WriteHandler>
+    auto async_write_some(const ConstBufferSequence &buffers,
+                          WriteHandler &&handler) {
+        return next_.async_write_some(buffers,
+                                      std::forward<WriteHandler>(handler));
+    }
+
+    template <class MutableBufferSequence, class ReadHandler>
+    auto async_read_some(const MutableBufferSequence &buffers,
+                         ReadHandler &&handler) {
+        return boost::asio::async_compose<
+            ReadHandler, void(boost::system::error_code, std::size_t)>(
+            read_op<MutableBufferSequence>{*this, buffers}, handler, next_);
+    }
+
+  private:
+    // most websocket reads pass one or two buffers
+    static constexpr std::size_t max_iov = 16;
+
+    template <class MutableBufferSequence> struct read_op {
+        timestamped_stream &stream;
+        MutableBufferSequence buffers;
+        enum { starting, waiting, forwarded } state = starting;
+
+        template <class Self>
+        void operator()(Self &self, boost::system::error_code ec = {},
+                        std::size_t n = 0) {
+            switch (state) {
+            case starting:
+                if (stream.mode_ == rx_timestamping::off) {
+                    state = forwarded;
+                    stream.next_.async_read_some(buffers, std::move(self));
+                    return;
+                }
+                state = waiting;
+                stream.next_.socket().async_wait(
+                    boost::asio::socket_base::wait_read, std::move(self));
+                return;
+            case waiting: {
+                if (ec) {
+                    self.complete(ec, 0);
+                    return;
+                }
+                std::array<iovec, max_iov> iov;
+                std::size_t count = 0;
+                for (auto it = boost::asio::buffer_sequence_begin(buffers);
+                     it != boost::asio::buffer_sequence_end(buffers) &&
+                     count < max_iov;
+                     ++it) {
+                    boost::asio::mutable_buffer b = *it;
+                    iov[count++] = {b.data(), b.size()};
+                }
+                if (!stream.receive(iov.data(), count, ec, n)) {
+                    // woken without data, e.g. by a spurious wake-up
+                    stream.next_.socket().async_wait(
+                        boost::asio::socket_base::wait_read, std::move(self));
+                    return;
+                }
+                stream.bytes_received_ += n;
+                self.complete(ec, n);
+                return;
+            }
+            case forwarded:
+                stream.bytes_received_ += n;
+                self.complete(ec, n);
+                return;
+            }
+        }
+    };
+
+    // One non-blocking recvmsg() into `iov`. Returns false if there was
+    // nothing to read yet.
+    bool receive(iovec *iov, std::size_t count, boost::system::error_code &ec,
+                 std::size_t &n);
+
+    next_layer_type next_;
+    rx_timestamping mode_ = rx_timestamping::off;
+    std::optional<rx_time> last_received_;
+    std::optional<std::chrono::nanoseconds> last_hardware_received_;
+    std::uint64_t bytes_received_ = 0;
+};
+
+// websocket close handshake, as for tcp_stream
+void teardown(boost::beast::role_type role, timestamped_stream &stream,
+              boost::system::error_code &ec);
+
+template <class TeardownHandler>
+void async_teardown(boost::beast::role_type role, timestamped_stream &stream,
+                    TeardownHandler &&handler) {
+    using boost::beast::websocket::async_teardown;
+    async_teardown(role, stream.next_layer().socket(),
+                   std::forward<TeardownHandler>(handler));
+}
+} // namespace td365
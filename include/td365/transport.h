@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl/ssl_stream.hpp>
+#include <boost/url/url.hpp>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <td365/replay.h>
+#include <td365/timestamped_stream.h>
+#include <utility>
+
+namespace td365 {
+
+using ssl_websocket_type = boost::beast::websocket::stream<
+    boost::beast::ssl_stream<timestamped_stream>>;
+using plain_websocket_type =
+    boost::beast::websocket::stream<timestamped_stream>;
+
+// Opt-in permessage-deflate (RFC 7692), see td365::set_compression. The
+// server may decline; compression_metrics::negotiated tells.
+struct compression_options {
+    bool enabled = false;
+    // LZ77 window for each direction, 9..15 bits. Smaller windows use
+    // less memory per connection and compress a little worse.
+    int server_max_window_bits = 15;
+    int client_max_window_bits = 15;
+    // start every message with an empty window: less memory, worse ratio
+    bool server_no_context_takeover = false;
+    bool client_no_context_takeover = false;
+    // zlib level (0..9) and memLevel (1..9) for the frames we send
+    int level = 6;
+    int mem_level = 4;
+};
+
+namespace detail {
+// stands in for ws's completion handlers in TransportLike
+struct transport_handler {
+    void operator()(boost::system::error_code, std::size_t) const {}
+};
+} // namespace detail
+
+// What ws needs from a connection. Handlers complete through the
+// io_context the transport was made with, never inline.
+template <typename T>
+concept TransportLike =
+    requires(T t, boost::beast::flat_buffer &buffer,
+             boost::asio::const_buffer frame, detail::transport_handler h) {
+        // one whole message into `buffer`
+        t.async_read(buffer, h);
+        // one whole message; `frame` stays valid until `h` runs
+        t.async_write(frame, h);
+        t.async_close(h);
+        // complete outstanding operations with an error and stop
+        t.abort();
+        {
+            t.last_received()
+        } -> std::same_as<std::optional<rx_time>>;
+    };
+
+// A websocket over TCP or TLS; tls_transport and tcp_transport
+template <typename Stream> class websocket_transport {
+  public:
+    static constexpr bool tls = std::same_as<Stream, ssl_websocket_type>;
+
+    explicit websocket_transport(boost::asio::io_context &ioc);
+
+    // Offer permessage-deflate in the next handshake
+    void set_compression(const compression_options &opts);
+
+    // Resolve and connect, then run the TLS and websocket handshakes
+    void connect(const boost::urls::url &url);
+
+    // whether the server accepted permessage-deflate
+    bool compressed() const { return compressed_; }
+
+    // everything read off the socket so far
+    std::uint64_t bytes_received() const { return stream().bytes_received(); }
+
+    template <typename Handler>
+    void async_read(boost::beast::flat_buffer &buffer, Handler &&handler) {
+        ws_.async_read(buffer, std::forward<Handler>(handler));
+    }
+
+    template <typename Handler>
+    void async_write(boost::asio::const_buffer frame, Handler &&handler) {
+        ws_.async_write(frame, std::forward<Handler>(handler));
+    }
+
+    template <typename Handler> void async_close(Handler &&handler) {
+        ws_.async_close(boost::beast::websocket::close_code::normal,
+                        std::forward<Handler>(handler));
+    }
+
+    void abort();
+
+    std::optional<rx_time> last_received() const {
+        return stream().last_received();
+    }
+
+    // the socket layer, for rx timestamps
+    timestamped_stream &stream();
+    const timestamped_stream &stream() const;
+
+    boost::asio::ip::tcp::socket &socket() {
+        return boost::beast::get_lowest_layer(ws_).socket();
+    }
+
+  private:
+    Stream ws_;
+    bool compressed_ = false;
+};
+
+using tls_transport = websocket_transport<ssl_websocket_type>;
+using tcp_transport = websocket_transport<plain_websocket_type>;
+
+extern template class websocket_transport<ssl_websocket_type>;
+extern template class websocket_transport<plain_websocket_type>;
+
+// Reads the frames of a replay_feed, paced on a timer. Writes are dropped.
+class replay_transport {
+  public:
+    replay_transport(boost::asio::io_context &ioc, replay_options opts);
+
+    template <typename Handler>
+    void async_read(boost::beast::flat_buffer &buffer, Handler &&handler) {
+        if (aborted_) {
+            complete(std::forward<Handler>(handler),
+                     boost::asio::error::operation_aborted, 0);
+            return;
+        }
+        auto frame = feed_.next();
+        if (!frame) {
+            // the end of the capture reads like the server closing
+            complete(std::forward<Handler>(handler),
+                     boost::beast::websocket::error::closed, 0);
+            return;
+        }
+        if (frame->due <= std::chrono::steady_clock::now()) {
+            complete(std::forward<Handler>(handler), {},
+                     copy(buffer, frame->payload));
+            return;
+        }
+        // the feed isn't advanced while we wait, so the payload stays put
+        timer_.expires_at(frame->due);
+        timer_.async_wait(
+            [this, &buffer, payload = frame->payload,
+             h = std::forward<Handler>(handler)](
+                boost::system::error_code) mutable {
+                if (aborted_) {
+                    h(boost::asio::error::operation_aborted, 0);
+                    return;
+                }
+                h(boost::system::error_code{}, copy(buffer, payload));
+            });
+    }
+
+    // there is nobody to send to
+    template <typename Handler>
+    void async_write(boost::asio::const_buffer frame, Handler &&handler) {
+        complete(std::forward<Handler>(handler), {}, frame.size());
+    }
+
+    template <typename Handler> void async_close(Handler &&handler) {
+        complete(std::forward<Handler>(handler), {}, 0);
+    }
+
+    void abort();
+
+    std::optional<rx_time> last_received() const { return std::nullopt; }
+
+  private:
+    template <typename Handler>
+    void complete(Handler &&handler, boost::system::error_code ec,
+                  std::size_t n) {
+        boost::asio::post(ioc_, [h = std::forward<Handler>(handler), ec,
+                                 n]() mutable { h(ec, n); });
+    }
+
+    static std::size_t copy(boost::beast::flat_buffer &buffer,
+                            std::string_view payload);
+
+    boost::asio::io_context &ioc_;
+    boost::asio::steady_timer timer_;
+    replay_feed feed_;
+    bool aborted_ = false;
+};
+
+static_assert(TransportLike<tls_transport>);
+static_assert(TransportLike<tcp_transport>);
+static_assert(TransportLike<replay_transport>);
+} // namespace td365
@@ -7,13 +7,22 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <boost/asio/detail/descriptor_ops.hpp>
 #include <boost/beast/websocket/stream_base.hpp>
 #include <chrono>
+#include <cstdint>
 #include <exception>
 #include <functional>
 #include <nlohmann/json_fwd.hpp>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <td365/fixed_price.h>
+#include <type_traits>
 #include <variant>
 
 namespace td365 {
@@ -70,12 +79,61 @@ struct market {
 };
 
 // Enum for price data types
-enum class grouping { grouped, sampled, delayed, candle_1m, _count };
+enum class grouping : uint8_t { grouped, sampled, delayed, candle_1m, _count };
 
-enum class direction { up, down, unchanged, _count };
+enum class direction : uint8_t { up, down, unchanged, _count };
 
 enum class chart_duration { m1 };
 
+// How prices are parsed. `fixed` derives the doubles from fixed_price
+// values, and hands those out too (tick_batch_event::exact).
+enum class price_mode { floating, fixed };
+
+// Base64 quote hash stored inline, so a tick is trivially copyable and
+// parsing one doesn't allocate. The server sends 44 characters (32 bytes).
+class tick_hash {
+  public:
+    static constexpr std::size_t capacity = 44;
+
+    tick_hash() = default;
+
+    explicit tick_hash(std::string_view s) { assign(s); }
+
+    tick_hash &operator=(std::string_view s) {
+        assign(s);
+        return *this;
+    }
+
+    std::string_view view() const { return {data_.data(), size_}; }
+
+    // owning copy, e.g. for trade_request::key
+    std::string str() const { return std::string(view()); }
+
+    std::size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    friend bool operator==(const tick_hash &a, const tick_hash &b) {
+        return a.view() == b.view();
+    }
+
+    friend bool operator==(const tick_hash &a, std::string_view b) {
+        return a.view() == b;
+    }
+
+  private:
+    void assign(std::string_view s) {
+        if (s.size() > capacity) {
+            throw std::length_error("tick_hash: too long: " + std::string(s));
+        }
+        std::copy(s.begin(), s.end(), data_.begin());
+        size_ = static_cast<std::uint8_t>(s.size());
+    }
+
+    std::array<char, capacity> data_{};
+    std::uint8_t size_ = 0;
+};
+
 struct tick {
     using time_type = std::chrono::time_point<std::chrono::system_clock,
                                               std::chrono::nanoseconds>;
@@ -87,7 +145,7 @@ struct tick {
     bool tradable;
     double high;
     double low;
-    std::string hash; // Base64 encoded hash
+    tick_hash hash;
     bool call_only;
     double mid_price;
     time_type timestamp;
@@ -101,6 +159,47 @@ struct tick {
     void parse(const std::string_view line);
 };
 
+static_assert(std::is_trivially_copyable_v<tick>);
+
+// The exact bid/ask/high/low/mid_price of a tick, parsed with
+// price_mode::fixed. Kept apart from tick so that floating consumers, and
+// every ring and cache slot, don't carry them.
+struct tick_prices {
+    fixed_price bid;
+    fixed_price ask;
+    fixed_price high;
+    fixed_price low;
+    fixed_price mid;
+};
+
+// One tick per cache line, for rings, per-quote buffers and recordings.
+// Hot fields come first. The hash and latency are not carried, and
+// daily_change is narrowed to float; to_tick() leaves those defaulted.
+struct alignas(64) packed_tick {
+    double bid;
+    double ask;
+    int64_t timestamp_ns;
+    int32_t quote_id;
+    int32_t field13;
+    double mid_price;
+    double high;
+    double low;
+    float daily_change;
+    direction dir;
+    grouping group;
+    uint8_t flags; // flag_tradable | flag_call_only
+
+    static constexpr uint8_t flag_tradable = 1;
+    static constexpr uint8_t flag_call_only = 2;
+
+    static packed_tick from(const tick &t);
+
+    tick to_tick() const;
+};
+
+static_assert(sizeof(packed_tick) == 64);
+static_assert(std::is_trivially_copyable_v<packed_tick>);
+
 struct trade_request {
     enum class direction { buy, sell };
 
@@ -112,6 +211,11 @@ struct trade_request {
     double stop;
     double limit;
     std::string key;
+    // when set, sent in place of price/stop/limit so the order carries the
+    // exact decimal value
+    std::optional<fixed_price> exact_price{};
+    std::optional<fixed_price> exact_stop{};
+    std::optional<fixed_price> exact_limit{};
 };
 
 struct trade_response {
@@ -392,8 +496,24 @@ struct candle {
     double volume;
 };
 
-struct tick_event {
-    tick data;
+// The exact open/high/low/close of a candle, see td365::backfill
+struct candle_prices {
+    fixed_price open;
+    fixed_price high;
+    fixed_price low;
+    fixed_price close;
+};
+
+// Every tick carried by a single price frame. `data` points into a buffer
+// owned by the client and is only valid until the next call to wait().
+struct tick_batch_event {
+    std::span<const tick> data;
+    // kernel receive time of the frame, see td365::set_rx_timestamps. Empty
+    // when timestamps are off and for conflated batches.
+    std::optional<tick::time_type> received;
+    // With price_mode::fixed, the exact prices of data[i] are exact[i].
+    // Empty otherwise, and for conflated batches.
+    std::span<const tick_prices> exact{};
 };
 
 struct account_summary_event {
@@ -415,11 +535,27 @@ struct error_event {
 
 struct connection_closed_event {};
 
+// The connection dropped and was re-established; subscriptions are being
+// replayed. Prices during `downtime` were missed.
+struct reconnected_event {
+    std::chrono::nanoseconds downtime;
+    int attempts;
+};
+
+// A quote's sequence number (tick::field13) jumped forward: ticks
+// `expected` up to `received` - 1 never arrived
+struct gap_event {
+    int quote_id;
+    int expected;
+    int received;
+};
+
 struct timeout_event {};
 
-using event = std::variant<tick_event, account_summary_event,
+using event = std::variant<tick_batch_event, account_summary_event,
                            account_details_event, trade_established_event,
-                           error_event, connection_closed_event, timeout_event>;
+                           error_event, connection_closed_event,
+                           reconnected_event, gap_event, timeout_event>;
 
 // DEPRECATED: Will be removed in future version. Use td365::wait() and event
 // variant instead.
@@ -445,6 +581,8 @@ std::ostream &operator<<(std::ostream &os, const td365::grouping &);
 
 std::ostream &operator<<(std::ostream &os, const td365::direction &);
 
+std::ostream &operator<<(std::ostream &os, const td365::tick_hash &);
+
 std::ostream &operator<<(std::ostream &os, const td365::tick &);
 
 std::ostream &operator<<(std::ostream &os, const td365::account_summary &);
@@ -11,6 +11,7 @@
 
 #include <boost/asio/ssl/context.hpp>
 #include <boost/url/url.hpp>
+#include <optional>
 #include <td365/http_client.h>
 #include <td365/verify.h>
 
@@ -23,6 +24,14 @@ std::string now_utc();
 
 std::string get_http_body(http_response const &res);
 
-boost::asio::ip::tcp::resolver::results_type td_resolve(std::string_view host,
-                                                        std::string_view port);
+// Resolve on the caller's executor rather than a throwaway io_context. The
+// lookup is synchronous, so the executor's context needn't be running.
+boost::asio::ip::tcp::resolver::results_type
+td_resolve(const boost::asio::any_io_executor &ex, std::string_view host,
+           std::string_view port);
+
+// Pin the calling thread to `cpu` and/or switch it to SCHED_FIFO. Failures
+// (e.g. missing CAP_SYS_NICE) are logged, not thrown.
+void tune_current_thread(std::optional<int> cpu,
+                         std::optional<int> fifo_priority);
 } // namespace td365
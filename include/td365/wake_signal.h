@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace td365 {
+
+// A counter producers bump whenever they have published something, which a
+// consumer can block on with a deadline. Several producers may share one,
+// so a consumer of many queues has a single thing to wait for.
+//
+// Consumer: take epoch(), check the queues, then wait_until(epoch, ...).
+// Anything notified after epoch() was taken ends the wait, so a wake-up
+// can't be lost between the check and the wait.
+class wake_signal {
+  public:
+    std::uint64_t epoch() const {
+        return epoch_.load(std::memory_order_acquire);
+    }
+
+    void notify() {
+        epoch_.fetch_add(1, std::memory_order_release);
+        // only pay for the mutex when a consumer is parked; the fences pair
+        // with the one in wait_until() so one side always sees the other's
+        // store
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard lock(mutex_);
+            cv_.notify_all();
+        }
+    }
+
+    // Blocks until notify() is called after `epoch` was taken, or
+    // `deadline`. Returns false on timeout.
+    bool wait_until(std::uint64_t epoch,
+                    std::chrono::steady_clock::time_point deadline) {
+        waiters_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool woken;
+        {
+            std::unique_lock lock(mutex_);
+            auto changed = [&] {
+                return epoch_.load(std::memory_order_acquire) != epoch;
+            };
+            if (deadline == std::chrono::steady_clock::time_point::max()) {
+                cv_.wait(lock, changed);
+                woken = true;
+            } else {
+                woken = cv_.wait_until(lock, deadline, changed);
+            }
+        }
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+        return woken;
+    }
+
+  private:
+    std::atomic<std::uint64_t> epoch_{0};
+    std::atomic<int> waiters_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+} // namespace td365
@@ -7,37 +7,198 @@
 
 #pragma once
 
+#include <atomic>
 #include <boost/asio.hpp>
-#include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
-#include <boost/beast/ssl/ssl_stream.hpp>
 #include <boost/url/url.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <td365/frame_recorder.h>
+#include <td365/memory_transport.h>
+#include <td365/replay.h>
+#include <td365/timestamped_stream.h>
+#include <td365/transport.h>
+#include <variant>
+#include <vector>
 
 namespace td365 {
-using ssl_websocket_type = boost::beast::websocket::stream<
-    boost::beast::ssl_stream<boost::beast::tcp_stream>>;
-using plain_websocket_type =
-    boost::beast::websocket::stream<boost::beast::tcp_stream>;
+// Outbound queue counters, see ws::send
+struct send_metrics {
+    // frames queued or being written
+    std::size_t queue_depth;
+    std::size_t high_water;
+    std::uint64_t frames_sent;
+    // from send() to write completion; total / frames_sent gives the mean
+    std::chrono::nanoseconds max_latency;
+    std::chrono::nanoseconds total_latency;
+};
+
+// Opt-in low-latency receive mode, see td365::set_spin_mode. Reads are
+// completed by spinning on the reactor instead of blocking on a timer.
+struct spin_options {
+    // SO_BUSY_POLL budget in microseconds. Values above net.core.busy_poll
+    // need CAP_NET_ADMIN.
+    std::optional<int> busy_poll_us;
+    // pin the receiving thread to this CPU
+    std::optional<int> cpu;
+    // run the receiving thread under SCHED_FIFO at this priority
+    std::optional<int> fifo_priority;
+};
+
+// Inbound counters, see ws::compression_stats
+struct compression_metrics {
+    // whether the current connection compresses
+    bool negotiated;
+    std::uint64_t messages;
+    // message bytes after inflating, and bytes read off the socket
+    // including framing (and TLS for wss); payload_bytes / wire_bytes is
+    // the compression ratio
+    std::uint64_t payload_bytes;
+    std::uint64_t wire_bytes;
+    // Thread CPU time of the reactor work that completed reads: inflate,
+    // plus framing and TLS. Only counted with compression enabled.
+    std::chrono::nanoseconds inflate_cpu;
+};
 
 class ws {
   public:
     explicit ws();
 
+    // Run on `ioc` instead of an io_context of our own. read_message() and
+    // close() run it, so every ws sharing it must be driven, and
+    // destroyed, from the one thread that runs it; see session_pool.
+    explicit ws(boost::asio::io_context &ioc);
+
+    ~ws();
+
+    // May be called again after the connection dropped. Queued frames of
+    // the old connection are discarded; metrics and spin settings carry
+    // over. wss:// and https:// connect over TLS, memory://<name> to a
+    // memory_server in this process, anything else over plain TCP.
     void connect(boost::urls::url);
 
+    // Read frames from capture files instead of a connection. Frames sent
+    // meanwhile are dropped; the end of the capture reads as a close.
+    void replay(const replay_options &opts);
+
     void close();
 
+    // Queue a frame and return without blocking. Frames go out in order
+    // while read_message() runs the connection; frames queued while a
+    // write is in flight are batched into the next write chain.
     void send(std::string_view message);
 
-    std::pair<boost::system::error_code, std::string> read_message(
+    // Queue one frame gathered from several buffers
+    void send(std::span<const boost::asio::const_buffer> message);
+
+    // Safe to call from any thread
+    send_metrics metrics() const;
+
+    // The returned view points into an internal receive buffer that is
+    // recycled between reads; it is only valid until the next read_message.
+    std::pair<boost::system::error_code, std::string_view> read_message(
         std::optional<std::chrono::milliseconds> timeout = std::nullopt);
 
+    // read_message() has a frame or error to return without running the
+    // reactor, or has yet to start a read
+    bool ready() const { return !read_pending_ || read_done_; }
+
+    // Busy-poll instead of blocking in read_message. Burns a core.
+    void set_spin(bool spin);
+
+    // Set SO_BUSY_POLL on the socket
+    void set_busy_poll(std::chrono::microseconds budget);
+
+    // Have the kernel timestamp received data. Applies to the current
+    // connection, if any, and to later ones.
+    void set_rx_timestamps(rx_timestamping mode);
+
+    // Kernel receive time of the last frame from read_message: when the
+    // read that completed it came off the wire. Empty with timestamps off.
+    std::optional<rx_time> rx_timestamp() const { return rx_timestamp_; }
+
+    // Offer permessage-deflate from the next connect() on
+    void set_compression(const compression_options &opts);
+
+    // Safe to call from any thread
+    compression_metrics compression_stats() const;
+
+    // Append every frame read or queued to `recorder`; nullptr to stop
+    void set_recorder(frame_recorder *recorder) { recorder_ = recorder; }
+
   private:
-    boost::asio::io_context io_context_;
-    std::unique_ptr<ssl_websocket_type> ssl_ws_;
-    std::unique_ptr<plain_websocket_type> plain_ws_;
-    bool using_ssl_;
+    struct pending_frame {
+        std::size_t offset;
+        std::size_t size;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    // abort and forget the previous connection, if any
+    void reset();
+
+    // call `f` with the current transport, if any
+    template <typename F> void with_transport(F &&f);
+
+    // Run the reactor for one handler, or just poll in spin mode. Returns
+    // the number of handlers run.
+    std::size_t run_until(std::chrono::steady_clock::time_point deadline);
+
+    // Call `run` (which runs the reactor), charging its CPU time to
+    // inflate_cpu_ns_ if it completed anything
+    template <typename F> std::size_t run_read(F &&run);
+
+    void enqueue(std::size_t offset);
+    void start_write();
+    void write_next();
+    void on_write_done(boost::system::error_code ec);
+
+    // null when the io_context was passed in
+    std::unique_ptr<boost::asio::io_context> own_io_;
+    boost::asio::io_context &io_context_;
+    boost::beast::flat_buffer buffer_;
+    // Each operation visits the transport once; below that every call is
+    // to a concrete type
+    std::variant<std::monostate, tls_transport, tcp_transport,
+                 memory_transport, replay_transport>
+        transport_;
+
+    bool spin_ = false;
+    std::optional<std::chrono::microseconds> busy_poll_;
+    rx_timestamping rx_mode_ = rx_timestamping::off;
+    std::optional<rx_time> rx_timestamp_;
+    frame_recorder *recorder_ = nullptr;
+    compression_options compression_;
+    // transport byte count already added to wire_bytes_
+    std::uint64_t wire_seen_ = 0;
+    // one async_read stays outstanding across timeouts
+    bool read_pending_ = false;
+    bool read_done_ = false;
+    boost::system::error_code read_ec_;
+
+    // frames waiting for the current write chain to finish
+    std::string queued_;
+    std::vector<pending_frame> queued_frames_;
+    // the chain being written
+    std::string writing_;
+    std::vector<pending_frame> writing_frames_;
+    std::size_t write_index_ = 0;
+    bool write_in_flight_ = false;
+
+    std::atomic<std::size_t> queue_depth_{0};
+    std::atomic<std::size_t> write_high_water_{0};
+    std::atomic<std::uint64_t> frames_sent_{0};
+    std::atomic<std::int64_t> max_write_latency_ns_{0};
+    std::atomic<std::uint64_t> total_write_latency_ns_{0};
+
+    std::atomic<bool> compressed_{false};
+    std::atomic<std::uint64_t> messages_read_{0};
+    std::atomic<std::uint64_t> payload_bytes_{0};
+    std::atomic<std::uint64_t> wire_bytes_{0};
+    std::atomic<std::int64_t> inflate_cpu_ns_{0};
 };
 } // namespace td365
@@ -12,64 +12,383 @@
 #include <boost/url/url.hpp>
 #include <boost/url/url_view.hpp>
 #include <chrono>
+#include <deque>
 #include <future>
 #include <nlohmann/json_fwd.hpp>
+#include <random>
+#include <span>
 #include <string>
+#include <string_view>
+#include <td365/latency.h>
+#include <td365/outbound.h>
+#include <td365/quote_cache.h>
+#include <td365/sequence_tracker.h>
 #include <td365/types.h>
+#include <td365/verify.h>
 #include <td365/ws.h>
+#include <unordered_set>
 #include <vector>
 
 namespace td365 {
 
+// Hands a batch to `h.on_ticks` if it has one, else tick by tick to on_tick.
+// A handler taking on_ticks(ticks, exact) also gets the exact prices of
+// price_mode::fixed, see tick_batch_event::exact.
+template <typename H>
+void deliver_ticks(H &h, std::span<const tick> ticks,
+                   std::span<const tick_prices> exact = {}) {
+    if constexpr (requires { h.on_ticks(ticks, exact); }) {
+        h.on_ticks(ticks, exact);
+    } else if constexpr (requires { h.on_ticks(ticks); }) {
+        h.on_ticks(ticks);
+    } else {
+        for (const auto &t : ticks) {
+            h.on_tick(tick{t});
+        }
+    }
+}
+
+// How ws_client recovers from a dropped connection. The first attempt is
+// made straight away, then the delay doubles up to max_delay.
+struct reconnect_options {
+    bool enabled = true;
+    std::chrono::milliseconds initial_delay{250};
+    std::chrono::milliseconds max_delay{30000};
+    // each delay is scaled by a random factor in [1 - jitter, 1] so clients
+    // dropped together don't reconnect together
+    double jitter = 0.5;
+    // consecutive failed attempts before giving up with
+    // connection_closed_event, 0 to retry forever
+    int max_attempts = 10;
+};
+
+struct reconnect_metrics {
+    std::uint64_t reconnects;
+    std::uint64_t failed_attempts;
+    // from noticing the drop to being authenticated again
+    std::chrono::nanoseconds last_reconnect_duration;
+    // from the last frame before the drop to the first frame after it
+    std::chrono::nanoseconds last_gap;
+};
+
+// Throw if `opts` is out of range. ws_client's setters check for
+// themselves; these are for callers that hand the options to the thread
+// running the client, so a bad value fails on the caller's thread.
+void check_reconnect_options(const reconnect_options &opts);
+void check_compression_options(const compression_options &opts);
+
 class ws_client {
   public:
     explicit ws_client();
 
+    // Connect on a shared io_context, see ws(io_context &)
+    explicit ws_client(boost::asio::io_context &ioc);
+
     ~ws_client();
 
+    // The shared io_context this client was made with, if any
+    boost::asio::io_context *io_context() const { return io_; }
+
+    // connect() or replay() has been called
+    bool connected() const { return ws_ != nullptr; }
+
+    // The next read_and_process_message() has something to do without
+    // waiting on the connection
+    bool ready() const { return ws_ && ws_->ready(); }
+
+    // Abort the connection without a close handshake; connect() again
+    // before using the client. With a shared io_context, call from the
+    // thread that runs it.
+    void disconnect();
+
     void connect(boost::urls::url_view url, const std::string &login_id,
                  const std::string &token);
 
+    // Instead of connecting, decode the frames of a recorded session (see
+    // frame_recorder) through the normal path. Replies and subscriptions
+    // go nowhere; the end of the capture closes the connection.
+    void replay(const replay_options &opts);
+
     event
     read_and_process_message(std::optional<std::chrono::milliseconds> timeout);
 
+    // Decode a single websocket frame. Returns std::nullopt for frames that
+    // are handled internally (heartbeats, connect/auth responses, ...).
+    std::optional<event> process_message(std::string_view buf);
+
+    // Like process_message() but calls the matching handler on `h` directly
+    // (see UserCallbacksLike) instead of returning an event.
+    template <typename H> void dispatch(std::string_view buf, H &h) {
+        deliver(decode(buf, false), h);
+    }
+
+    // Read and dispatch() one frame. Returns false once the connection is
+    // closed for good; throws on other read errors. Reconnects are passed
+    // to `h.on_reconnected` if it has one.
+    template <typename H>
+    bool pump(H &h, std::optional<std::chrono::milliseconds> timeout) {
+        return deliver(read_and_decode(timeout), h);
+    }
+
     void send(const nlohmann::json &);
 
+    // Subscription changes are reconciled against what the server already
+    // has, so only the difference is sent, paced by
+    // set_subscription_pacing(). Sends happen as the connection is read.
     void subscribe(int quote_id);
+    void subscribe(std::span<const int> quote_ids);
 
     void unsubscribe(int quote_id);
+    void unsubscribe(std::span<const int> quote_ids);
+
+    // Make `quote_ids` the complete subscription set
+    void set_subscriptions(std::span<const int> quote_ids);
+
+    const std::unordered_set<int> &subscriptions() const { return wanted_; }
+
+    // The subscribe for `quote_id` has been sent, rather than still held
+    // back by pacing
+    bool on_server(int quote_id) const { return on_server_.contains(quote_id); }
+
+    // Send at most `burst` subscribe/unsubscribe frames per `interval`
+    void set_subscription_pacing(std::size_t burst,
+                                 std::chrono::milliseconds interval);
+
+    void set_price_mode(price_mode mode) { price_mode_ = mode; }
+
+    // Outbound queue depth and write latency
+    send_metrics write_metrics() const { return ws_->metrics(); }
+
+    // Socket side of spin mode; thread tuning is up to the caller
+    void set_spin_mode(const spin_options &opts);
+
+    // Kernel receive timestamps, kept across reconnects
+    void set_rx_timestamps(rx_timestamping mode);
+
+    // Kernel receive time of the last frame read, see ws::rx_timestamp
+    std::optional<rx_time> rx_timestamp() const { return frame_rx_; }
+
+    // Offer permessage-deflate from the next connect or reconnect on
+    void set_compression(const compression_options &opts);
+
+    // Safe to call from any thread
+    compression_metrics compression_stats() const {
+        return ws_ ? ws_->compression_stats() : compression_metrics{};
+    }
+
+    // Capture raw frames to `recorder`, kept across reconnects; nullptr to
+    // stop
+    void set_frame_recorder(frame_recorder *recorder);
+
+    void set_reconnect_options(const reconnect_options &opts);
+
+    // Safe to call from any thread
+    reconnect_metrics reconnect_stats() const;
+
+    // Report each sequence gap as a gap_event (or on_gap) after the batch
+    // it was found in. Gaps are counted either way, but only reported by
+    // the reading calls (read_and_process_message(), pump()): those given
+    // a single frame (process_message(), dispatch()) can return one event.
+    void set_gap_events(bool enabled) { gap_events_ = enabled; }
+
+    // Safe to call from any thread
+    sequence_metrics sequence_stats() const { return sequences_.metrics(); }
+
+    // Keep `cache` updated with every decoded tick; nullptr to stop
+    void set_quote_cache(quote_cache *cache) { quote_cache_ = cache; }
+
+    // Record receive and decode latencies into `recorder`; nullptr to stop
+    void set_latency_recorder(latency_recorder *recorder) {
+        latency_ = recorder;
+    }
+
+    latency_recorder *latency() const { return latency_; }
+
+    // When the last batch of ticks was decoded, if recording latency
+    std::chrono::system_clock::time_point decoded_at() const {
+        return decoded_at_;
+    }
+
+    // parse_to_delivery of the last batch, for whoever hands it over
+    void record_delivery() {
+        if (latency_) {
+            latency_->record(latency_stage::parse_to_delivery,
+                             std::chrono::system_clock::now() - decoded_at_);
+        }
+    }
 
   private:
-    std::optional<event> process_subscribe_response(const nlohmann::json &msg);
+    // What a frame decoded to. The payload stays in the matching member
+    // (ticks_, summary_, ...) until the next decode.
+    enum class decoded {
+        none, // handled internally
+        timeout,
+        closed,
+        error, // read_error_
+        ticks,
+        account_summary,
+        account_details,
+        trade_established,
+        reconnected,
+        gap, // gap_
+    };
+
+    enum class link_state {
+        up,
+        // waiting for next_attempt_at_
+        reconnecting,
+        // gave up, or reconnects are disabled
+        down,
+    };
+
+    // decode_frame(), then sequence checking and caching of the ticks it
+    // produced. Gaps are kept for the next read if `report_gaps`.
+    decoded decode(std::string_view buf, bool report_gaps);
+
+    decoded decode_frame(std::string_view buf);
+
+    // where the parser puts the next tick's exact prices; nullptr in
+    // floating mode
+    tick_prices *next_exact();
+
+    decoded read_and_decode(std::optional<std::chrono::milliseconds> timeout);
 
-    std::optional<event> process_reconnect_response(const nlohmann::json &msg);
+    event to_event(decoded kind);
 
-    std::optional<event> process_heartbeat(const nlohmann::json &msg);
+    template <typename H> bool deliver(decoded kind, H &h) {
+        switch (kind) {
+        case decoded::ticks:
+            record_delivery();
+            deliver_ticks(h, std::span<const tick>(ticks_), exact_);
+            break;
+        case decoded::account_summary:
+            h.on_account_summary(std::move(summary_));
+            break;
+        case decoded::account_details:
+            h.on_account_details(std::move(details_));
+            break;
+        case decoded::trade_established:
+            h.on_trade_established(std::move(trade_));
+            break;
+        case decoded::reconnected:
+            if constexpr (requires { h.on_reconnected(reconnected_event{}); }) {
+                h.on_reconnected(last_reconnect());
+            }
+            break;
+        case decoded::gap:
+            if constexpr (requires { h.on_gap(gap_); }) {
+                h.on_gap(gap_);
+            }
+            break;
+        case decoded::closed:
+            return false;
+        case decoded::error:
+            throw fail("ws_client: read failed: {}", read_error_.message());
+        case decoded::none:
+        case decoded::timeout:
+            break;
+        }
+        return true;
+    }
 
-    std::optional<event> process_connect_response(const nlohmann::json &msg,
-                                                  const std::string &login_id,
-                                                  const std::string &token);
+    // on io_ when we have one
+    std::unique_ptr<ws> make_ws();
 
-    std::optional<event>
-    process_authentication_response(const nlohmann::json &msg);
+    // connect and authenticate against stored_url_
+    void open();
 
-    event process_price_data(const nlohmann::json &msg);
-    event process_account_summary(const nlohmann::json &msg);
-    event process_account_details(const nlohmann::json &msg);
-    event process_trade_established(const nlohmann::json &msg);
+    // start the reconnect state machine after a read failure
+    void connection_lost(const boost::system::error_code &ec);
 
+    // wait out the backoff (bounded by `timeout`) and make one attempt
+    decoded reconnect(std::optional<std::chrono::milliseconds> timeout);
+
+    std::chrono::milliseconds backoff_delay(int attempt);
+
+    reconnected_event last_reconnect() const;
+
+    // queue a quote whose wanted state may differ from the server's
+    void mark_dirty(int quote_id);
+
+    // send pending subscription changes allowed by the pacing window
+    void flush_subscriptions();
+
+    decoded process_subscribe_response(const nlohmann::json &msg);
+
+    decoded process_reconnect_response(const nlohmann::json &msg);
+
+    decoded process_heartbeat(const nlohmann::json &msg);
+
+    decoded process_connect_response(const nlohmann::json &msg,
+                                     const std::string &login_id,
+                                     const std::string &token);
+
+    decoded process_authentication_response(const nlohmann::json &msg);
+
+    decoded process_price_data(const nlohmann::json &msg);
+    decoded process_account_summary(const nlohmann::json &msg);
+    decoded process_account_details(const nlohmann::json &msg);
+    decoded process_trade_established(const nlohmann::json &msg);
+
+    boost::asio::io_context *io_ = nullptr;
     std::unique_ptr<ws> ws_;
+    outbound_encoder encoder_;
     std::string supported_version_ = "1.0.0.6";
     std::string login_id_;
     std::string token_;
 
     // Connection state tracking
     std::string connection_id_;
-    std::vector<int> subscribed_;
+    // quotes the caller asked for, and quotes the server has been told
+    // about on this connection
+    std::unordered_set<int> wanted_;
+    std::unordered_set<int> on_server_;
+    std::deque<int> pending_;
+    std::size_t pacing_burst_ = 100;
+    std::chrono::milliseconds pacing_interval_{10};
+    std::chrono::steady_clock::time_point window_start_{};
+    std::size_t window_sent_ = 0;
+
+    // Reused across price frames, backs tick_batch_event::data and, with
+    // price_mode::fixed, ::exact
+    std::vector<tick> ticks_;
+    std::vector<tick_prices> exact_;
+    account_summary summary_{};
+    account_details details_{};
+    trade_details trade_{};
+    boost::system::error_code read_error_;
+    price_mode price_mode_ = price_mode::floating;
+
+    sequence_tracker sequences_;
+    quote_cache *quote_cache_ = nullptr;
+    latency_recorder *latency_ = nullptr;
+    rx_timestamping rx_mode_ = rx_timestamping::off;
+    compression_options compression_;
+    frame_recorder *recorder_ = nullptr;
+    std::optional<rx_time> frame_rx_;
+    std::chrono::system_clock::time_point decoded_at_{};
+    bool gap_events_ = false;
+    // found but not yet reported, oldest first
+    std::vector<gap_event> gaps_;
+    std::size_t gaps_reported_ = 0;
+    gap_event gap_{};
 
     // Reconnection state
     boost::urls::url stored_url_;
-    std::chrono::milliseconds reconnect_delay_ =
-        std::chrono::milliseconds(1000);
+    reconnect_options reconnect_;
+    // a replay has nothing to reconnect to, whatever reconnect_ says
+    bool replaying_ = false;
+    link_state link_ = link_state::up;
+    int attempt_ = 0;
+    std::chrono::steady_clock::time_point dropped_at_;
+    std::chrono::steady_clock::time_point next_attempt_at_;
+    std::chrono::steady_clock::time_point last_frame_at_;
+    // set between a reconnect and the first frame that follows it
+    bool gap_open_ = false;
+    std::minstd_rand jitter_rng_{std::random_device{}()};
+    std::atomic<std::uint64_t> reconnects_{0};
+    std::atomic<std::uint64_t> failed_attempts_{0};
+    std::atomic<std::int64_t> last_reconnect_ns_{0};
+    std::atomic<std::int64_t> last_gap_ns_{0};
 };
 } // namespace td365
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <algorithm>
+#include <td365/conflator.h>
+
+namespace td365 {
+
+conflator::conflator(const conflation_options &opts) : opts_(opts) {}
+
+void conflator::update(std::span<const tick> ticks) {
+    std::lock_guard lock(mutex_);
+    for (const auto &t : ticks) {
+        auto slot = index_.insert(t.quote_id);
+        if (slot == latest_.size()) {
+            latest_.push_back(t);
+            dirty_.push_back(0);
+            delivered_at_.push_back({});
+        } else {
+            latest_[slot] = t;
+        }
+
+        if (dirty_[slot]) {
+            ++dropped_;
+        } else {
+            dirty_[slot] = 1;
+            dirty_slots_.push_back(slot);
+        }
+    }
+    updates_ += ticks.size();
+}
+
+std::span<const tick>
+conflator::take(std::chrono::steady_clock::time_point now) {
+    out_.clear();
+
+    std::lock_guard lock(mutex_);
+    held_.clear();
+    next_due_ = std::chrono::steady_clock::time_point::max();
+    for (auto slot : dirty_slots_) {
+        auto due = delivered_at_[slot] + opts_.min_interval;
+        if (opts_.min_interval.count() > 0 && now < due) {
+            held_.push_back(slot);
+            next_due_ = std::min(next_due_, due);
+            continue;
+        }
+        out_.push_back(latest_[slot]);
+        dirty_[slot] = 0;
+        delivered_at_[slot] = now;
+    }
+    dirty_slots_.swap(held_);
+    delivered_ += out_.size();
+    return out_;
+}
+
+std::chrono::steady_clock::time_point conflator::next_due() const {
+    std::lock_guard lock(mutex_);
+    return next_due_;
+}
+
+bool conflator::holding() const {
+    return next_due() != std::chrono::steady_clock::time_point::max();
+}
+
+conflation_metrics conflator::metrics() const {
+    std::lock_guard lock(mutex_);
+    return {
+        .updates = updates_,
+        .delivered = delivered_,
+        .dropped = dropped_,
+        .quotes = latest_.size(),
+    };
+}
+} // namespace td365
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <cmath>
+#include <ostream>
+#include <td365/fixed_price.h>
+
+namespace td365 {
+
+fixed_price fixed_price::from_double(double value, std::int32_t decimals) {
+    auto scaled = value * static_cast<double>(pow10_of(decimals));
+    // 2^63, the first double past the int64 range
+    verify(std::isfinite(scaled) && std::fabs(scaled) < 9223372036854775808.0,
+           "fixed_price: {} doesn't fit at {} decimals", value, decimals);
+    return {std::llround(scaled), decimals};
+}
+
+std::string fixed_price::to_string() const {
+    auto magnitude = mantissa < 0 ? 0 - static_cast<std::uint64_t>(mantissa)
+                                  : static_cast<std::uint64_t>(mantissa);
+    auto digits = std::to_string(magnitude);
+    pow10_of(decimals);
+    auto d = static_cast<size_t>(decimals);
+
+    if (d > 0) {
+        if (digits.size() <= d) {
+            digits.insert(0, d + 1 - digits.size(), '0');
+        }
+        digits.insert(digits.size() - d, 1, '.');
+    }
+    if (mantissa < 0) {
+        digits.insert(0, 1, '-');
+    }
+    return digits;
+}
+
+std::ostream &operator<<(std::ostream &os, const fixed_price &p) {
+    return os << p.to_string();
+}
+
+} // namespace td365
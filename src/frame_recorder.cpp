@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <td365/frame_recorder.h>
+#include <td365/verify.h>
+#include <unistd.h>
+
+namespace td365 {
+
+namespace {
+constexpr std::size_t padded(std::size_t n) {
+    return (n + 7) & ~std::size_t{7};
+}
+
+std::int64_t since_epoch_ns(auto time_point) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               time_point.time_since_epoch())
+        .count();
+}
+} // namespace
+
+frame_recorder::frame_recorder(capture_options opts) : opts_(std::move(opts)) {
+    verify(opts_.max_file_size > sizeof(capture::file_header),
+           "frame_recorder: max_file_size too small");
+    open_next(0);
+}
+
+frame_recorder::~frame_recorder() { close_current(); }
+
+void frame_recorder::record(capture::direction dir, std::string_view payload,
+                            std::chrono::steady_clock::time_point at) {
+    verify(payload.size() <= std::numeric_limits<std::uint32_t>::max(),
+           "frame_recorder: frame of {} bytes is too large", payload.size());
+
+    auto need = sizeof(capture::record_header) + padded(payload.size());
+    if (offset_ + need > map_size_ ||
+        (opts_.max_file_age && at - opened_at_ >= *opts_.max_file_age)) {
+        close_current();
+        open_next(need);
+    }
+
+    // The payload and the rest of the header go in before the direction,
+    // which is stored last: until then the record still reads as the end
+    // of the file, so a crash part way through can't leave a record whose
+    // payload is missing
+    auto *rec = map_ + offset_;
+    std::memcpy(rec + sizeof(capture::record_header), payload.data(),
+                payload.size());
+    capture::record_header h{
+        .size = static_cast<std::uint32_t>(payload.size()),
+        .dir = capture::direction::none,
+        .reserved = {},
+        .steady_ns = since_epoch_ns(at),
+    };
+    std::memcpy(rec, &h, sizeof(h));
+    std::atomic_ref(*reinterpret_cast<capture::direction *>(
+                        rec + offsetof(capture::record_header, dir)))
+        .store(dir, std::memory_order_release);
+    // padding is still zero from the fresh file
+    offset_ += need;
+
+    frames_.store(frames_.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+    bytes_.store(bytes_.load(std::memory_order_relaxed) + payload.size(),
+                 std::memory_order_relaxed);
+}
+
+void frame_recorder::rotate() {
+    close_current();
+    open_next(0);
+}
+
+void frame_recorder::flush() {
+    if (map_ && ::msync(map_, offset_, MS_ASYNC) != 0) {
+        spdlog::warn("frame_recorder: msync {} failed: {}", path_.string(),
+                     std::strerror(errno));
+    }
+}
+
+capture_metrics frame_recorder::metrics() const {
+    return {
+        .frames = frames_.load(std::memory_order_relaxed),
+        .bytes = bytes_.load(std::memory_order_relaxed),
+        .files = files_.load(std::memory_order_relaxed),
+    };
+}
+
+void frame_recorder::open_next(std::size_t min_size) {
+    auto now = std::chrono::system_clock::now();
+    auto unix_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            now.time_since_epoch())
+            .count();
+    path_ = opts_.directory / std::format("{}-{}-{}.cap", opts_.prefix,
+                                          unix_ms, file_index_++);
+
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw fail("frame_recorder: cannot create {}: {}", path_.string(),
+                   std::strerror(errno));
+    }
+
+    // allocate the blocks up front: a full disk is an error here rather
+    // than a SIGBUS on some later write into the mapping
+    map_size_ =
+        std::max(opts_.max_file_size, sizeof(capture::file_header) + min_size);
+    if (int err = ::posix_fallocate(fd_, 0, static_cast<off_t>(map_size_));
+        err != 0) {
+        ::close(fd_);
+        fd_ = -1;
+        throw fail("frame_recorder: cannot allocate {} bytes for {}: {}",
+                   map_size_, path_.string(), std::strerror(err));
+    }
+
+    void *p = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd_, 0);
+    if (p == MAP_FAILED) {
+        auto err = errno;
+        ::close(fd_);
+        fd_ = -1;
+        throw fail("frame_recorder: cannot map {}: {}", path_.string(),
+                   std::strerror(err));
+    }
+    map_ = static_cast<char *>(p);
+    ::madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+    capture::file_header h{};
+    std::memcpy(h.magic, capture::magic, sizeof(h.magic));
+    h.version = capture::version;
+    h.created_unix_ns = since_epoch_ns(now);
+    h.created_steady_ns = since_epoch_ns(std::chrono::steady_clock::now());
+    std::memcpy(map_, &h, sizeof(h));
+
+    offset_ = sizeof(h);
+    opened_at_ = std::chrono::steady_clock::now();
+    files_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void frame_recorder::close_current() {
+    if (map_) {
+        ::munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        // drop the unused preallocated tail
+        if (::ftruncate(fd_, static_cast<off_t>(offset_)) != 0) {
+            spdlog::warn("frame_recorder: truncating {} failed: {}",
+                         path_.string(), std::strerror(errno));
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+    map_size_ = 0;
+    offset_ = 0;
+}
+
+capture_reader::capture_reader(const std::filesystem::path &path) {
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        throw fail("capture_reader: cannot open {}: {}", path.string(),
+                   std::strerror(errno));
+    }
+
+    struct stat st{};
+    if (::fstat(fd_, &st) != 0 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(header_)) {
+        close();
+        throw fail("capture_reader: {} is not a capture file", path.string());
+    }
+    map_size_ = static_cast<std::size_t>(st.st_size);
+
+    void *p = ::mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED) {
+        auto err = errno;
+        close();
+        throw fail("capture_reader: cannot map {}: {}", path.string(),
+                   std::strerror(err));
+    }
+    map_ = static_cast<const char *>(p);
+    ::madvise(const_cast<char *>(map_), map_size_, MADV_SEQUENTIAL);
+
+    std::memcpy(&header_, map_, sizeof(header_));
+    offset_ = sizeof(header_);
+    if (std::memcmp(header_.magic, capture::magic, sizeof(header_.magic)) !=
+            0 ||
+        header_.version != capture::version) {
+        close();
+        throw fail("capture_reader: {} is not a version {} capture file",
+                   path.string(), capture::version);
+    }
+}
+
+capture_reader::~capture_reader() { close(); }
+
+void capture_reader::close() {
+    if (map_) {
+        ::munmap(const_cast<char *>(map_), map_size_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+std::optional<captured_frame> capture_reader::next() {
+    if (offset_ + sizeof(capture::record_header) > map_size_) {
+        return std::nullopt;
+    }
+    capture::record_header h;
+    std::memcpy(&h, map_ + offset_, sizeof(h));
+    auto start = offset_ + sizeof(h);
+    // a zero header, or a record cut short by a crash, ends the file
+    if (h.dir == capture::direction::none || start + h.size > map_size_) {
+        return std::nullopt;
+    }
+    offset_ = start + padded(h.size);
+
+    return captured_frame{
+        .dir = h.dir,
+        .at = std::chrono::steady_clock::time_point(
+            std::chrono::nanoseconds(h.steady_ns)),
+        .payload = std::string_view(map_ + start, h.size),
+    };
+}
+} // namespace td365
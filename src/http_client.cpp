@@ -86,12 +86,20 @@ const http_headers application_json_headers{
     {to_string(http::field::content_type), "application/json; charset=utf-8"}};
 
 http_client::http_client(boost::urls::url url)
-    : stream_(io_context_, ssl_ctx()), base_url_(std::move(url)),
+    : own_io_(std::make_unique<net::io_context>()), io_context_(*own_io_),
+      stream_(io_context_, ssl_ctx()), base_url_(std::move(url)),
       jar_(base_url_.host() + ".cookies"),
       default_headers_(create_default_headers()) {
     default_headers_.emplace(to_string(http::field::host), base_url_.host());
 }
 
+http_client::http_client(boost::urls::url url, net::io_context &ioc)
+    : io_context_(ioc), stream_(io_context_, ssl_ctx()),
+      base_url_(std::move(url)), jar_(base_url_.host() + ".cookies"),
+      default_headers_(create_default_headers()) {
+    default_headers_.emplace(to_string(http::field::host), base_url_.host());
+}
+
 void http_client::ensure_connected() {
     if (!stream_.lowest_layer().is_open()) {
         // NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast)
@@ -105,7 +113,8 @@ void http_client::ensure_connected() {
                  boost::asio::error::get_ssl_category()}};
         }
 
-        auto const endpoints = td_resolve(base_url_.host(), "443");
+        auto const endpoints =
+            td_resolve(stream_.get_executor(), base_url_.host(), "443");
         boost::asio::connect(beast::get_lowest_layer(stream_), endpoints);
 
         stream_.handshake(ssl::stream_base::client);
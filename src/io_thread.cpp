@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <spdlog/spdlog.h>
+#include <td365/io_thread.h>
+#include <td365/session_pool.h>
+#include <td365/ws_client.h>
+
+namespace td365 {
+
+// How long a read blocks before the I/O thread checks for posted commands
+// and shutdown.
+constexpr auto io_poll_interval = std::chrono::milliseconds(10);
+
+io_thread::io_thread(ws_client &client, std::size_t capacity,
+                     std::function<void()> housekeeping, conflator *conflate,
+                     wake_signal *also_notify)
+    : client_(client), ring_(capacity), housekeeping_(std::move(housekeeping)),
+      also_notify_(also_notify), conflator_(conflate),
+      latency_(client.latency()),
+      thread_([this](std::stop_token stop) { run(stop); }) {}
+
+io_thread::io_thread(ws_client &client, session_pool &pool,
+                     std::size_t capacity, std::function<void()> housekeeping,
+                     conflator *conflate)
+    : client_(client), ring_(capacity), housekeeping_(std::move(housekeeping)),
+      conflator_(conflate), latency_(client.latency()), pool_(&pool) {
+    pool.add(*this);
+}
+
+io_thread::~io_thread() {
+    if (pool_) {
+        pool_->remove(*this);
+    }
+}
+
+void io_thread::run(std::stop_token stop) {
+    spdlog::info("io_thread: started, ring capacity {}", ring_.capacity());
+
+    while (!stop.stop_requested() &&
+           step(io_poll_interval, stop) != step_result::done) {
+    }
+
+    stopped();
+
+    spdlog::info("io_thread: stopped");
+}
+
+io_thread::step_result io_thread::step(std::chrono::milliseconds timeout,
+                                       const std::stop_token &stop) {
+    bool flushed = flush_deferred();
+    if (closing_) {
+        if (!flushed) {
+            return step_result::idle;
+        }
+        stopped();
+        return step_result::done;
+    }
+    drain_commands(stop);
+    // a pooled session is attached before it connects, and td365 may start
+    // its own thread before connecting too
+    if (!client_.connected()) {
+        if (!pool_) {
+            std::unique_lock lock(commands_mutex_);
+            commands_posted_.wait_for(lock, stop, timeout,
+                                      [this] { return !commands_.empty(); });
+        }
+        return step_result::idle;
+    }
+
+    event evt;
+    try {
+        evt = client_.read_and_process_message(timeout);
+    } catch (const std::exception &e) {
+        push(error_event{e.what(), std::current_exception()}, stop);
+        return step_result::busy;
+    }
+
+    if (housekeeping_) {
+        housekeeping_();
+    }
+
+    if (std::holds_alternative<timeout_event>(evt)) {
+        return step_result::idle;
+    }
+
+    if (std::holds_alternative<connection_closed_event>(evt) ||
+        std::holds_alternative<error_event>(evt)) {
+        push(std::move(evt), stop);
+        if (!deferred_.empty()) {
+            // the steps that hand it on finish the session
+            closing_ = true;
+            return step_result::idle;
+        }
+        // after the final push, and notified, so a consumer that found
+        // the ring empty in between still wakes up to see it
+        stopped();
+        return step_result::done;
+    }
+    push(std::move(evt), stop);
+    return step_result::busy;
+}
+
+bool io_thread::ready() const {
+    return client_.ready() || has_commands_.load(std::memory_order_acquire);
+}
+
+void io_thread::push(event &&evt, const std::stop_token &stop) {
+    auto *batch = std::get_if<tick_batch_event>(&evt);
+
+    bool wake_up = false;
+    if (batch && conflator_) {
+        conflator_->update(batch->data);
+        // one wake-up in the ring at a time; the consumer clears the flag
+        // before it takes from the conflator
+        if (conflated_signalled_.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        batch = nullptr;
+        wake_up = true;
+    }
+
+    slot *s = nullptr;
+    // nothing overtakes an event still waiting for room
+    if (deferred_.empty()) {
+        s = ring_.claim();
+    }
+    if (!s) {
+        if (wake_up) {
+            // The consumer drains the ring before it takes from the
+            // conflator anyway; it only needs waking if it is blocked
+            conflated_signalled_.store(false, std::memory_order_release);
+            notify();
+            return;
+        }
+        if (batch) {
+            // Never stall the socket for market data. The ring is the
+            // consumer's to pop, so it is this, the newest batch, that is
+            // lost; its quotes are stale until they tick again.
+            dropped_batches_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // control events must not be lost
+        if (pool_) {
+            deferred_.push_back(std::move(evt));
+            return;
+        }
+        while (!(s = ring_.claim())) {
+            if (stop.stop_requested()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    s->conflated = wake_up;
+    if (wake_up) {
+        s->evt = timeout_event{};
+    } else if (batch) {
+        // ws_client reuses its tick buffer for the next frame, so copy into
+        // storage owned by the slot
+        s->ticks.assign(batch->data.begin(), batch->data.end());
+        s->exact.assign(batch->exact.begin(), batch->exact.end());
+        s->evt = tick_batch_event{s->ticks, batch->received, s->exact};
+        s->decoded_at = client_.decoded_at();
+    } else {
+        s->evt = std::move(evt);
+    }
+    ring_.publish();
+    notify();
+}
+
+bool io_thread::flush_deferred() {
+    while (!deferred_.empty()) {
+        auto *s = ring_.claim();
+        if (!s) {
+            return false;
+        }
+        s->conflated = false;
+        s->evt = std::move(deferred_.front());
+        deferred_.pop_front();
+        ring_.publish();
+        notify();
+    }
+    return true;
+}
+
+void io_thread::stopped() {
+    running_.store(false, std::memory_order_release);
+    notify();
+}
+
+void io_thread::notify() {
+    wakeup_.notify();
+    if (also_notify_) {
+        also_notify_->notify();
+    }
+}
+
+void io_thread::drain_commands(const std::stop_token &stop) {
+    if (!has_commands_.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::vector<command> pending;
+    {
+        std::lock_guard lock(commands_mutex_);
+        pending.swap(commands_);
+        has_commands_.store(false, std::memory_order_release);
+    }
+
+    for (auto &cmd : pending) {
+        // reported like a failed read; the rest of the commands still run
+        try {
+            cmd(client_);
+        } catch (const std::exception &e) {
+            push(error_event{e.what(), std::current_exception()}, stop);
+        }
+    }
+}
+
+void io_thread::post(command cmd) {
+    {
+        std::lock_guard lock(commands_mutex_);
+        commands_.push_back(std::move(cmd));
+        has_commands_.store(true, std::memory_order_release);
+    }
+    commands_posted_.notify_one();
+    if (pool_) {
+        // the pool thread may be waiting on the reactor
+        pool_->wake(*this);
+    }
+}
+
+event io_thread::take_front() {
+    front_taken_ = true;
+    auto *s = ring_.front();
+    if (latency_ && std::holds_alternative<tick_batch_event>(s->evt)) {
+        latency_->record(latency_stage::parse_to_delivery,
+                         std::chrono::system_clock::now() - s->decoded_at);
+    }
+    return std::move(s->evt);
+}
+
+std::optional<event> io_thread::next() {
+    if (front_taken_) {
+        ring_.pop();
+        front_taken_ = false;
+    }
+
+    while (auto *s = ring_.front()) {
+        if (!s->conflated) {
+            return take_front();
+        }
+        ring_.pop();
+        conflated_signalled_.store(false, std::memory_order_release);
+    }
+
+    if (conflator_) {
+        if (auto ticks = conflator_->take(); !ticks.empty()) {
+            return tick_batch_event{ticks, std::nullopt};
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<event> io_thread::try_pop() { return next(); }
+
+event io_thread::wait(std::optional<std::chrono::milliseconds> timeout) {
+    auto deadline = timeout ? std::chrono::steady_clock::now() + *timeout
+                            : std::chrono::steady_clock::time_point::max();
+    while (true) {
+        // taken first, so a push after the checks below still wakes us
+        auto epoch = wakeup_.epoch();
+        if (auto evt = next()) {
+            return std::move(*evt);
+        }
+        // closed takes precedence over a timeout, timed or not
+        if (!running_.load(std::memory_order_acquire)) {
+            return connection_closed_event{};
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return timeout_event{};
+        }
+        // quotes held back by the conflation rate limit fall due without
+        // anything arriving in the ring
+        auto until = deadline;
+        if (conflator_) {
+            until = std::min(until, conflator_->next_due());
+        }
+        wakeup_.wait_until(epoch, until);
+    }
+}
+
+ring_metrics io_thread::metrics() const {
+    return {
+        .depth = ring_.size(),
+        .capacity = ring_.capacity(),
+        .high_water = ring_.high_water(),
+        .dropped_batches = dropped_batches_.load(std::memory_order_relaxed),
+    };
+}
+} // namespace td365
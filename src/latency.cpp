@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <td365/latency.h>
+
+namespace td365 {
+
+namespace {
+constexpr std::uint64_t sub_bucket_count =
+    std::uint64_t{1} << latency_histogram::sub_bucket_bits;
+
+double to_us(std::chrono::nanoseconds ns) {
+    return std::chrono::duration<double, std::micro>(ns).count();
+}
+} // namespace
+
+std::size_t latency_histogram::bucket_of(std::uint64_t ns) {
+    if (ns < sub_bucket_count) {
+        return static_cast<std::size_t>(ns);
+    }
+    auto magnitude = std::bit_width(ns) - 1;
+    if (magnitude > max_magnitude) {
+        return bucket_count - 1;
+    }
+    auto sub = (ns >> (magnitude - sub_bucket_bits)) & (sub_bucket_count - 1);
+    return static_cast<std::size_t>(
+        static_cast<std::uint64_t>(magnitude - sub_bucket_bits + 1) *
+            sub_bucket_count +
+        sub);
+}
+
+std::uint64_t latency_histogram::bucket_lower(std::size_t bucket) {
+    if (bucket < sub_bucket_count) {
+        return bucket;
+    }
+    auto magnitude = bucket / sub_bucket_count + sub_bucket_bits - 1;
+    auto sub = bucket % sub_bucket_count;
+    return (sub_bucket_count + sub) << (magnitude - sub_bucket_bits);
+}
+
+void latency_histogram::record(std::chrono::nanoseconds value) {
+    auto ns = value.count() < 0 ? std::uint64_t{0}
+                                : static_cast<std::uint64_t>(value.count());
+    buckets_[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+
+    auto lo = min_.load(std::memory_order_relaxed);
+    while (ns < lo &&
+           !min_.compare_exchange_weak(lo, ns, std::memory_order_relaxed)) {
+    }
+    auto hi = max_.load(std::memory_order_relaxed);
+    while (ns > hi &&
+           !max_.compare_exchange_weak(hi, ns, std::memory_order_relaxed)) {
+    }
+}
+
+latency_snapshot latency_histogram::snapshot() const {
+    latency_snapshot s;
+    s.buckets.resize(bucket_count);
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+        s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        s.count += s.buckets[i];
+    }
+    if (s.count == 0) {
+        return s;
+    }
+
+    auto as_ns = [](std::uint64_t v) {
+        return std::chrono::nanoseconds(static_cast<std::int64_t>(v));
+    };
+    s.min = as_ns(min_.load(std::memory_order_relaxed));
+    s.max = as_ns(max_.load(std::memory_order_relaxed));
+    s.mean = as_ns(sum_.load(std::memory_order_relaxed) / s.count);
+    return s;
+}
+
+void latency_histogram::reset() {
+    for (auto &b : buckets_) {
+        b.store(0, std::memory_order_relaxed);
+    }
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(~std::uint64_t{0}, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds latency_snapshot::percentile(double p) const {
+    if (count == 0) {
+        return {};
+    }
+    auto rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(
+               std::ceil(p / 100.0 * static_cast<double>(count))));
+
+    std::uint64_t seen = 0;
+    for (std::size_t b = 0; b < buckets.size(); ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            if (b + 1 == buckets.size()) {
+                return max;
+            }
+            auto upper = std::chrono::nanoseconds(static_cast<std::int64_t>(
+                latency_histogram::bucket_lower(b + 1) - 1));
+            return std::clamp(upper, min, max);
+        }
+    }
+    return max;
+}
+
+std::string latency_snapshot::summary() const {
+    return std::format("n={} min={:.1f}us p50={:.1f}us p90={:.1f}us "
+                       "p99={:.1f}us p99.9={:.1f}us max={:.1f}us",
+                       count, to_us(min), to_us(percentile(50)),
+                       to_us(percentile(90)), to_us(percentile(99)),
+                       to_us(percentile(99.9)), to_us(max));
+}
+
+latency_recorder::latency_recorder(std::size_t max_quotes)
+    : quotes_(std::make_unique<per_quote[]>(max_quotes)),
+      max_quotes_(max_quotes), index_(max_quotes) {}
+
+void latency_recorder::record_ticks(
+    std::span<const tick> ticks,
+    std::chrono::system_clock::time_point received) {
+    auto &total = stages_[static_cast<std::size_t>(
+        latency_stage::server_to_receive)];
+    for (const auto &t : ticks) {
+        auto value = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            received - t.timestamp);
+        total.record(value);
+
+        // once full, quotes not already tracked stay out of the index
+        auto slot = used_.load(std::memory_order_relaxed) < max_quotes_
+                         ? index_.insert(t.quote_id)
+                         : index_.find(t.quote_id);
+        if (slot == quote_index::npos) {
+            continue;
+        }
+        auto &q = quotes_[slot];
+        if (slot == used_.load(std::memory_order_relaxed)) {
+            // slots are handed out in order, so this is a new quote
+            q.quote_id = t.quote_id;
+            used_.store(slot + 1, std::memory_order_release);
+        }
+        q.histogram.record(value);
+    }
+}
+
+latency_snapshot latency_recorder::snapshot(latency_stage stage) const {
+    return stages_[static_cast<std::size_t>(stage)].snapshot();
+}
+
+std::optional<latency_snapshot>
+latency_recorder::snapshot(int quote_id) const {
+    auto used = used_.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < used; ++i) {
+        if (quotes_[i].quote_id == quote_id) {
+            return quotes_[i].histogram.snapshot();
+        }
+    }
+    return std::nullopt;
+}
+
+void latency_recorder::reset() {
+    for (auto &s : stages_) {
+        s.reset();
+    }
+    auto used = used_.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < used; ++i) {
+        quotes_[i].histogram.reset();
+    }
+}
+} // namespace td365
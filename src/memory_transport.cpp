@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <cstring>
+#include <format>
+#include <map>
+#include <spdlog/spdlog.h>
+#include <td365/memory_transport.h>
+#include <td365/verify.h>
+
+namespace td365 {
+namespace net = boost::asio;
+namespace beast = boost::beast;
+
+namespace {
+// memory_server instances by name
+struct registry {
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<detail::memory_endpoint>,
+             std::less<>>
+        endpoints;
+};
+
+registry &servers() {
+    static registry r;
+    return r;
+}
+} // namespace
+
+void memory_connection::send(std::string frame) {
+    std::lock_guard lock(mutex_);
+    if (state_ != state::open) {
+        return;
+    }
+    inbound_.push_back(std::move(frame));
+    wake();
+}
+
+void memory_connection::close() {
+    std::lock_guard lock(mutex_);
+    if (state_ == state::open) {
+        state_ = state::closed;
+        wake();
+    }
+}
+
+void memory_connection::drop() {
+    std::lock_guard lock(mutex_);
+    if (state_ == state::open || state_ == state::closed) {
+        state_ = state::dropped;
+        inbound_.clear();
+        wake();
+    }
+}
+
+bool memory_connection::is_open() const {
+    std::lock_guard lock(mutex_);
+    return state_ == state::open;
+}
+
+void memory_connection::attach(net::io_context &ioc, net::steady_timer &t) {
+    std::lock_guard lock(mutex_);
+    ioc_ = &ioc;
+    signal_ = &t;
+    endpoint_->connections.fetch_add(1, std::memory_order_relaxed);
+}
+
+void memory_connection::detach() {
+    std::lock_guard lock(mutex_);
+    if (!ioc_) {
+        return;
+    }
+    if (state_ == state::open || state_ == state::closed) {
+        state_ = state::aborted;
+    }
+    endpoint_->connections.fetch_sub(1, std::memory_order_relaxed);
+    inbound_.clear();
+    ioc_ = nullptr;
+    signal_ = nullptr;
+}
+
+std::optional<std::pair<boost::system::error_code, std::size_t>>
+memory_connection::receive(beast::flat_buffer &buffer) {
+    std::lock_guard lock(mutex_);
+    if (state_ == state::dropped) {
+        return std::make_pair(
+            boost::system::error_code(net::error::connection_reset),
+            std::size_t{0});
+    }
+    if (state_ == state::aborted) {
+        return std::make_pair(
+            boost::system::error_code(net::error::operation_aborted),
+            std::size_t{0});
+    }
+    if (inbound_.empty()) {
+        if (state_ == state::closed) {
+            return std::make_pair(
+                boost::system::error_code(beast::websocket::error::closed),
+                std::size_t{0});
+        }
+        return std::nullopt;
+    }
+
+    const auto &frame = inbound_.front();
+    auto n = frame.size();
+    std::memcpy(buffer.prepare(n).data(), frame.data(), n);
+    buffer.commit(n);
+    inbound_.pop_front();
+    return std::make_pair(boost::system::error_code{}, n);
+}
+
+void memory_connection::deliver(std::string_view frame) {
+    if (endpoint_->on_frame) {
+        endpoint_->on_frame(*this, frame);
+    }
+}
+
+void memory_connection::wake() {
+    // one posted wake covers every frame queued before it runs
+    if (!ioc_ || wake_posted_) {
+        return;
+    }
+    wake_posted_ = true;
+    net::post(*ioc_, [self = shared_from_this()] {
+        std::lock_guard lock(self->mutex_);
+        self->wake_posted_ = false;
+        if (self->signal_) {
+            self->signal_->cancel();
+        }
+    });
+}
+
+memory_server::memory_server(std::string name)
+    : name_(std::move(name)),
+      endpoint_(std::make_shared<detail::memory_endpoint>()) {
+    auto &r = servers();
+    std::lock_guard lock(r.mutex);
+    verify(r.endpoints.emplace(name_, endpoint_).second,
+           "memory_server: {} is already listening", url());
+}
+
+memory_server::~memory_server() {
+    auto &r = servers();
+    std::lock_guard lock(r.mutex);
+    r.endpoints.erase(name_);
+}
+
+std::string memory_server::url() const {
+    return std::format("{}://{}", memory_scheme, name_);
+}
+
+memory_transport::~memory_transport() {
+    if (conn_) {
+        conn_->detach();
+    }
+}
+
+void memory_transport::connect(const boost::urls::url &url) {
+    std::shared_ptr<detail::memory_endpoint> ep;
+    {
+        auto &r = servers();
+        std::lock_guard lock(r.mutex);
+        auto it = r.endpoints.find(std::string_view(url.host()));
+        if (it == r.endpoints.end()) {
+            throw boost::system::system_error(
+                net::error::connection_refused,
+                std::format("memory_transport: nothing listening on {}",
+                            std::string_view(url.buffer())));
+        }
+        ep = it->second;
+    }
+
+    if (conn_) {
+        conn_->detach();
+    }
+    conn_ = std::make_shared<memory_connection>(ep);
+    conn_->attach(ioc_, signal_);
+    spdlog::debug("memory_transport: connected to {}",
+                  std::string_view(url.buffer()));
+    if (ep->on_open) {
+        ep->on_open(*conn_);
+    }
+}
+
+void memory_transport::abort() {
+    if (conn_) {
+        conn_->detach();
+    }
+    signal_.cancel();
+}
+} // namespace td365
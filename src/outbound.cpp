@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <charconv>
+#include <td365/outbound.h>
+
+namespace td365 {
+namespace net = boost::asio;
+
+std::string_view outbound_encoder::quote_action(std::string_view action,
+                                                int quote_id) {
+    // {"action":"subscribe","priceGrouping":"Sampled","quoteId":123}
+    buffer_.clear();
+    buffer_.append(R"({"action":")");
+    buffer_.append(action);
+    buffer_.append(R"(","priceGrouping":"Sampled","quoteId":)");
+
+    char digits[16];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), quote_id);
+    buffer_.append(digits, end);
+    buffer_.push_back('}');
+    return buffer_;
+}
+
+std::string_view outbound_encoder::subscribe(int quote_id) {
+    return quote_action("subscribe", quote_id);
+}
+
+std::string_view outbound_encoder::unsubscribe(int quote_id) {
+    return quote_action("unsubscribe", quote_id);
+}
+
+std::string_view outbound_encoder::account_options() {
+    return R"({"action":"options","data":)"
+           R"("{\"SubscribeToAccountSummary\":true,)"
+           R"(\"SubscribeToAccountDetails\":true}"})";
+}
+
+std::span<const net::const_buffer>
+outbound_encoder::heartbeat(const heartbeat_fields &f) {
+    static constexpr std::string_view p0 = R"({"MessagesReceived":)";
+    static constexpr std::string_view p1 = R"(,"MessagesSent":)";
+    static constexpr std::string_view p2 = R"(,"PricesReceived":)";
+    static constexpr std::string_view p3 = R"(,"PricesSent":)";
+    static constexpr std::string_view p4 = R"(,"SentByServer":)";
+    static constexpr std::string_view p5 =
+        R"(,"Visible":true,"action":"heartbeat"})";
+
+    gather_ = {
+        net::buffer(p0), net::buffer(f.messages_received),
+        net::buffer(p1), net::buffer(f.messages_sent),
+        net::buffer(p2), net::buffer(f.prices_received),
+        net::buffer(p3), net::buffer(f.prices_sent),
+        net::buffer(p4), net::buffer(f.sent_by_server),
+        net::buffer(p5),
+    };
+    return gather_;
+}
+} // namespace td365
@@ -6,10 +6,12 @@
  */
 
 #include "charconv_compat.h"
+#include "split_fields.h"
 
+#include <cstring>
 #include <iomanip>
 #include <iostream>
-#include <ranges>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <td365/parsing.h>
@@ -68,25 +70,49 @@ template <typename T> T parse(std::string_view sv) {
 int parse_int(std::string_view sv) { return parse<int>(sv); }
 double parse_double(std::string_view sv) { return parse<double>(sv); }
 
-tick parse_td_tick(std::string_view price_string, grouping price_type) {
-    constexpr size_t EXPECTED_FIELDS = 13;
-    std::array<std::string_view, EXPECTED_FIELDS> fields;
-    size_t idx = 0;
-
-    // split on ',' into subranges
-    for (auto sub : price_string | std::views::split(',') |
-                        std::views::transform([](auto rng) {
-                            auto first = rng.begin();
-                            auto len =
-                                std::ranges::size(rng); // unsigned size_t
-                            return std::string_view(&*first, len);
-                        })) {
-        if (idx < EXPECTED_FIELDS) {
-            fields[idx++] = sub;
-        } else {
-            break;
+fixed_price parse_fixed_price(std::string_view s) {
+    const char *p = s.data();
+    const char *end = p + s.size();
+
+    bool negative = p != end && *p == '-';
+    if (p != end && (*p == '-' || *p == '+')) {
+        ++p;
+    }
+
+    std::int64_t mantissa = 0;
+    std::int32_t decimals = 0;
+    int digits = 0;
+    bool fraction = false;
+    for (; p != end; ++p) {
+        if (*p == '.' && !fraction) {
+            fraction = true;
+            continue;
         }
+        auto d = static_cast<unsigned char>(*p) - '0';
+        verify(d >= 0 && d <= 9 && digits < 18, "bad price: {}", s);
+        mantissa = mantissa * 10 + d;
+        decimals += fraction ? 1 : 0;
+        ++digits;
     }
+    verify(digits > 0, "bad price: {}", s);
+    return {negative ? -mantissa : mantissa, decimals};
+}
+
+// A price field as a double, via the fixed-point parser into `*fixed` if
+// given
+static double parse_price_field(std::string_view sv, fixed_price *fixed) {
+    if (fixed) {
+        *fixed = parse_fixed_price(sv);
+        return fixed->to_double();
+    }
+    return parse_double(sv);
+}
+
+tick parse_td_tick(std::string_view price_string, grouping price_type,
+                   tick_prices *exact) {
+    constexpr size_t EXPECTED_FIELDS = 13;
+    std::array<std::string_view, EXPECTED_FIELDS> fields;
+    auto idx = split_fields(price_string, fields);
     verify(idx == EXPECTED_FIELDS, "Invalid price data format: {}",
            price_string);
 
@@ -117,23 +143,301 @@ tick parse_td_tick(std::string_view price_string, grouping price_type) {
         std::chrono::system_clock::now() - timestamp_value);
 
     // build and return
+    auto field = [exact](fixed_price tick_prices::*member) {
+        return exact ? &(exact->*member) : nullptr;
+    };
     return tick{.quote_id = parse_int(fields[0]),
-                .bid = parse_double(fields[1]),
-                .ask = parse_double(fields[2]),
+                .bid = parse_price_field(fields[1], field(&tick_prices::bid)),
+                .ask = parse_price_field(fields[2], field(&tick_prices::ask)),
                 .daily_change = parse_double(fields[3]),
                 .dir = dir_value,
                 .tradable = (fields[5] == "1"),
-                .high = parse_double(fields[6]),
-                .low = parse_double(fields[7]),
-                .hash = std::string(fields[8]), // needs owning string
+                .high =
+                    parse_price_field(fields[6], field(&tick_prices::high)),
+                .low = parse_price_field(fields[7], field(&tick_prices::low)),
+                .hash = tick_hash(fields[8]),
                 .call_only = (fields[9] == "1"),
-                .mid_price = parse_double(fields[10]),
+                .mid_price =
+                    parse_price_field(fields[10], field(&tick_prices::mid)),
                 .timestamp = timestamp_value,
                 .field13 = parse_int(fields[12]),
                 .group = price_type,
                 .latency = latency_value};
 }
 
+namespace {
+// Minimal cursor over a JSON document, just enough to walk price frames.
+// Anything unexpected makes the caller bail out to the DOM parser.
+struct frame_scanner {
+    const char *p;
+    const char *end;
+
+    void skip_ws() {
+        while (p != end &&
+               (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            ++p;
+        }
+    }
+
+    bool consume(char c) {
+        skip_ws();
+        if (p != end && *p == c) {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+
+    // a string without escape sequences
+    std::optional<std::string_view> string() {
+        if (!consume('"')) {
+            return std::nullopt;
+        }
+        auto *close = static_cast<const char *>(
+            std::memchr(p, '"', static_cast<size_t>(end - p)));
+        if (close == nullptr) {
+            return std::nullopt;
+        }
+        std::string_view rv(p, static_cast<size_t>(close - p));
+        if (rv.find('\\') != std::string_view::npos) {
+            return std::nullopt;
+        }
+        p = close + 1;
+        return rv;
+    }
+
+    // skip over any value, including nested containers and escaped strings
+    bool skip_value() {
+        skip_ws();
+        if (p == end) {
+            return false;
+        }
+        if (*p != '{' && *p != '[' && *p != '"') {
+            // number, true, false, null
+            auto *start = p;
+            while (p != end && *p != ',' && *p != '}' && *p != ']' &&
+                   *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+                ++p;
+            }
+            return p != start;
+        }
+
+        int depth = 0;
+        bool in_string = false;
+        for (; p != end; ++p) {
+            if (in_string) {
+                if (*p == '\\') {
+                    if (++p == end) {
+                        return false;
+                    }
+                } else if (*p == '"') {
+                    in_string = false;
+                    if (depth == 0) {
+                        ++p;
+                        return true;
+                    }
+                }
+            } else if (*p == '"') {
+                in_string = true;
+            } else if (*p == '{' || *p == '[') {
+                ++depth;
+            } else if (*p == '}' || *p == ']') {
+                if (--depth == 0) {
+                    ++p;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
+
+// walk the "d" object of a price frame
+bool scan_price_groups(frame_scanner &sc, std::vector<tick> &out,
+                       std::vector<tick_prices> *exact) {
+    if (!sc.consume('{')) {
+        return false;
+    }
+    if (sc.consume('}')) {
+        return true;
+    }
+    do {
+        auto key = sc.string();
+        if (!key || !sc.consume(':')) {
+            return false;
+        }
+        auto it = grouping_map.find(*key);
+        if (it == grouping_map.end()) {
+            if (!sc.skip_value()) {
+                return false;
+            }
+            continue;
+        }
+        if (!sc.consume('[')) {
+            return false;
+        }
+        if (sc.consume(']')) {
+            continue;
+        }
+        do {
+            auto line = sc.string();
+            if (!line) {
+                return false;
+            }
+            if (exact) {
+                out.push_back(
+                    parse_td_tick(*line, it->second, &exact->emplace_back()));
+            } else {
+                out.push_back(parse_td_tick(*line, it->second));
+            }
+        } while (sc.consume(','));
+        if (!sc.consume(']')) {
+            return false;
+        }
+    } while (sc.consume(','));
+    return sc.consume('}');
+}
+} // namespace
+
+bool parse_price_frame(std::string_view frame, std::vector<tick> &out,
+                       std::vector<tick_prices> *exact) {
+    out.clear();
+    if (exact) {
+        exact->clear();
+    }
+
+    frame_scanner sc{frame.data(), frame.data() + frame.size()};
+    bool is_price = false;
+    bool scanned = false;
+    const char *deferred_d = nullptr; // "d" seen before "t"
+
+    auto bail = [&out, exact] {
+        out.clear();
+        if (exact) {
+            exact->clear();
+        }
+        return false;
+    };
+
+    if (!sc.consume('{')) {
+        return false;
+    }
+    do {
+        auto key = sc.string();
+        if (!key || !sc.consume(':')) {
+            return bail();
+        }
+        if (*key == "t") {
+            auto t = sc.string();
+            if (!t || *t != "p") {
+                return bail();
+            }
+            is_price = true;
+        } else if (*key == "d" && is_price) {
+            if (!scan_price_groups(sc, out, exact)) {
+                return bail();
+            }
+            scanned = true;
+        } else if (*key == "d") {
+            sc.skip_ws();
+            deferred_d = sc.p;
+            if (!sc.skip_value()) {
+                return false;
+            }
+        } else if (!sc.skip_value()) {
+            return bail();
+        }
+    } while (sc.consume(','));
+
+    if (!sc.consume('}') || !is_price) {
+        return bail();
+    }
+    if (!scanned) {
+        if (deferred_d == nullptr) {
+            return false;
+        }
+        frame_scanner d{deferred_d, sc.end};
+        if (!scan_price_groups(d, out, exact)) {
+            return bail();
+        }
+    }
+    return !out.empty();
+}
+
+bool parse_heartbeat_frame(std::string_view frame, heartbeat_fields &out) {
+    frame_scanner sc{frame.data(), frame.data() + frame.size()};
+    bool is_heartbeat = false;
+    const char *d = nullptr;
+
+    if (!sc.consume('{')) {
+        return false;
+    }
+    do {
+        auto key = sc.string();
+        if (!key || !sc.consume(':')) {
+            return false;
+        }
+        if (*key == "t") {
+            auto t = sc.string();
+            if (!t || *t != "heartbeat") {
+                return false;
+            }
+            is_heartbeat = true;
+        } else {
+            if (*key == "d") {
+                sc.skip_ws();
+                d = sc.p;
+            }
+            if (!sc.skip_value()) {
+                return false;
+            }
+        }
+    } while (sc.consume(','));
+
+    if (!sc.consume('}') || !is_heartbeat || d == nullptr) {
+        return false;
+    }
+
+    out = {};
+    frame_scanner dsc{d, sc.end};
+    if (!dsc.consume('{')) {
+        return false;
+    }
+    if (!dsc.consume('}')) {
+        do {
+            auto key = dsc.string();
+            if (!key || !dsc.consume(':')) {
+                return false;
+            }
+            dsc.skip_ws();
+            auto *start = dsc.p;
+            if (!dsc.skip_value()) {
+                return false;
+            }
+            std::string_view raw(start, static_cast<size_t>(dsc.p - start));
+            if (*key == "SentByServer") {
+                out.sent_by_server = raw;
+            } else if (*key == "MessagesReceived") {
+                out.messages_received = raw;
+            } else if (*key == "PricesReceived") {
+                out.prices_received = raw;
+            } else if (*key == "MessagesSent") {
+                out.messages_sent = raw;
+            } else if (*key == "PricesSent") {
+                out.prices_sent = raw;
+            }
+        } while (dsc.consume(','));
+        if (!dsc.consume('}')) {
+            return false;
+        }
+    }
+
+    // the reply echoes all five; let the DOM path deal with anything missing
+    return !out.sent_by_server.empty() && !out.messages_received.empty() &&
+           !out.prices_received.empty() && !out.messages_sent.empty() &&
+           !out.prices_sent.empty();
+}
+
 auto parse_iso8601_sv(std::string_view sv) -> candle::time_type {
     if (sv.size() != 25 || (sv[19] != '+' && sv[19] != '-'))
         throw std::invalid_argument(
@@ -169,10 +473,9 @@ auto parse_iso8601_sv(std::string_view sv) -> candle::time_type {
         std::chrono::system_clock::from_time_t(tt));
 }
 
-candle parse_candle(std::string_view candle_string) {
+candle parse_candle(std::string_view candle_string, candle_prices *exact) {
     constexpr size_t EXPECTED_FIELDS = 6;
     std::array<std::string_view, EXPECTED_FIELDS> fields;
-    size_t idx = 0;
 
     // "2025-06-16T07:32:00+00:00,107109.5,107155.5,107109.5,107128.5,29"
     // 0. 2025-06-16T07:32:00+00:00
@@ -182,30 +485,20 @@ candle parse_candle(std::string_view candle_string) {
     // 4. 107128.5
     // 5. 29
 
-    // split on ',' into subranges
-    for (auto sub : candle_string | std::views::split(',') |
-                        std::views::transform([](auto rng) {
-                            auto first = rng.begin();
-                            auto len =
-                                std::ranges::size(rng); // unsigned size_t
-                            return std::string_view(&*first, len);
-                        })) {
-        if (idx < EXPECTED_FIELDS) {
-            fields[idx++] = sub;
-        } else {
-            break;
-        }
-    }
+    auto idx = split_fields(candle_string, fields);
     verify(idx == EXPECTED_FIELDS, "Invalid chart data format: {}",
            candle_string);
 
+    auto field = [exact](fixed_price candle_prices::*member) {
+        return exact ? &(exact->*member) : nullptr;
+    };
     return candle{
         .timestamp = std::chrono::time_point_cast<std::chrono::seconds>(
             string_to_timepoint(fields[0])),
-        .open = parse_double(fields[1]),
-        .high = parse_double(fields[2]),
-        .low = parse_double(fields[3]),
-        .close = parse_double(fields[4]),
+        .open = parse_price_field(fields[1], field(&candle_prices::open)),
+        .high = parse_price_field(fields[2], field(&candle_prices::high)),
+        .low = parse_price_field(fields[3], field(&candle_prices::low)),
+        .close = parse_price_field(fields[4], field(&candle_prices::close)),
         .volume = parse_double(fields[5]),
     };
 }
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <td365/quote_cache.h>
+
+namespace td365 {
+
+quote_cache::quote_cache(std::size_t max_quotes)
+    // at most half full keeps probe runs short
+    : slots_(std::bit_ceil(std::max<std::size_t>(max_quotes * 2, 16))),
+      max_quotes_(max_quotes),
+      shift_(64 - std::countr_zero(slots_.size())) {}
+
+std::size_t quote_cache::home(int quote_id) const {
+    // Fibonacci hashing, as in quote_index
+    auto key = static_cast<std::uint32_t>(quote_id);
+    return static_cast<std::size_t>(
+        (static_cast<std::uint64_t>(key) * 0x9e3779b97f4a7c15ULL) >> shift_);
+}
+
+std::size_t quote_cache::find(int quote_id) const {
+    auto mask = slots_.size() - 1;
+    auto i = home(quote_id);
+    while (true) {
+        auto key = slots_[i].quote_id.load(std::memory_order_acquire);
+        if (key == quote_id || key == empty_key) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+void quote_cache::update(std::span<const tick> ticks) {
+    for (const auto &t : ticks) {
+        update(t);
+    }
+}
+
+void quote_cache::update(const tick &t) {
+    auto &s = slots_[find(t.quote_id)];
+    bool fresh = s.quote_id.load(std::memory_order_relaxed) == empty_key;
+    if (fresh && size() >= max_quotes_) {
+        overflow_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::array<std::uint64_t, words> raw{};
+    std::memcpy(raw.data(), &t, sizeof(tick));
+
+    auto seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t w = 0; w < words; ++w) {
+        s.data[w].store(raw[w], std::memory_order_relaxed);
+    }
+    s.seq.store(seq + 2, std::memory_order_release);
+
+    if (fresh) {
+        // publish the key last, readers never see a slot without a tick
+        s.quote_id.store(t.quote_id, std::memory_order_release);
+        size_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::optional<tick> quote_cache::get_quote(int quote_id) const {
+    const auto &s = slots_[find(quote_id)];
+    if (s.quote_id.load(std::memory_order_relaxed) != quote_id) {
+        return std::nullopt;
+    }
+
+    std::array<std::uint64_t, words> raw;
+    while (true) {
+        auto before = s.seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        for (std::size_t w = 0; w < words; ++w) {
+            raw[w] = s.data[w].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) == before) {
+            break;
+        }
+    }
+
+    tick t;
+    std::memcpy(static_cast<void *>(&t), raw.data(), sizeof(tick));
+    return t;
+}
+} // namespace td365
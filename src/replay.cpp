@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <spdlog/spdlog.h>
+#include <td365/replay.h>
+#include <td365/verify.h>
+
+namespace td365 {
+
+namespace {
+// <prefix>-<unix ms>-<n>.cap -> (ms, n), so files sort by age even when
+// several were opened in the same millisecond
+std::pair<std::int64_t, std::int64_t> file_order(const std::string &stem) {
+    std::int64_t ms = 0;
+    std::int64_t n = 0;
+    auto last = stem.rfind('-');
+    auto middle = last == std::string::npos ? last : stem.rfind('-', last - 1);
+    if (middle != std::string::npos) {
+        std::from_chars(stem.data() + middle + 1, stem.data() + last, ms);
+        std::from_chars(stem.data() + last + 1, stem.data() + stem.size(), n);
+    }
+    return {ms, n};
+}
+} // namespace
+
+std::vector<std::filesystem::path>
+capture_files(const std::filesystem::path &directory,
+              const std::string &prefix) {
+    std::vector<std::filesystem::path> files;
+    for (const auto &e : std::filesystem::directory_iterator(directory)) {
+        auto name = e.path().filename().string();
+        if (e.is_regular_file() && name.starts_with(prefix + "-") &&
+            e.path().extension() == ".cap") {
+            files.push_back(e.path());
+        }
+    }
+    std::sort(files.begin(), files.end(), [](const auto &a, const auto &b) {
+        return file_order(a.stem().string()) < file_order(b.stem().string());
+    });
+    return files;
+}
+
+replay_feed::replay_feed(replay_options opts) : opts_(std::move(opts)) {
+    verify(opts_.speed >= 0.0, "replay_feed: speed must not be negative");
+}
+
+replay_feed::~replay_feed() = default;
+
+std::optional<captured_frame> replay_feed::advance() {
+    while (true) {
+        if (!reader_) {
+            if (file_index_ == opts_.files.size()) {
+                return std::nullopt;
+            }
+            const auto &path = opts_.files[file_index_++];
+            spdlog::debug("replay: playing {}", path.string());
+            reader_ = std::make_unique<capture_reader>(path);
+        }
+        while (auto frame = reader_->next()) {
+            if (frame->dir == capture::direction::inbound) {
+                return frame;
+            }
+        }
+        reader_.reset();
+    }
+}
+
+std::optional<replay_frame> replay_feed::next() {
+    auto frame = advance();
+    if (!frame) {
+        return std::nullopt;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (opts_.speed == 0.0) {
+        return replay_frame{.due = now, .payload = frame->payload};
+    }
+    // steady stamps only compare within one boot, so each file's are put
+    // on the wall clock through its header before files are paced
+    // against one another
+    const auto &header = reader_->header();
+    auto at = std::chrono::nanoseconds(header.created_unix_ns) +
+              (std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   frame->at.time_since_epoch()) -
+               std::chrono::nanoseconds(header.created_steady_ns));
+    if (!origin_) {
+        origin_ = at;
+        started_ = now;
+    }
+    auto recorded = std::chrono::duration<double>(at - *origin_);
+    auto due =
+        started_ + std::chrono::duration_cast<
+                       std::chrono::steady_clock::duration>(recorded /
+                                                            opts_.speed);
+    return replay_frame{.due = due, .payload = frame->payload};
+}
+} // namespace td365
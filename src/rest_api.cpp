@@ -68,6 +68,15 @@ std::string extract_account_id(std::string_view body) {
     return std::string{body.substr(pos, end - pos)};
 }
 
+// exact decimal when the request carries one, otherwise the double
+double order_price(double value, const std::optional<fixed_price> &exact) {
+    return exact ? exact->to_double() : value;
+}
+
+std::string order_level(double value, const std::optional<fixed_price> &exact) {
+    return exact ? exact->to_string() : std::to_string(value);
+}
+
 template <typename T> T extract_d(const json &j) {
     return j.at("d").template get<T>();
 }
@@ -95,6 +104,8 @@ auto make_post(http_client *client, std::string_view target,
 
 rest_api::rest_api() = default;
 
+rest_api::rest_api(boost::asio::io_context &ioc) : io_context_(&ioc) {}
+
 rest_api::~rest_api() = default;
 
 auto rest_api::open_client(std::string_view target, int depth)
@@ -127,8 +138,16 @@ auto rest_api::open_client(std::string_view target, int depth)
     throw fail("max depth reached: {}", target);
 }
 
+auto rest_api::make_client(boost::urls::url url)
+    -> std::unique_ptr<http_client> {
+    if (io_context_) {
+        return std::make_unique<http_client>(std::move(url), *io_context_);
+    }
+    return std::make_unique<http_client>(std::move(url));
+}
+
 auto rest_api::connect(boost::urls::url url) -> rest_api::auth_info {
-    client_ = std::make_unique<http_client>(url);
+    client_ = make_client(url);
     spdlog::info("Opening {}", url.buffer());
     auto [ots, login_id] = open_client(url.encoded_target());
     auto token = client_->jar().get(ots);
@@ -182,19 +201,24 @@ auto rest_api::get_market_details(int market_id) -> market_details_response {
 // }
 
 auto rest_api::backfill(int market_id, int /*quote_id*/, size_t sz,
-                        chart_duration /*dur*/) -> std::vector<candle> {
+                        chart_duration /*dur*/,
+                        std::vector<candle_prices> *exact)
+    -> std::vector<candle> {
     // auto chart_url = get_chart_url(market_id);
     // spdlog::info("chart url: {}", chart_url.buffer());
 
     // FIXME
-    auto hc = http_client(boost::url{"https://charts.finsatechnology.com"});
+    auto hc = make_client(boost::url{"https://charts.finsatechnology.com"});
     auto target = std::format("/data/minute/{}/mid?l={}", market_id, sz);
-    auto response = hc.get(target);
+    auto response = hc->get(target);
     auto j = json::parse(get_http_body(response));
     auto data = j.at("data").get<std::vector<std::string>>();
     auto rv = std::vector<candle>(sz);
+    if (exact) {
+        exact->resize(sz);
+    }
     for (size_t i = 0; i < sz; ++i) {
-        rv[i] = parse_candle(data[i]);
+        rv[i] = parse_candle(data[i], exact ? &(*exact)[i] : nullptr);
     }
     return rv;
 }
@@ -202,7 +226,7 @@ auto rest_api::backfill(int market_id, int /*quote_id*/, size_t sz,
 auto rest_api::trade(const trade_request &request) -> trade_response {
     json body = {{"marketID", request.market_id},
                  {"quoteID", request.quote_id},
-                 {"price", request.price},
+                 {"price", order_price(request.price, request.exact_price)},
                  {"stake", std::to_string(request.stake)},
                  {"tradeType", 1},
                  {"tradeMode", request.dir == trade_request::direction::sell},
@@ -211,8 +235,10 @@ auto rest_api::trade(const trade_request &request) -> trade_response {
                  {"orderModeID", 3},
                  {"orderTypeID", 2},
                  {"orderPriceModeID", 2},
-                 {"limitOrderPrice", std::to_string(request.limit)},
-                 {"stopOrderPrice", std::to_string(request.stop)},
+                 {"limitOrderPrice",
+                  order_level(request.limit, request.exact_limit)},
+                 {"stopOrderPrice",
+                  order_level(request.stop, request.exact_stop)},
                  {"trailingPoint", 0},
                  {"closePositionID", 0},
                  {"isKaazingFeed", true},
@@ -227,7 +253,7 @@ auto rest_api::trade(const trade_request &request) -> trade_response {
 auto rest_api::sim_trade(const trade_request &request) -> void {
     json body = {{"marketID", request.market_id},
                  {"quoteID", request.quote_id},
-                 {"price", request.price},
+                 {"price", order_price(request.price, request.exact_price)},
                  {"stake", std::to_string(request.stake)},
                  {"tradeType", 1},
                  {"tradeMode", request.dir == trade_request::direction::sell},
@@ -236,8 +262,10 @@ auto rest_api::sim_trade(const trade_request &request) -> void {
                  {"orderModeID", 3},
                  {"orderTypeID", 2},
                  {"orderPriceModeID", 2},
-                 {"limitOrderPrice", std::to_string(request.limit)},
-                 {"stopOrderPrice", std::to_string(request.stop)},
+                 {"limitOrderPrice",
+                  order_level(request.limit, request.exact_limit)},
+                 {"stopOrderPrice",
+                  order_level(request.stop, request.exact_stop)},
                  {"trailingPoint", 0},
                  {"closePositionID", 0},
                  {"isKaazingFeed", true},
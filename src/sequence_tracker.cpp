@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <td365/sequence_tracker.h>
+
+namespace td365 {
+
+namespace {
+// single writer, so a plain load/store instead of a locked add
+void bump(std::atomic<std::uint64_t> &counter, std::uint64_t n) {
+    if (n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n,
+                      std::memory_order_relaxed);
+    }
+}
+} // namespace
+
+void sequence_tracker::check(std::span<const tick> ticks,
+                             std::vector<gap_event> *gaps) {
+    std::uint64_t gap_count = 0;
+    std::uint64_t missed = 0;
+    std::uint64_t duplicates = 0;
+    std::uint64_t out_of_order = 0;
+
+    for (const auto &t : ticks) {
+        auto slot = index_.insert(t.quote_id);
+        if (slot == last_.size()) {
+            last_.push_back(t.field13);
+            continue;
+        }
+
+        auto &last = last_[slot];
+        auto delta = static_cast<std::int64_t>(t.field13) - last;
+        if (delta == 1) {
+            last = t.field13;
+        } else if (delta > 1) {
+            ++gap_count;
+            missed += static_cast<std::uint64_t>(delta - 1);
+            if (gaps) {
+                gaps->push_back({t.quote_id, last + 1, t.field13});
+            }
+            last = t.field13;
+        } else if (delta == 0) {
+            ++duplicates;
+        } else {
+            ++out_of_order;
+        }
+    }
+
+    bump(ticks_, ticks.size());
+    bump(gaps_, gap_count);
+    bump(missed_, missed);
+    bump(duplicates_, duplicates);
+    bump(out_of_order_, out_of_order);
+}
+
+sequence_metrics sequence_tracker::metrics() const {
+    return {
+        .ticks = ticks_.load(std::memory_order_relaxed),
+        .gaps = gaps_.load(std::memory_order_relaxed),
+        .missed = missed_.load(std::memory_order_relaxed),
+        .duplicates = duplicates_.load(std::memory_order_relaxed),
+        .out_of_order = out_of_order_.load(std::memory_order_relaxed),
+    };
+}
+} // namespace td365
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <td365/io_thread.h>
+#include <td365/session_pool.h>
+#include <td365/verify.h>
+#include <td365/ws_client.h>
+
+namespace td365 {
+
+// Sessions with nothing ready are still stepped this often, for paced
+// subscriptions, reconnect backoff, housekeeping and events held back by a
+// full ring
+constexpr auto pool_sweep_interval = std::chrono::milliseconds(10);
+
+session_pool::session_pool(std::size_t threads) {
+    verify(threads > 0, "session_pool: need at least one thread");
+    workers_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<worker>());
+    }
+    // started once the vector is complete, so none of it moves under them
+    for (auto &w : workers_) {
+        w->thread = std::jthread(
+            [this, &w = *w](std::stop_token stop) { run(w, stop); });
+    }
+}
+
+session_pool::~session_pool() {
+    for (auto &w : workers_) {
+        w->thread.request_stop();
+        w->guard.reset();
+        boost::asio::post(w->ioc, [] {});
+    }
+    for (auto &w : workers_) {
+        w->thread.join();
+    }
+}
+
+boost::asio::io_context &session_pool::context() {
+    auto i = next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    return workers_[i]->ioc;
+}
+
+std::vector<std::size_t> session_pool::sessions() const {
+    std::vector<std::size_t> out;
+    out.reserve(workers_.size());
+    for (const auto &w : workers_) {
+        out.push_back(w->sessions.load(std::memory_order_relaxed));
+    }
+    return out;
+}
+
+session_pool::worker &session_pool::worker_of(const io_thread &t) {
+    auto *ioc = t.client_.io_context();
+    for (auto &w : workers_) {
+        if (&w->ioc == ioc) {
+            return *w;
+        }
+    }
+    throw fail("session_pool: the client wasn't made on one of this pool's "
+               "io_contexts");
+}
+
+void session_pool::add(io_thread &t) {
+    auto &w = worker_of(t);
+    {
+        std::lock_guard lock(w.mutex);
+        w.joining.push_back(&t);
+    }
+    boost::asio::post(w.ioc, [] {});
+}
+
+void session_pool::remove(io_thread &t) {
+    auto &w = worker_of(t);
+    std::unique_lock lock(w.mutex);
+    w.leaving.push_back(&t);
+    auto ticket = ++w.requested;
+    boost::asio::post(w.ioc, [] {});
+    w.removed.wait(lock, [&w, ticket] { return w.completed >= ticket; });
+}
+
+void session_pool::wake(io_thread &t) {
+    boost::asio::post(worker_of(t).ioc, [] {});
+}
+
+void session_pool::run(worker &w, std::stop_token stop) {
+    // only this thread touches the sessions themselves
+    std::vector<io_thread *> sessions;
+    std::vector<io_thread *> leaving;
+    auto next_sweep = std::chrono::steady_clock::now();
+
+    while (!stop.stop_requested()) {
+        std::uint64_t upto = 0;
+        {
+            std::lock_guard lock(w.mutex);
+            sessions.insert(sessions.end(), w.joining.begin(),
+                            w.joining.end());
+            w.joining.clear();
+            leaving.swap(w.leaving);
+            upto = w.requested;
+        }
+        for (auto *t : leaving) {
+            std::erase(sessions, t);
+            // the connection's handlers run on this io_context, so it is
+            // torn down here rather than on the owner's thread
+            t->client_.disconnect();
+        }
+        w.sessions.store(sessions.size(), std::memory_order_relaxed);
+        if (!leaving.empty()) {
+            leaving.clear();
+            std::lock_guard lock(w.mutex);
+            w.completed = upto;
+            w.removed.notify_all();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        bool sweep = now >= next_sweep;
+        if (sweep) {
+            next_sweep = now + pool_sweep_interval;
+        }
+
+        // Only sessions with a completed read or a command are stepped
+        // between sweeps, so an idle session costs nothing per frame of
+        // the others
+        bool busy = false;
+        for (auto *t : sessions) {
+            if (!t->running() || !(sweep || t->ready())) {
+                continue;
+            }
+            if (t->step(std::chrono::milliseconds(0), stop) ==
+                io_thread::step_result::busy) {
+                busy = true;
+            }
+        }
+
+        if (!busy) {
+            if (w.ioc.stopped()) {
+                w.ioc.restart();
+            }
+            w.ioc.run_one_until(next_sweep);
+        }
+    }
+
+    // the pool is going away; anything left must not run on a dead thread,
+    // and its consumer must not wait for it
+    for (auto *t : sessions) {
+        t->client_.disconnect();
+        t->stopped();
+    }
+    spdlog::debug("session_pool: thread stopped");
+}
+} // namespace td365
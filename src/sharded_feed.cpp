@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+#include <spdlog/spdlog.h>
+#include <td365/sharded_feed.h>
+#include <td365/verify.h>
+#include <utility>
+
+namespace td365 {
+
+sharded_feed::sharded_feed(const sharded_feed_options &opts) : opts_(opts) {
+    verify(opts.shards > 0, "sharded_feed: need at least one shard");
+    shards_.reserve(opts.shards);
+    for (std::size_t i = 0; i < opts.shards; ++i) {
+        shards_.push_back(std::make_unique<shard_state>());
+    }
+}
+
+sharded_feed::~sharded_feed() = default;
+
+void sharded_feed::connect(boost::urls::url_view url,
+                           const std::string &login_id,
+                           const std::string &token,
+                           std::function<void()> housekeeping) {
+    verify(!shards_.front()->io, "sharded_feed: already connected");
+
+    // all connections are up before any I/O thread starts, so a failed
+    // login leaves nothing running
+    for (auto &s : shards_) {
+        s->client.connect(url, login_id, token);
+    }
+    for (std::size_t i = 0; i < shards_.size(); ++i) {
+        auto &s = *shards_[i];
+        s.io = std::make_unique<io_thread>(
+            s.client, opts_.ring_capacity,
+            i == 0 ? std::move(housekeeping) : std::function<void()>{},
+            nullptr, &wakeup_);
+    }
+    spdlog::info("sharded_feed: {} connections to {}", shards_.size(),
+                 url.buffer());
+}
+
+ws_client &sharded_feed::client(std::size_t shard) {
+    verify(shard < shards_.size(), "sharded_feed: no shard {}", shard);
+    return shards_[shard]->client;
+}
+
+void sharded_feed::post(std::size_t shard, io_thread::command cmd) {
+    verify(shard < shards_.size(), "sharded_feed: no shard {}", shard);
+    verify(shards_[shard]->io != nullptr, "sharded_feed: not connected");
+    shards_[shard]->io->post(std::move(cmd));
+}
+
+std::size_t sharded_feed::hashed(int quote_id) const {
+    // quote ids come in runs, so mix the bits before taking the modulus
+    auto h = static_cast<std::uint64_t>(static_cast<std::uint32_t>(quote_id)) *
+             0x9E3779B97F4A7C15ull;
+    return static_cast<std::size_t>((h >> 32) % shards_.size());
+}
+
+double sharded_feed::quote_rate(const quote_state &q,
+                                std::chrono::steady_clock::time_point now) {
+    std::chrono::duration<double> elapsed = now - q.since;
+    if (elapsed.count() <= 0.0) {
+        return 0.0;
+    }
+    return static_cast<double>(q.ticks) / elapsed.count();
+}
+
+std::vector<double> sharded_feed::loads() const {
+    std::vector<double> loads(shards_.size(), 0.0);
+    auto now = std::chrono::steady_clock::now();
+    for (const auto &[id, q] : quotes_) {
+        loads[q.shard] += quote_rate(q, now);
+    }
+    return loads;
+}
+
+std::size_t sharded_feed::lightest(std::span<const double> loads,
+                                   std::span<const std::size_t> quotes) {
+    std::size_t best = 0;
+    for (std::size_t i = 1; i < loads.size(); ++i) {
+        if (loads[i] < loads[best] ||
+            (loads[i] == loads[best] && quotes[i] < quotes[best])) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+void sharded_feed::subscribe(int quote_id) {
+    subscribe(std::span<const int>(&quote_id, 1));
+}
+
+void sharded_feed::subscribe(std::span<const int> quote_ids) {
+    verify(shards_.front()->io != nullptr, "subscribe: not connected");
+
+    std::vector<double> load;
+    std::vector<std::size_t> counts;
+    if (opts_.policy == shard_policy::rate) {
+        load = loads();
+        for (const auto &s : shards_) {
+            counts.push_back(s->quotes.load(std::memory_order_relaxed));
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::vector<int>> by_shard(shards_.size());
+    for (int id : quote_ids) {
+        if (quotes_.contains(id)) {
+            continue;
+        }
+        // a new quote has no rate yet, so it goes by quote count
+        auto shard = opts_.policy == shard_policy::rate
+                         ? lightest(load, counts)
+                         : hashed(id);
+        if (!counts.empty()) {
+            ++counts[shard];
+        }
+        quotes_.emplace(id, quote_state{shard, 0, now});
+        shards_[shard]->quotes.fetch_add(1, std::memory_order_relaxed);
+        by_shard[shard].push_back(id);
+    }
+
+    for (std::size_t i = 0; i < by_shard.size(); ++i) {
+        send_subscribe(i, std::move(by_shard[i]));
+    }
+}
+
+void sharded_feed::unsubscribe(int quote_id) {
+    unsubscribe(std::span<const int>(&quote_id, 1));
+}
+
+void sharded_feed::unsubscribe(std::span<const int> quote_ids) {
+    verify(shards_.front()->io != nullptr, "unsubscribe: not connected");
+
+    std::vector<std::vector<int>> by_shard(shards_.size());
+    for (int id : quote_ids) {
+        auto it = quotes_.find(id);
+        if (it == quotes_.end()) {
+            continue;
+        }
+        auto shard = it->second.shard;
+        quotes_.erase(it);
+        shards_[shard]->quotes.fetch_sub(1, std::memory_order_relaxed);
+        by_shard[shard].push_back(id);
+    }
+
+    for (std::size_t i = 0; i < by_shard.size(); ++i) {
+        send_unsubscribe(i, std::move(by_shard[i]));
+    }
+}
+
+void sharded_feed::send_subscribe(std::size_t shard, std::vector<int> ids) {
+    if (ids.empty()) {
+        return;
+    }
+    shards_[shard]->io->post(
+        [ids = std::move(ids)](ws_client &c) { c.subscribe(ids); });
+}
+
+void sharded_feed::send_unsubscribe(std::size_t shard, std::vector<int> ids) {
+    if (ids.empty()) {
+        return;
+    }
+    shards_[shard]->io->post(
+        [ids = std::move(ids)](ws_client &c) { c.unsubscribe(ids); });
+}
+
+namespace {
+// Subscribes `ids` on the shard's connection, then sets `sent` once every
+// one of them has gone out. Pacing may hold some back, so until then it
+// posts itself to run again; it runs on the I/O thread it was posted to,
+// which is therefore still there to post to.
+struct subscribe_and_mark {
+    io_thread *io;
+    std::vector<int> ids;
+    std::shared_ptr<std::atomic<bool>> sent;
+    wake_signal *wakeup;
+    bool subscribed = false;
+
+    void operator()(ws_client &c) {
+        if (!subscribed) {
+            c.subscribe(ids);
+            subscribed = true;
+        }
+        // one unsubscribed in the meantime won't be sent at all
+        if (std::ranges::all_of(ids, [&c](int id) {
+                return c.on_server(id) || !c.subscriptions().contains(id);
+            })) {
+            sent->store(true, std::memory_order_release);
+            wakeup->notify();
+            return;
+        }
+        io->post(*this);
+    }
+};
+} // namespace
+
+void sharded_feed::move(std::size_t from, std::size_t to,
+                        std::vector<int> ids) {
+    auto sent = std::make_shared<std::atomic<bool>>(false);
+    auto *io = shards_[to]->io.get();
+    io->post(subscribe_and_mark{io, ids, sent, &wakeup_});
+    handovers_.push_back({from, std::move(ids), std::move(sent)});
+}
+
+void sharded_feed::finish_handovers() {
+    std::erase_if(handovers_, [this](handover &h) {
+        if (!h.sent->load(std::memory_order_acquire)) {
+            return false;
+        }
+        // unsubscribed and subscribed again meanwhile, back onto `from`
+        std::erase_if(h.ids, [this, &h](int id) {
+            auto it = quotes_.find(id);
+            return it != quotes_.end() && it->second.shard == h.from;
+        });
+        send_unsubscribe(h.from, std::move(h.ids));
+        return true;
+    });
+}
+
+std::size_t sharded_feed::rebalance() {
+    if (opts_.policy != shard_policy::rate || shards_.size() < 2) {
+        return 0;
+    }
+    finish_handovers();
+    std::unordered_set<int> moving;
+    for (const auto &h : handovers_) {
+        moving.insert(h.ids.begin(), h.ids.end());
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::pair<double, int>> by_rate;
+    by_rate.reserve(quotes_.size());
+    for (const auto &[id, q] : quotes_) {
+        by_rate.emplace_back(quote_rate(q, now), id);
+    }
+    // heaviest first; ties by id so the result doesn't depend on hashing
+    std::ranges::sort(by_rate, [](const auto &a, const auto &b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    std::vector<double> load(shards_.size(), 0.0);
+    std::vector<std::size_t> counts(shards_.size(), 0);
+    // (from, to) -> quotes
+    std::map<std::pair<std::size_t, std::size_t>, std::vector<int>> moves;
+    std::size_t moved = 0;
+    for (const auto &[rate, id] : by_rate) {
+        auto &q = quotes_.at(id);
+        auto to = lightest(load, counts);
+        // no point moving between equally loaded shards
+        if ((load[q.shard] == load[to] && counts[q.shard] == counts[to]) ||
+            moving.contains(id)) {
+            to = q.shard;
+        }
+        load[to] += rate;
+        ++counts[to];
+
+        if (q.shard != to) {
+            moves[{q.shard, to}].push_back(id);
+            shards_[q.shard]->quotes.fetch_sub(1, std::memory_order_relaxed);
+            shards_[to]->quotes.fetch_add(1, std::memory_order_relaxed);
+            q.shard = to;
+            ++moved;
+        }
+    }
+
+    for (auto &[route, ids] : moves) {
+        move(route.first, route.second, std::move(ids));
+    }
+
+    if (moved) {
+        spdlog::info("sharded_feed: rebalanced {} of {} quotes", moved,
+                     quotes_.size());
+    }
+    return moved;
+}
+
+std::optional<std::size_t> sharded_feed::shard_of(int quote_id) const {
+    if (auto it = quotes_.find(quote_id); it != quotes_.end()) {
+        return it->second.shard;
+    }
+    return std::nullopt;
+}
+
+void sharded_feed::account(std::size_t shard, const event &evt) {
+    auto &s = *shards_[shard];
+    if (auto *batch = std::get_if<tick_batch_event>(&evt)) {
+        // no other writer, so no need for an atomic add
+        s.ticks.store(s.ticks.load(std::memory_order_relaxed) +
+                          batch->data.size(),
+                      std::memory_order_relaxed);
+        // only rate placement needs the per-quote counts
+        if (opts_.policy == shard_policy::rate) {
+            for (const auto &t : batch->data) {
+                if (auto it = quotes_.find(t.quote_id); it != quotes_.end()) {
+                    ++it->second.ticks;
+                }
+            }
+        }
+    } else if (std::holds_alternative<connection_closed_event>(evt)) {
+        s.closed = true;
+    } else if (std::holds_alternative<error_event>(evt)) {
+        // a failed read is reported and retried; only a failed connection
+        // stops the I/O thread
+        s.closed = !s.io->running();
+    }
+}
+
+std::optional<event> sharded_feed::try_pop() {
+    verify(shards_.front()->io != nullptr, "try_pop: not connected");
+    if (!handovers_.empty()) {
+        finish_handovers();
+    }
+
+    for (std::size_t n = 0; n < shards_.size(); ++n) {
+        auto i = (next_ + n) % shards_.size();
+        auto &s = *shards_[i];
+        if (s.closed) {
+            continue;
+        }
+        if (auto evt = s.io->try_pop()) {
+            account(i, *evt);
+            last_ = i;
+            // the other shards go first next time, so a busy one can't
+            // starve them
+            next_ = (i + 1) % shards_.size();
+            return evt;
+        }
+    }
+    return std::nullopt;
+}
+
+event sharded_feed::wait(std::optional<std::chrono::milliseconds> timeout) {
+    auto deadline = timeout ? std::chrono::steady_clock::now() + *timeout
+                            : std::chrono::steady_clock::time_point::max();
+    while (true) {
+        // taken first, so a push after the checks below still wakes us
+        auto epoch = wakeup_.epoch();
+        if (auto evt = try_pop()) {
+            return std::move(*evt);
+        }
+        if (std::ranges::all_of(shards_,
+                                [](const auto &s) { return s->closed; })) {
+            return connection_closed_event{};
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return timeout_event{};
+        }
+        // every shard's pushes, and finished handovers, notify this
+        wakeup_.wait_until(epoch, deadline);
+    }
+}
+
+std::vector<shard_metrics> sharded_feed::metrics() const {
+    std::vector<shard_metrics> out;
+    out.reserve(shards_.size());
+    for (const auto &s : shards_) {
+        shard_metrics m{
+            .quotes = s->quotes.load(std::memory_order_relaxed),
+            .ticks = s->ticks.load(std::memory_order_relaxed),
+            .ring = {},
+            .send = {},
+            .sequence = s->client.sequence_stats(),
+        };
+        if (s->io) {
+            m.ring = s->io->metrics();
+            m.send = s->client.write_metrics();
+        }
+        out.push_back(m);
+    }
+    return out;
+}
+} // namespace td365
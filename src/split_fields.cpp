@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include "split_fields.h"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace td365 {
+namespace {
+
+using split_fn = std::size_t (*)(std::string_view, std::span<std::string_view>,
+                                 char);
+
+struct field_sink {
+    std::span<std::string_view> out;
+    const char *field_start;
+    std::size_t n = 0;
+
+    // close the field ending at `delim_pos`, false once `out` is full
+    bool add(const char *delim_pos) {
+        out[n++] = std::string_view(
+            field_start, static_cast<std::size_t>(delim_pos - field_start));
+        field_start = delim_pos + 1;
+        return n < out.size();
+    }
+
+    std::size_t finish(const char *end) {
+        if (n < out.size()) {
+            out[n++] = std::string_view(
+                field_start, static_cast<std::size_t>(end - field_start));
+        }
+        return n;
+    }
+};
+
+// memchr the rest of the line, then close the final field
+std::size_t split_tail(field_sink &sink, const char *p, const char *end,
+                       char delim) {
+    while (auto *d = static_cast<const char *>(
+               std::memchr(p, delim, static_cast<std::size_t>(end - p)))) {
+        if (!sink.add(d)) {
+            return sink.n;
+        }
+        p = d + 1;
+    }
+    return sink.finish(end);
+}
+
+[[maybe_unused]] std::size_t split_scalar(std::string_view line,
+                                          std::span<std::string_view> out,
+                                          char delim) {
+    if (line.empty() || out.empty()) {
+        return 0;
+    }
+    field_sink sink{out, line.data()};
+    return split_tail(sink, line.data(), line.data() + line.size(), delim);
+}
+
+#if defined(__x86_64__)
+std::size_t split_sse2(std::string_view line, std::span<std::string_view> out,
+                       char delim) {
+    if (line.empty() || out.empty()) {
+        return 0;
+    }
+    field_sink sink{out, line.data()};
+    const char *p = line.data();
+    const char *end = p + line.size();
+
+    const __m128i needle = _mm_set1_epi8(delim);
+    for (; end - p >= 16; p += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        auto mask = static_cast<std::uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+        for (; mask != 0; mask &= mask - 1) {
+            if (!sink.add(p + std::countr_zero(mask))) {
+                return sink.n;
+            }
+        }
+    }
+    return split_tail(sink, p, end, delim);
+}
+
+__attribute__((target("avx2"))) std::size_t
+split_avx2(std::string_view line, std::span<std::string_view> out,
+           char delim) {
+    if (line.empty() || out.empty()) {
+        return 0;
+    }
+    field_sink sink{out, line.data()};
+    const char *p = line.data();
+    const char *end = p + line.size();
+
+    const __m256i needle = _mm256_set1_epi8(delim);
+    for (; end - p >= 32; p += 32) {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        auto mask = static_cast<std::uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+        for (; mask != 0; mask &= mask - 1) {
+            if (!sink.add(p + std::countr_zero(mask))) {
+                return sink.n;
+            }
+        }
+    }
+    return split_tail(sink, p, end, delim);
+}
+#endif
+
+split_fn select_split() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return split_avx2;
+    }
+    return split_sse2;
+#else
+    return split_scalar;
+#endif
+}
+} // namespace
+
+std::size_t split_fields(std::string_view line,
+                         std::span<std::string_view> out, char delim) {
+    static const split_fn impl = select_split();
+    return impl(line, out, delim);
+}
+
+} // namespace td365
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace td365 {
+
+// Split `line` on `delim` into at most out.size() fields and return how many
+// were found. Like the views::split loops it replaces, anything past the
+// last slot is ignored. Uses AVX2 or SSE2 when the CPU has them (picked once
+// at runtime), otherwise a memchr loop.
+std::size_t split_fields(std::string_view line,
+                         std::span<std::string_view> out, char delim = ',');
+
+} // namespace td365
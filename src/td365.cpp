@@ -5,53 +5,363 @@
  * Use in compliance with the Prosperity Public License 3.0.0.
  */
 
+#include <algorithm>
 #include <boost/asio.hpp>
+#include <condition_variable>
+#include <future>
+#include <spdlog/spdlog.h>
 #include <td365/authenticator.h>
 #include <td365/td365.h>
+#include <td365/utils.h>
+#include <td365/verify.h>
 #include <td365/ws_client.h>
 
 namespace td365 {
 
 td365::td365() = default;
 
+td365::td365(boost::asio::io_context &ioc)
+    : rest_client_(ioc), ws_client_(ioc) {}
+
 td365::~td365() = default;
 
 void td365::connect() {
     auto auth_detail = authenticator::authenticate();
-    auto auth_info = rest_client_.connect(auth_detail.platform_url);
-    ws_client_.connect(auth_detail.sock_host, auth_info.login_id,
-                       auth_info.token);
+    auth_info_ = rest_client_.connect(auth_detail.platform_url);
+    sock_host_ = auth_detail.sock_host;
+    connect_ws();
 }
 
 void td365::connect(const std::string &username, const std::string &password,
                     const std::string &account_id) {
     auto auth_detail =
         authenticator::authenticate(username, password, account_id);
-    auto auth_info = rest_client_.connect(auth_detail.platform_url);
-    ws_client_.connect(auth_detail.sock_host, auth_info.login_id,
-                       auth_info.token);
+    auth_info_ = rest_client_.connect(auth_detail.platform_url);
+    sock_host_ = auth_detail.sock_host;
+    connect_ws();
+}
+
+void td365::connect_ws() {
+    if (!io_thread_) {
+        ws_client_.connect(sock_host_, auth_info_.login_id, auth_info_.token);
+        return;
+    }
+
+    // a pooled session's io_context is run by the pool's thread, so the
+    // handshake has to happen there too
+    std::promise<void> done;
+    io_thread_->post([this, &done](ws_client &c) {
+        try {
+            c.connect(sock_host_, auth_info_.login_id, auth_info_.token);
+            done.set_value();
+        } catch (...) {
+            done.set_exception(std::current_exception());
+        }
+    });
+    done.get_future().get();
+    start_session_refresh();
+}
+
+void td365::replay(const replay_options &opts) {
+    if (!io_thread_) {
+        ws_client_.replay(opts);
+        return;
+    }
+
+    // the I/O thread may already be stepping the client, so the connection
+    // is swapped there
+    std::promise<void> done;
+    io_thread_->post([&opts, &done](ws_client &c) {
+        try {
+            c.replay(opts);
+            done.set_value();
+        } catch (...) {
+            done.set_exception(std::current_exception());
+        }
+    });
+    done.get_future().get();
+}
+
+void td365::subscribe(int quote_id) {
+    subscribe(std::span<const int>(&quote_id, 1));
+}
+
+void td365::subscribe(std::span<const int> quote_ids) {
+    if (io_thread_) {
+        io_thread_->post(
+            [ids = std::vector<int>(quote_ids.begin(), quote_ids.end())](
+                ws_client &c) { c.subscribe(ids); });
+    } else {
+        ws_client_.subscribe(quote_ids);
+    }
+}
+
+void td365::unsubscribe(int quote_id) {
+    unsubscribe(std::span<const int>(&quote_id, 1));
+}
+
+void td365::unsubscribe(std::span<const int> quote_ids) {
+    if (io_thread_) {
+        io_thread_->post(
+            [ids = std::vector<int>(quote_ids.begin(), quote_ids.end())](
+                ws_client &c) { c.unsubscribe(ids); });
+    } else {
+        ws_client_.unsubscribe(quote_ids);
+    }
+}
+
+void td365::set_subscriptions(std::span<const int> quote_ids) {
+    if (io_thread_) {
+        io_thread_->post(
+            [ids = std::vector<int>(quote_ids.begin(), quote_ids.end())](
+                ws_client &c) { c.set_subscriptions(ids); });
+    } else {
+        ws_client_.set_subscriptions(quote_ids);
+    }
+}
+
+void td365::set_subscription_pacing(std::size_t burst,
+                                    std::chrono::milliseconds interval) {
+    if (io_thread_) {
+        io_thread_->post([burst, interval](ws_client &c) {
+            c.set_subscription_pacing(burst, interval);
+        });
+    } else {
+        ws_client_.set_subscription_pacing(burst, interval);
+    }
+}
+
+void td365::set_price_mode(price_mode mode) {
+    price_mode_ = mode;
+    if (io_thread_) {
+        io_thread_->post([mode](ws_client &c) { c.set_price_mode(mode); });
+    } else {
+        ws_client_.set_price_mode(mode);
+    }
+}
+
+void td365::set_spin_mode(const spin_options &opts) {
+    auto apply = [opts](ws_client &c) {
+        c.set_spin_mode(opts);
+        tune_current_thread(opts.cpu, opts.fifo_priority);
+    };
+    if (io_thread_) {
+        io_thread_->post(apply);
+    } else {
+        apply(ws_client_);
+    }
+}
+
+void td365::set_reconnect_options(const reconnect_options &opts) {
+    check_reconnect_options(opts);
+    if (io_thread_) {
+        io_thread_->post(
+            [opts](ws_client &c) { c.set_reconnect_options(opts); });
+    } else {
+        ws_client_.set_reconnect_options(opts);
+    }
+}
+
+void td365::set_gap_events(bool enabled) {
+    if (io_thread_) {
+        io_thread_->post(
+            [enabled](ws_client &c) { c.set_gap_events(enabled); });
+    } else {
+        ws_client_.set_gap_events(enabled);
+    }
+}
+
+void td365::set_rx_timestamps(rx_timestamping mode) {
+    if (io_thread_) {
+        io_thread_->post([mode](ws_client &c) { c.set_rx_timestamps(mode); });
+    } else {
+        ws_client_.set_rx_timestamps(mode);
+    }
+}
+
+void td365::set_compression(const compression_options &opts) {
+    // checked here, as a throw on the I/O thread would only reach the
+    // consumer as an error_event
+    check_compression_options(opts);
+    if (io_thread_) {
+        io_thread_->post([opts](ws_client &c) { c.set_compression(opts); });
+    } else {
+        ws_client_.set_compression(opts);
+    }
+}
+
+void td365::start_capture(const capture_options &opts) {
+    stop_capture();
+    recorder_ = std::make_shared<frame_recorder>(opts);
+    if (io_thread_) {
+        io_thread_->post([r = recorder_](ws_client &c) {
+            c.set_frame_recorder(r.get());
+        });
+    } else {
+        ws_client_.set_frame_recorder(recorder_.get());
+    }
+}
+
+void td365::stop_capture() {
+    if (!recorder_) {
+        return;
+    }
+    if (io_thread_) {
+        // the last reference goes once the I/O thread has let go of it
+        io_thread_->post([r = std::move(recorder_)](ws_client &c) {
+            c.set_frame_recorder(nullptr);
+        });
+    } else {
+        ws_client_.set_frame_recorder(nullptr);
+    }
+    recorder_.reset();
+}
+
+capture_metrics td365::capture_stats() const {
+    verify(recorder_ != nullptr, "capture_stats: capture not started");
+    return recorder_->metrics();
+}
+
+void td365::set_conflation(const conflation_options &opts) {
+    verify(!io_thread_, "set_conflation: call before start_io_thread");
+    conflator_ = std::make_unique<conflator>(opts);
 }
 
-void td365::subscribe(int quote_id) { ws_client_.subscribe(quote_id); }
+conflation_metrics td365::conflation_stats() const {
+    verify(conflator_ != nullptr, "conflation_stats: conflation not enabled");
+    return conflator_->metrics();
+}
+
+void td365::enable_quote_cache(std::size_t max_quotes) {
+    verify(!io_thread_, "enable_quote_cache: call before start_io_thread");
+    quote_cache_ = std::make_unique<quote_cache>(max_quotes);
+    ws_client_.set_quote_cache(quote_cache_.get());
+}
+
+std::optional<tick> td365::get_quote(int quote_id) const {
+    verify(quote_cache_ != nullptr, "get_quote: quote cache not enabled");
+    return quote_cache_->get_quote(quote_id);
+}
+
+void td365::enable_latency_recording(std::size_t max_quotes) {
+    verify(!io_thread_,
+           "enable_latency_recording: call before start_io_thread");
+    latency_ = std::make_unique<latency_recorder>(max_quotes);
+    ws_client_.set_latency_recorder(latency_.get());
+}
+
+latency_recorder &td365::latency() {
+    verify(latency_ != nullptr, "latency: recording not enabled");
+    return *latency_;
+}
+
+void td365::start_io_thread(std::size_t ring_capacity) {
+    verify(!io_thread_, "start_io_thread: already started");
+    io_thread_ = std::make_unique<io_thread>(ws_client_, ring_capacity,
+                                             std::function<void()>{},
+                                             conflator_.get());
+    start_session_refresh();
+}
+
+void td365::start_io_thread(session_pool &pool, std::size_t ring_capacity) {
+    verify(!io_thread_, "start_io_thread: already started");
+    verify(!ws_client_.connected(),
+           "start_io_thread: call before connect() with a session_pool");
+    io_thread_ = std::make_unique<io_thread>(ws_client_, pool, ring_capacity,
+                                             std::function<void()>{},
+                                             conflator_.get());
+}
+
+constexpr auto session_refresh_interval = std::chrono::seconds(60);
+
+void td365::refresh_session() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_session_update_.load(std::memory_order_relaxed) >=
+        session_refresh_interval) {
+        std::lock_guard lock(rest_mutex_);
+        // another thread may have got here first
+        if (now - last_session_update_.load(std::memory_order_relaxed) >=
+            session_refresh_interval) {
+            rest_client_.update_client_session_id();
+            last_session_update_.store(now, std::memory_order_relaxed);
+        }
+    }
+}
+
+void td365::start_session_refresh() {
+    // a replay has no session to keep alive
+    if (refresh_thread_.joinable() || auth_info_.token.empty()) {
+        return;
+    }
+    refresh_thread_ = std::jthread([this](std::stop_token stop) {
+        // a failed refresh is retried this much later
+        constexpr auto retry = std::chrono::seconds(5);
+        std::mutex mutex;
+        std::condition_variable_any cv;
+        auto due = std::chrono::steady_clock::now();
+        while (true) {
+            {
+                std::unique_lock lock(mutex);
+                cv.wait_until(lock, stop, due, [] { return false; });
+            }
+            if (stop.stop_requested()) {
+                return;
+            }
+            try {
+                refresh_session();
+                due = last_session_update_.load(std::memory_order_relaxed) +
+                      session_refresh_interval;
+            } catch (const std::exception &e) {
+                spdlog::warn("td365: session refresh failed: {}", e.what());
+                due = std::chrono::steady_clock::now() + retry;
+            }
+        }
+    });
+}
+
+std::unique_ptr<sharded_feed>
+td365::open_sharded_feed(const sharded_feed_options &opts) {
+    verify(!auth_info_.token.empty(), "open_sharded_feed: not connected");
+    auto feed = std::make_unique<sharded_feed>(opts);
+    for (std::size_t i = 0; i < feed->shards(); ++i) {
+        feed->client(i).set_price_mode(price_mode_);
+    }
+    feed->connect(sock_host_, auth_info_.login_id, auth_info_.token);
+    start_session_refresh();
+    return feed;
+}
+
+std::optional<event> td365::try_pop() {
+    verify(io_thread_ != nullptr, "try_pop: io thread not started");
+    return io_thread_->try_pop();
+}
 
-void td365::unsubscribe(int quote_id) { ws_client_.unsubscribe(quote_id); }
+ring_metrics td365::io_metrics() const {
+    verify(io_thread_ != nullptr, "io_metrics: io thread not started");
+    return io_thread_->metrics();
+}
 
 event td365::wait(std::optional<std::chrono::milliseconds> timeout) {
+    if (io_thread_) {
+        return io_thread_->wait(timeout);
+    }
+    if (conflator_) {
+        return wait_conflated(timeout);
+    }
+
     auto start_time = std::chrono::steady_clock::now();
     auto deadline = timeout ? start_time + *timeout
                             : std::chrono::steady_clock::time_point::max();
 
     while (true) {
-        auto now = std::chrono::steady_clock::now();
-
-        if (now - last_session_update_ >= std::chrono::seconds(60)) {
-            rest_client_.update_client_session_id();
-            last_session_update_ = now;
-        }
+        refresh_session();
 
         auto evt =
             ws_client_.read_and_process_message(std::chrono::milliseconds(100));
 
+        if (std::holds_alternative<tick_batch_event>(evt)) {
+            ws_client_.record_delivery();
+        }
         if (!std::holds_alternative<timeout_event>(evt)) {
             return evt;
         }
@@ -62,23 +372,71 @@ event td365::wait(std::optional<std::chrono::milliseconds> timeout) {
     }
 }
 
+event td365::wait_conflated(std::optional<std::chrono::milliseconds> timeout) {
+    auto deadline = timeout ? std::chrono::steady_clock::now() + *timeout
+                            : std::chrono::steady_clock::time_point::max();
+
+    while (true) {
+        refresh_session();
+
+        // Everything already received goes through the table, so only the
+        // newest tick of each quote survives. Other events go out first.
+        while (true) {
+            auto evt = ws_client_.read_and_process_message(
+                std::chrono::milliseconds(0));
+            if (auto *batch = std::get_if<tick_batch_event>(&evt)) {
+                conflator_->update(batch->data);
+            } else if (std::holds_alternative<timeout_event>(evt)) {
+                break;
+            } else {
+                return evt;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (auto ticks = conflator_->take(now); !ticks.empty()) {
+            return tick_batch_event{ticks, std::nullopt};
+        }
+        if (now >= deadline) {
+            return timeout_event{};
+        }
+
+        // block until a frame arrives, a held quote falls due or the
+        // deadline, whichever is first
+        auto until = std::min(
+            {deadline, conflator_->next_due(), now + std::chrono::seconds(1)});
+        auto evt = ws_client_.read_and_process_message(
+            std::chrono::ceil<std::chrono::milliseconds>(until - now));
+        if (auto *batch = std::get_if<tick_batch_event>(&evt)) {
+            conflator_->update(batch->data);
+        } else if (!std::holds_alternative<timeout_event>(evt)) {
+            return evt;
+        }
+    }
+}
+
 std::vector<market_group> td365::get_market_super_group() {
+    std::lock_guard lock(rest_mutex_);
     return rest_client_.get_market_super_group();
 }
 
 std::vector<market_group> td365::get_market_group(int id) {
+    std::lock_guard lock(rest_mutex_);
     return rest_client_.get_market_group(id);
 }
 
 std::vector<market> td365::get_market_quote(int id) {
+    std::lock_guard lock(rest_mutex_);
     return rest_client_.get_market_quote(id);
 }
 
 market_details_response td365::get_market_details(int id) {
+    std::lock_guard lock(rest_mutex_);
     return rest_client_.get_market_details(id);
 }
 
 trade_response td365::trade(const trade_request &&request) {
+    std::lock_guard lock(rest_mutex_);
     rest_client_.get_market_details(request.market_id);
     rest_client_.sim_trade(request);
     return rest_client_.trade(std::move(request));
@@ -86,6 +444,14 @@ trade_response td365::trade(const trade_request &&request) {
 
 std::vector<candle> td365::backfill(int market_id, int quote_id, size_t sz,
                                     chart_duration dur) {
+    std::lock_guard lock(rest_mutex_);
     return rest_client_.backfill(market_id, quote_id, sz, dur);
 }
+
+std::vector<candle> td365::backfill(int market_id, int quote_id, size_t sz,
+                                    chart_duration dur,
+                                    std::vector<candle_prices> &exact) {
+    std::lock_guard lock(rest_mutex_);
+    return rest_client_.backfill(market_id, quote_id, sz, dur, &exact);
+}
 } // namespace td365
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <td365/timestamped_stream.h>
+#if defined(__linux__)
+#include <linux/net_tstamp.h>
+#endif
+
+namespace td365 {
+
+namespace {
+rx_time to_rx_time(const timespec &ts) {
+    return rx_time(std::chrono::seconds(ts.tv_sec) +
+                   std::chrono::nanoseconds(ts.tv_nsec));
+}
+} // namespace
+
+bool timestamped_stream::set_mode(rx_timestamping mode) {
+#if defined(__linux__)
+    auto fd = next_.socket().native_handle();
+    int ns = mode == rx_timestamping::software ? 1 : 0;
+    int flags = mode == rx_timestamping::hardware
+                    ? SOF_TIMESTAMPING_RX_HARDWARE |
+                          SOF_TIMESTAMPING_RAW_HARDWARE |
+                          SOF_TIMESTAMPING_RX_SOFTWARE |
+                          SOF_TIMESTAMPING_SOFTWARE
+                    : 0;
+    if (::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &ns, sizeof(ns)) != 0 ||
+        ::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags,
+                     sizeof(flags)) != 0) {
+        spdlog::warn("ws: enabling receive timestamps failed: {}",
+                     std::strerror(errno));
+        mode_ = rx_timestamping::off;
+        return mode == rx_timestamping::off;
+    }
+    mode_ = mode;
+    last_received_.reset();
+    last_hardware_received_.reset();
+    return true;
+#else
+    if (mode != rx_timestamping::off) {
+        spdlog::warn("ws: receive timestamps are not supported on this "
+                     "platform");
+    }
+    return mode == rx_timestamping::off;
+#endif
+}
+
+bool timestamped_stream::receive(iovec *iov, std::size_t count,
+                                 boost::system::error_code &ec,
+                                 std::size_t &n) {
+#if defined(__linux__)
+    // room for SCM_TIMESTAMPNS and SCM_TIMESTAMPING
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(timespec)) +
+                                  CMSG_SPACE(3 * sizeof(timespec))];
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t got;
+    do {
+        got = ::recvmsg(next_.socket().native_handle(), &msg, MSG_DONTWAIT);
+    } while (got < 0 && errno == EINTR);
+
+    if (got < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return false;
+        }
+        ec.assign(errno, boost::system::system_category());
+        n = 0;
+        return true;
+    }
+    if (got == 0) {
+        ec = boost::asio::error::eof;
+        n = 0;
+        return true;
+    }
+
+    last_received_.reset();
+    last_hardware_received_.reset();
+    for (auto *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+        if (c->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec ts;
+            std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            last_received_ = to_rx_time(ts);
+        } else if (c->cmsg_type == SCM_TIMESTAMPING) {
+            // [0] software, in CLOCK_REALTIME; [2] raw hardware, in the
+            // NIC's clock
+            timespec ts[3];
+            std::memcpy(ts, CMSG_DATA(c), sizeof(ts));
+            if (ts[0].tv_sec != 0 || ts[0].tv_nsec != 0) {
+                last_received_ = to_rx_time(ts[0]);
+            }
+            if (ts[2].tv_sec != 0 || ts[2].tv_nsec != 0) {
+                last_hardware_received_ =
+                    to_rx_time(ts[2]).time_since_epoch();
+            }
+        }
+    }
+    ec = {};
+    n = static_cast<std::size_t>(got);
+    return true;
+#else
+    (void)iov;
+    (void)count;
+    (void)ec;
+    (void)n;
+    return false;
+#endif
+}
+
+void teardown(boost::beast::role_type role, timestamped_stream &stream,
+              boost::system::error_code &ec) {
+    using boost::beast::websocket::teardown;
+    teardown(role, stream.next_layer().socket(), ec);
+}
+} // namespace td365
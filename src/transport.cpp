@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <boost/beast/websocket/ssl.hpp>
+#include <cstring>
+#include <td365/constants.h>
+#include <td365/transport.h>
+#include <td365/utils.h>
+
+namespace td365 {
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+namespace ssl = boost::asio::ssl;
+
+namespace {
+template <typename Stream> Stream make_stream(net::io_context &ioc) {
+    if constexpr (websocket_transport<Stream>::tls) {
+        return Stream(ioc, ssl_ctx());
+    } else {
+        return Stream(ioc);
+    }
+}
+} // namespace
+
+template <typename Stream>
+websocket_transport<Stream>::websocket_transport(net::io_context &ioc)
+    : ws_(make_stream<Stream>(ioc)) {}
+
+template <typename Stream>
+void websocket_transport<Stream>::set_compression(
+    const compression_options &opts) {
+    websocket::permessage_deflate pmd;
+    pmd.client_enable = opts.enabled;
+    pmd.server_max_window_bits = opts.server_max_window_bits;
+    pmd.client_max_window_bits = opts.client_max_window_bits;
+    pmd.server_no_context_takeover = opts.server_no_context_takeover;
+    pmd.client_no_context_takeover = opts.client_no_context_takeover;
+    pmd.compLevel = opts.level;
+    pmd.memLevel = opts.mem_level;
+    ws_.set_option(pmd);
+}
+
+template <typename Stream>
+void websocket_transport<Stream>::connect(const boost::urls::url &url) {
+    std::string_view port = url.has_port() ? std::string_view(url.port())
+                            : tls          ? "443"
+                                           : "80";
+    auto const endpoints = td_resolve(ws_.get_executor(), url.host(), port);
+
+    // Set a timeout on the operation
+    beast::get_lowest_layer(ws_).expires_after(std::chrono::seconds(30));
+
+    // Connect synchronously
+    beast::get_lowest_layer(ws_).connect(endpoints);
+
+    if constexpr (tls) {
+        // Set SNI Hostname (many hosts need this to handshake successfully)
+        if (!SSL_set_tlsext_host_name(ws_.next_layer().native_handle(),
+                                      url.host().c_str())) {
+            throw beast::system_error(static_cast<int>(::ERR_get_error()),
+                                      net::error::get_ssl_category());
+        }
+
+        // Set a timeout on the operation
+        beast::get_lowest_layer(ws_).expires_after(std::chrono::seconds(30));
+    }
+
+    // Set a decorator to change the User-Agent of the handshake
+    ws_.set_option(
+        websocket::stream_base::decorator([](websocket::request_type &req) {
+            req.set(http::field::user_agent, UserAgent);
+        }));
+
+    if constexpr (tls) {
+        // Perform the SSL handshake synchronously
+        ws_.next_layer().handshake(ssl::stream_base::client);
+    }
+
+    // Turn off the timeout on the tcp_stream, because
+    // the websocket stream has its own timeout system.
+    beast::get_lowest_layer(ws_).expires_never();
+
+    // Set suggested timeout settings for the websocket
+    ws_.set_option(
+        websocket::stream_base::timeout::suggested(beast::role_type::client));
+
+    // Perform the websocket handshake synchronously
+    websocket::response_type res;
+    ws_.handshake(res, url.encoded_host_and_port(), "/");
+
+    // the server answers with the extensions it accepted
+    compressed_ = res[http::field::sec_websocket_extensions].find(
+                      "permessage-deflate") != beast::string_view::npos;
+}
+
+template <typename Stream> void websocket_transport<Stream>::abort() {
+    // completes the outstanding operations with an error
+    boost::system::error_code ignored;
+    socket().close(ignored);
+}
+
+template <typename Stream>
+timestamped_stream &websocket_transport<Stream>::stream() {
+    if constexpr (tls) {
+        return ws_.next_layer().next_layer();
+    } else {
+        return ws_.next_layer();
+    }
+}
+
+template <typename Stream>
+const timestamped_stream &websocket_transport<Stream>::stream() const {
+    if constexpr (tls) {
+        return ws_.next_layer().next_layer();
+    } else {
+        return ws_.next_layer();
+    }
+}
+
+template class websocket_transport<ssl_websocket_type>;
+template class websocket_transport<plain_websocket_type>;
+
+replay_transport::replay_transport(net::io_context &ioc, replay_options opts)
+    : ioc_(ioc), timer_(ioc), feed_(std::move(opts)) {}
+
+void replay_transport::abort() {
+    aborted_ = true;
+    timer_.cancel();
+}
+
+std::size_t replay_transport::copy(beast::flat_buffer &buffer,
+                                   std::string_view payload) {
+    std::memcpy(buffer.prepare(payload.size()).data(), payload.data(),
+                payload.size());
+    buffer.commit(payload.size());
+    return payload.size();
+}
+} // namespace td365
@@ -6,9 +6,9 @@
  */
 
 #include "charconv_compat.h"
+#include "split_fields.h"
 
 #include <nlohmann/json.hpp>
-#include <ranges>
 #include <sstream>
 #include <td365/parsing.h>
 #include <td365/types.h>
@@ -24,6 +24,11 @@ std::ostream &operator<<(std::ostream &os, const direction &d) {
     return os;
 }
 
+std::ostream &operator<<(std::ostream &os, const tick_hash &h) {
+    os << h.view();
+    return os;
+}
+
 std::ostream &operator<<(std::ostream &os, const tick &t) {
     // clang-format off
     os << t.quote_id << ","
@@ -48,21 +53,7 @@ std::ostream &operator<<(std::ostream &os, const tick &t) {
 void tick::parse(const std::string_view line) {
     constexpr size_t EXPECTED_FIELDS = 15;
     std::array<std::string_view, EXPECTED_FIELDS> fields;
-    size_t idx = 0;
-
-    // Split on ',' into subranges
-    for (auto sub :
-         line | std::views::split(',') | std::views::transform([](auto rng) {
-             auto first = rng.begin();
-             auto len = std::ranges::size(rng);
-             return std::string_view(&*first, len);
-         })) {
-        if (idx < EXPECTED_FIELDS) {
-            fields[idx++] = sub;
-        } else {
-            break;
-        }
-    }
+    auto idx = split_fields(line, fields);
 
     if (idx != EXPECTED_FIELDS) {
         throw std::invalid_argument("Invalid CSV tick format: expected " +
@@ -115,7 +106,7 @@ void tick::parse(const std::string_view line) {
     tradable = parse_bool(fields[5]);
     high = parse_double(fields[6]);
     low = parse_double(fields[7]);
-    hash = std::string(fields[8]);
+    hash = fields[8];
     call_only = parse_bool(fields[9]);
     mid_price = parse_double(fields[10]);
     field13 = parse_int(fields[12]);
@@ -129,6 +120,48 @@ tick tick::create(const std::string_view line) {
     return rv;
 }
 
+packed_tick packed_tick::from(const tick &t) {
+    uint8_t flags = 0;
+    if (t.tradable) {
+        flags |= flag_tradable;
+    }
+    if (t.call_only) {
+        flags |= flag_call_only;
+    }
+    return packed_tick{
+        .bid = t.bid,
+        .ask = t.ask,
+        .timestamp_ns = t.timestamp.time_since_epoch().count(),
+        .quote_id = t.quote_id,
+        .field13 = t.field13,
+        .mid_price = t.mid_price,
+        .high = t.high,
+        .low = t.low,
+        .daily_change = static_cast<float>(t.daily_change),
+        .dir = t.dir,
+        .group = t.group,
+        .flags = flags,
+    };
+}
+
+tick packed_tick::to_tick() const {
+    tick t{};
+    t.quote_id = quote_id;
+    t.bid = bid;
+    t.ask = ask;
+    t.daily_change = daily_change;
+    t.dir = dir;
+    t.tradable = (flags & flag_tradable) != 0;
+    t.high = high;
+    t.low = low;
+    t.call_only = (flags & flag_call_only) != 0;
+    t.mid_price = mid_price;
+    t.timestamp = tick::time_type(std::chrono::nanoseconds(timestamp_ns));
+    t.field13 = field13;
+    t.group = group;
+    return t;
+}
+
 // Serialization
 void to_json(nlohmann::json &j, const market_group &mg) {
     j = {{"ID", mg.id},
@@ -242,7 +275,7 @@ void to_json(nlohmann::json &j, const tick &m) {
                        {"tradable", m.tradable},
                        {"high", m.high},
                        {"low", m.low},
-                       {"hash", m.hash},
+                       {"hash", m.hash.str()},
                        {"call_only", m.call_only},
                        {"mid_price", m.mid_price},
                        {"timestamp", m.timestamp.time_since_epoch().count()},
@@ -260,7 +293,7 @@ void from_json(const nlohmann::json &j, tick &m) {
     j.at("tradable").get_to(m.tradable);
     j.at("high").get_to(m.high);
     j.at("low").get_to(m.low);
-    j.at("hash").get_to(m.hash);
+    m.hash = j.at("hash").get<std::string>();
     j.at("call_only").get_to(m.call_only);
     j.at("mid_price").get_to(m.mid_price);
     auto ts_count = j.at("timestamp").get<long long>();
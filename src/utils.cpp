@@ -16,8 +16,11 @@
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <charconv>
+#include <cstring>
 #include <fstream>
+#include <pthread.h>
 #include <regex>
+#include <sched.h>
 #include <td365/http_client.h>
 #include <td365/utils.h>
 
@@ -98,8 +101,9 @@ std::string get_http_body(http_response const &res) {
     return body;
 }
 
-boost::asio::ip::tcp::resolver::results_type td_resolve(std::string_view host,
-                                                        std::string_view port) {
+boost::asio::ip::tcp::resolver::results_type
+td_resolve(const boost::asio::any_io_executor &ex, std::string_view host,
+           std::string_view port) {
     std::string h, p;
 
     if (auto *env = std::getenv("PROXY")) {
@@ -117,8 +121,36 @@ boost::asio::ip::tcp::resolver::results_type td_resolve(std::string_view host,
 
     spdlog::info("resolving {}:{} ({}:{})", host, port, h, p);
 
-    boost::asio::io_context io_context;
-    boost::asio::ip::tcp::resolver resolver(io_context);
+    boost::asio::ip::tcp::resolver resolver(ex);
     return resolver.resolve(h, p);
 }
+
+void tune_current_thread(std::optional<int> cpu,
+                         std::optional<int> fifo_priority) {
+#if defined(__linux__)
+    if (cpu) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(static_cast<size_t>(*cpu), &set);
+        if (int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            rc != 0) {
+            spdlog::warn("failed to pin thread to cpu {}: {}", *cpu,
+                         std::strerror(rc));
+        }
+    }
+    if (fifo_priority) {
+        sched_param param{};
+        param.sched_priority = *fifo_priority;
+        if (int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            rc != 0) {
+            spdlog::warn("failed to set SCHED_FIFO priority {}: {}",
+                         *fifo_priority, std::strerror(rc));
+        }
+    }
+#else
+    if (cpu || fifo_priority) {
+        spdlog::warn("thread affinity/scheduling not supported here");
+    }
+#endif
+}
 } // namespace td365
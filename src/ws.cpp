@@ -6,22 +6,19 @@
  */
 
 #include <boost/asio/detached.hpp>
-#include <boost/asio/ssl.hpp>
 #include <boost/beast/core.hpp>
-#include <boost/beast/websocket/ssl.hpp>
 #include <boost/lexical_cast.hpp>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
 #include <iostream>
-#include <td365/constants.h>
-#include <td365/utils.h>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
 #include <td365/ws.h>
 
 namespace td365 {
 namespace net = boost::asio;
 namespace beast = boost::beast;
-namespace http = beast::http;
-namespace websocket = beast::websocket;
-using tcp = net::ip::tcp;
-namespace ssl = boost::asio::ssl;
 
 bool is_debug_enabled() {
     static bool enabled = [] {
@@ -31,134 +28,368 @@ bool is_debug_enabled() {
     return enabled;
 }
 
-ws::ws() : using_ssl_(false) {}
+namespace {
+std::int64_t thread_cpu_ns() {
+    timespec ts{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::int64_t{ts.tv_sec} * 1'000'000'000 + ts.tv_nsec;
+}
+} // namespace
+
+ws::ws()
+    : own_io_(std::make_unique<net::io_context>()), io_context_(*own_io_) {}
+
+ws::ws(net::io_context &ioc) : io_context_(ioc) {}
+
+ws::~ws() {
+    // a shared io_context outlives us, so the handlers of our outstanding
+    // operations must have run before we go
+    reset();
+}
+
+template <typename F> void ws::with_transport(F &&f) {
+    std::visit(
+        [&f](auto &t) {
+            if constexpr (!std::same_as<std::decay_t<decltype(t)>,
+                                        std::monostate>) {
+                f(t);
+            }
+        },
+        transport_);
+}
 
 void ws::connect(boost::urls::url url) {
-    // Determine if we should use SSL based on the URL scheme
-    using_ssl_ = (url.scheme() == "wss" || url.scheme() == "https");
+    reset();
 
-    auto const endpoints = td_resolve(url.host(), (using_ssl_ ? "443" : "80"));
+    if (url.scheme() == "wss" || url.scheme() == "https") {
+        auto &t = transport_.emplace<tls_transport>(io_context_);
+        t.set_compression(compression_);
+        t.connect(url);
+        compressed_.store(t.compressed(), std::memory_order_relaxed);
+    } else if (url.scheme() == memory_scheme) {
+        transport_.emplace<memory_transport>(io_context_).connect(url);
+    } else {
+        auto &t = transport_.emplace<tcp_transport>(io_context_);
+        t.set_compression(compression_);
+        t.connect(url);
+        compressed_.store(t.compressed(), std::memory_order_relaxed);
+    }
 
-    if (using_ssl_) {
-        // Create SSL WebSocket
-        ssl_ws_ = std::make_unique<ssl_websocket_type>(io_context_, ssl_ctx());
+    if (busy_poll_) {
+        set_busy_poll(*busy_poll_);
+    }
+    if (rx_mode_ != rx_timestamping::off) {
+        set_rx_timestamps(rx_mode_);
+    }
+}
 
-        // Set a timeout on the operation
-        beast::get_lowest_layer(*ssl_ws_).expires_after(
-            std::chrono::seconds(30));
+void ws::replay(const replay_options &opts) {
+    reset();
+    transport_.emplace<replay_transport>(io_context_, opts);
+}
 
-        // Connect synchronously
-        beast::get_lowest_layer(*ssl_ws_).connect(endpoints);
+void ws::reset() {
+    if (std::holds_alternative<std::monostate>(transport_)) {
+        return;
+    }
 
-        // Set SNI Hostname (many hosts need this to handshake successfully)
-        if (!SSL_set_tlsext_host_name(ssl_ws_->next_layer().native_handle(),
-                                      url.host().c_str())) {
-            throw beast::system_error(static_cast<int>(::ERR_get_error()),
-                                      net::error::get_ssl_category());
-        }
+    // aborting completes the old connection's outstanding operations; run
+    // their handlers before the transport goes away
+    with_transport([](auto &t) { t.abort(); });
+    io_context_.restart();
+    io_context_.poll();
+    transport_.emplace<std::monostate>();
 
-        // Set a timeout on the operation
-        beast::get_lowest_layer(*ssl_ws_).expires_after(
-            std::chrono::seconds(30));
+    buffer_.clear();
+    rx_timestamp_.reset();
+    wire_seen_ = 0;
+    compressed_.store(false, std::memory_order_relaxed);
+    read_pending_ = false;
+    read_done_ = false;
+    read_ec_ = {};
+    queued_.clear();
+    queued_frames_.clear();
+    writing_.clear();
+    writing_frames_.clear();
+    write_index_ = 0;
+    write_in_flight_ = false;
+    queue_depth_.store(0, std::memory_order_relaxed);
+}
 
-        // Set a decorator to change the User-Agent of the handshake
-        ssl_ws_->set_option(
-            websocket::stream_base::decorator([](websocket::request_type &req) {
-                req.set(http::field::user_agent, UserAgent);
-            }));
+void ws::close() {
+    if (std::holds_alternative<std::monostate>(transport_)) {
+        return;
+    }
 
-        // Perform the SSL handshake synchronously
-        ssl_ws_->next_layer().handshake(ssl::stream_base::client);
+    // let queued frames go out first, bounded so a dead peer can't hang us
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (write_in_flight_ && std::chrono::steady_clock::now() < deadline) {
+        run_until(deadline);
+    }
 
-        // Turn off the timeout on the tcp_stream, because
-        // the websocket stream has its own timeout system.
-        beast::get_lowest_layer(*ssl_ws_).expires_never();
+    bool closed = false;
+    with_transport([&closed](auto &t) {
+        t.async_close(
+            [&closed](boost::system::error_code, std::size_t = 0) {
+                closed = true;
+            });
+    });
+    while (!closed && std::chrono::steady_clock::now() < deadline) {
+        run_until(deadline);
+    }
+}
 
-        // Set suggested timeout settings for the websocket
-        ssl_ws_->set_option(websocket::stream_base::timeout::suggested(
-            beast::role_type::client));
+void ws::send(std::string_view message) {
+    auto offset = queued_.size();
+    queued_.append(message);
+    enqueue(offset);
+}
 
-        // Perform the websocket handshake synchronously
-        ssl_ws_->handshake(url.encoded_host_and_port(), "/");
-    } else {
-        // Create plain WebSocket
-        plain_ws_ = std::make_unique<plain_websocket_type>(io_context_);
+void ws::send(std::span<const net::const_buffer> message) {
+    auto offset = queued_.size();
+    for (const auto &b : message) {
+        queued_.append(static_cast<const char *>(b.data()), b.size());
+    }
+    enqueue(offset);
+}
 
-        // Set a timeout on the operation
-        beast::get_lowest_layer(*plain_ws_)
-            .expires_after(std::chrono::seconds(30));
+void ws::enqueue(std::size_t offset) {
+    auto now = std::chrono::steady_clock::now();
+    queued_frames_.push_back({offset, queued_.size() - offset, now});
+    if (recorder_) {
+        recorder_->record(capture::direction::outbound,
+                          std::string_view(queued_).substr(offset), now);
+    }
 
-        // Connect synchronously
-        beast::get_lowest_layer(*plain_ws_).connect(endpoints);
+    auto depth = queued_frames_.size() + writing_frames_.size() - write_index_;
+    if (depth > write_high_water_.load(std::memory_order_relaxed)) {
+        write_high_water_.store(depth, std::memory_order_relaxed);
+    }
+    queue_depth_.store(depth, std::memory_order_relaxed);
 
-        // Set a decorator to change the User-Agent of the handshake
-        plain_ws_->set_option(
-            websocket::stream_base::decorator([](websocket::request_type &req) {
-                req.set(http::field::user_agent, UserAgent);
-            }));
+    if (is_debug_enabled()) {
+        std::cout << ">> " << std::string_view(queued_).substr(offset)
+                  << std::endl;
+    }
 
-        // Turn off the timeout on the tcp_stream, because
-        // the websocket stream has its own timeout system.
-        beast::get_lowest_layer(*plain_ws_).expires_never();
+    if (!write_in_flight_) {
+        start_write();
+    }
+}
 
-        // Set suggested timeout settings for the websocket
-        plain_ws_->set_option(websocket::stream_base::timeout::suggested(
-            beast::role_type::client));
+void ws::start_write() {
+    if (queued_frames_.empty()) {
+        return;
+    }
+    // everything queued so far goes out as one back-to-back chain; frames
+    // sent meanwhile collect in the other buffer
+    std::swap(queued_, writing_);
+    std::swap(queued_frames_, writing_frames_);
+    queued_.clear();
+    queued_frames_.clear();
+    write_index_ = 0;
+    write_in_flight_ = true;
+    write_next();
+}
 
-        // Perform the websocket handshake synchronously
-        plain_ws_->handshake(url.encoded_host_and_port(), "/");
+void ws::write_next() {
+    if (write_index_ == writing_frames_.size()) {
+        writing_.clear();
+        writing_frames_.clear();
+        write_index_ = 0;
+        write_in_flight_ = false;
+        start_write();
+        return;
     }
+
+    const auto &f = writing_frames_[write_index_];
+    auto on_write = [this](boost::system::error_code ec, std::size_t) {
+        on_write_done(ec);
+    };
+    auto buf = net::buffer(writing_.data() + f.offset, f.size);
+    with_transport([&](auto &t) { t.async_write(buf, on_write); });
 }
 
-void ws::close() {
-    if (using_ssl_) {
-        get_lowest_layer(*ssl_ws_).expires_after(std::chrono::seconds(1));
-        ssl_ws_->close(boost::beast::websocket::close_code::normal);
-    } else {
-        get_lowest_layer(*plain_ws_).expires_after(std::chrono::seconds(1));
-        plain_ws_->close(boost::beast::websocket::close_code::normal);
+void ws::on_write_done(boost::system::error_code ec) {
+    if (ec) {
+        // the read side sees the broken connection too and reports it
+        spdlog::error("ws: write failed: {}", ec.message());
+        queued_.clear();
+        queued_frames_.clear();
+        writing_.clear();
+        writing_frames_.clear();
+        write_index_ = 0;
+        write_in_flight_ = false;
+        queue_depth_.store(0, std::memory_order_relaxed);
+        return;
+    }
+
+    auto latency =
+        std::chrono::steady_clock::now() - writing_frames_[write_index_].queued;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(latency);
+    total_write_latency_ns_.fetch_add(static_cast<std::uint64_t>(ns.count()),
+                                      std::memory_order_relaxed);
+    if (ns.count() > max_write_latency_ns_.load(std::memory_order_relaxed)) {
+        max_write_latency_ns_.store(ns.count(), std::memory_order_relaxed);
     }
+    frames_sent_.fetch_add(1, std::memory_order_relaxed);
+
+    ++write_index_;
+    queue_depth_.store(queued_frames_.size() + writing_frames_.size() -
+                           write_index_,
+                       std::memory_order_relaxed);
+    write_next();
 }
 
-void ws::send(std::string_view message) {
-    if (using_ssl_) {
-        ssl_ws_->write(net::buffer(message));
-    } else {
-        plain_ws_->write(net::buffer(message));
+send_metrics ws::metrics() const {
+    return {
+        .queue_depth = queue_depth_.load(std::memory_order_relaxed),
+        .high_water = write_high_water_.load(std::memory_order_relaxed),
+        .frames_sent = frames_sent_.load(std::memory_order_relaxed),
+        .max_latency = std::chrono::nanoseconds(
+            max_write_latency_ns_.load(std::memory_order_relaxed)),
+        .total_latency = std::chrono::nanoseconds(
+            total_write_latency_ns_.load(std::memory_order_relaxed)),
+    };
+}
+
+std::size_t ws::run_until(std::chrono::steady_clock::time_point deadline) {
+    if (io_context_.stopped()) {
+        io_context_.restart();
     }
-    if (is_debug_enabled()) {
-        std::cout << ">> " << message << std::endl;
+    if (spin_) {
+        return io_context_.poll();
+    }
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        return io_context_.run_one();
+    }
+    return io_context_.run_one_until(deadline);
+}
+
+template <typename F> std::size_t ws::run_read(F &&run) {
+    // two clock_gettime syscalls per run, so only when asked for
+    if (!compression_.enabled) {
+        return run();
     }
+    auto start = thread_cpu_ns();
+    auto ran = run();
+    if (ran) {
+        inflate_cpu_ns_.fetch_add(thread_cpu_ns() - start,
+                                  std::memory_order_relaxed);
+    }
+    return ran;
 }
 
-std::pair<boost::system::error_code, std::string>
+std::pair<boost::system::error_code, std::string_view>
 ws::read_message(std::optional<std::chrono::milliseconds> timeout) {
-    beast::flat_buffer buffer;
-    boost::system::error_code ec;
+    if (!read_pending_) {
+        // keep the capacity from previous frames so steady state reads
+        // don't allocate
+        buffer_.clear();
+        read_done_ = false;
+        read_pending_ = true;
 
-    if (using_ssl_) {
-        if (timeout) {
-            beast::get_lowest_layer(*ssl_ws_).expires_after(*timeout);
-        }
-        ssl_ws_->read(buffer, ec);
-    } else {
-        if (timeout) {
-            beast::get_lowest_layer(*plain_ws_).expires_after(*timeout);
+        with_transport([this](auto &t) {
+            t.async_read(buffer_, [this, &t](boost::system::error_code ec,
+                                             std::size_t) {
+                read_ec_ = ec;
+                read_done_ = true;
+                rx_timestamp_ = t.last_received();
+                if constexpr (requires { t.bytes_received(); }) {
+                    auto total = t.bytes_received();
+                    wire_bytes_.fetch_add(total - wire_seen_,
+                                          std::memory_order_relaxed);
+                    wire_seen_ = total;
+                }
+            });
+        });
+    }
+
+    // The reactor runs queued writes while we wait. No timer is armed per
+    // read: a read that times out stays outstanding for the next call.
+    auto deadline = timeout ? std::chrono::steady_clock::now() + *timeout
+                            : std::chrono::steady_clock::time_point::max();
+    while (!read_done_) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            // a frame that has already arrived still counts, so a zero
+            // timeout reads without blocking
+            if (io_context_.stopped()) {
+                io_context_.restart();
+            }
+            run_read([this] { return io_context_.poll(); });
+            if (read_done_) {
+                break;
+            }
+            return std::make_pair(
+                boost::system::error_code(beast::error::timeout),
+                std::string_view{});
         }
-        plain_ws_->read(buffer, ec);
+        run_read([this, deadline] { return run_until(deadline); });
     }
 
-    if (ec) {
-        return std::make_pair(ec, std::string{});
+    read_pending_ = false;
+    if (read_ec_) {
+        return std::make_pair(read_ec_, std::string_view{});
     }
 
-    std::string buf(static_cast<const char *>(buffer.cdata().data()),
-                    buffer.cdata().size());
+    std::string_view buf(static_cast<const char *>(buffer_.cdata().data()),
+                         buffer_.cdata().size());
+    messages_read_.fetch_add(1, std::memory_order_relaxed);
+    payload_bytes_.fetch_add(buf.size(), std::memory_order_relaxed);
+
+    if (recorder_) {
+        recorder_->record(capture::direction::inbound, buf);
+    }
 
     if (is_debug_enabled()) {
         std::cout << "<< " << buf << std::endl;
     }
 
-    return std::make_pair(ec, std::move(buf));
+    return std::make_pair(read_ec_, buf);
+}
+
+void ws::set_spin(bool spin) { spin_ = spin; }
+
+void ws::set_compression(const compression_options &opts) {
+    compression_ = opts;
+}
+
+compression_metrics ws::compression_stats() const {
+    return {
+        .negotiated = compressed_.load(std::memory_order_relaxed),
+        .messages = messages_read_.load(std::memory_order_relaxed),
+        .payload_bytes = payload_bytes_.load(std::memory_order_relaxed),
+        .wire_bytes = wire_bytes_.load(std::memory_order_relaxed),
+        .inflate_cpu = std::chrono::nanoseconds(
+            inflate_cpu_ns_.load(std::memory_order_relaxed)),
+    };
+}
+
+void ws::set_rx_timestamps(rx_timestamping mode) {
+    rx_mode_ = mode;
+    with_transport([mode](auto &t) {
+        if constexpr (requires { t.stream().set_mode(mode); }) {
+            t.stream().set_mode(mode);
+        }
+    });
+}
+
+void ws::set_busy_poll(std::chrono::microseconds budget) {
+    busy_poll_ = budget;
+    with_transport([budget](auto &t) {
+        if constexpr (requires { t.socket(); }) {
+#if defined(SO_BUSY_POLL)
+            int value = static_cast<int>(budget.count());
+            if (::setsockopt(t.socket().native_handle(), SOL_SOCKET,
+                             SO_BUSY_POLL, &value, sizeof(value)) != 0) {
+                spdlog::warn("ws: SO_BUSY_POLL={}us failed: {}", value,
+                             std::strerror(errno));
+            }
+#else
+            (void)budget;
+            spdlog::warn("ws: SO_BUSY_POLL is not supported on this platform");
+#endif
+        }
+    });
 }
 } // namespace td365
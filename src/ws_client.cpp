@@ -16,11 +16,13 @@
 #include <print>
 #include <ranges>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
 #include <td365/parsing.h>
 #include <td365/td365.h>
 #include <td365/utils.h>
 #include <td365/ws.h>
 #include <td365/ws_client.h>
+#include <thread>
 
 namespace td365 {
 namespace net = boost::asio;
@@ -64,8 +66,29 @@ bool is_error_continuable(const boost::system::error_code &ec) {
     return false;
 }
 
+void check_reconnect_options(const reconnect_options &opts) {
+    verify(opts.jitter >= 0.0 && opts.jitter <= 1.0,
+           "set_reconnect_options: jitter must be within [0, 1]");
+    verify(opts.max_attempts >= 0,
+           "set_reconnect_options: max_attempts must not be negative");
+}
+
+void check_compression_options(const compression_options &opts) {
+    verify(opts.server_max_window_bits >= 9 &&
+               opts.server_max_window_bits <= 15 &&
+               opts.client_max_window_bits >= 9 &&
+               opts.client_max_window_bits <= 15,
+           "set_compression: window bits must be within [9, 15]");
+    verify(opts.level >= 0 && opts.level <= 9,
+           "set_compression: level must be within [0, 9]");
+    verify(opts.mem_level >= 1 && opts.mem_level <= 9,
+           "set_compression: mem_level must be within [1, 9]");
+}
+
 ws_client::ws_client() {}
 
+ws_client::ws_client(boost::asio::io_context &ioc) : io_(&ioc) {}
+
 ws_client::~ws_client() = default;
 
 void ws_client::connect(boost::urls::url_view url, const std::string &login_id,
@@ -75,21 +98,50 @@ void ws_client::connect(boost::urls::url_view url, const std::string &login_id,
     token_ = token;
     stored_url_ = url;
 
-    ws_ = std::make_unique<ws>();
-    ws_->connect(url);
+    ws_ = make_ws();
+    ws_->set_rx_timestamps(rx_mode_);
+    ws_->set_compression(compression_);
+    ws_->set_recorder(recorder_);
+    replaying_ = false;
+    open();
+    link_ = link_state::up;
+    last_frame_at_ = std::chrono::steady_clock::now();
+}
+
+void ws_client::replay(const replay_options &opts) {
+    spdlog::info("ws_client: replaying {} capture files", opts.files.size());
+    ws_ = make_ws();
+    ws_->set_recorder(recorder_);
+    ws_->replay(opts);
+    replaying_ = true;
+    link_ = link_state::up;
+    last_frame_at_ = std::chrono::steady_clock::now();
+}
+
+std::unique_ptr<ws> ws_client::make_ws() {
+    return io_ ? std::make_unique<ws>(*io_) : std::make_unique<ws>();
+}
+
+void ws_client::disconnect() { ws_.reset(); }
+
+void ws_client::open() {
+    // a peer that accepts but never answers must not hang a reconnect
+    constexpr auto handshake_timeout = std::chrono::seconds(30);
+
+    ws_->connect(stored_url_);
 
     // Read connect response
-    auto [ec, buf] = ws_->read_message();
+    auto [ec, buf] = ws_->read_message(handshake_timeout);
     if (ec) {
         throw std::runtime_error("Failed to read connect response: " +
                                  ec.message());
     }
 
     auto msg = nlohmann::json::parse(buf);
-    process_connect_response(msg, login_id, token);
+    process_connect_response(msg, login_id_, token_);
 
     // Read authentication response
-    std::tie(ec, buf) = ws_->read_message();
+    std::tie(ec, buf) = ws_->read_message(handshake_timeout);
     if (ec) {
         throw std::runtime_error("Failed to read auth response: " +
                                  ec.message());
@@ -99,117 +151,431 @@ void ws_client::connect(boost::urls::url_view url, const std::string &login_id,
     process_authentication_response(msg);
 }
 
+void ws_client::set_reconnect_options(const reconnect_options &opts) {
+    check_reconnect_options(opts);
+    reconnect_ = opts;
+}
+
+reconnect_metrics ws_client::reconnect_stats() const {
+    return {
+        .reconnects = reconnects_.load(std::memory_order_relaxed),
+        .failed_attempts = failed_attempts_.load(std::memory_order_relaxed),
+        .last_reconnect_duration = std::chrono::nanoseconds(
+            last_reconnect_ns_.load(std::memory_order_relaxed)),
+        .last_gap = std::chrono::nanoseconds(
+            last_gap_ns_.load(std::memory_order_relaxed)),
+    };
+}
+
+reconnected_event ws_client::last_reconnect() const {
+    return {std::chrono::nanoseconds(
+                last_reconnect_ns_.load(std::memory_order_relaxed)),
+            attempt_};
+}
+
+void ws_client::connection_lost(const boost::system::error_code &ec) {
+    if (!reconnect_.enabled || replaying_) {
+        link_ = link_state::down;
+        return;
+    }
+    spdlog::warn("ws_client: connection lost: {}, reconnecting", ec.message());
+    link_ = link_state::reconnecting;
+    attempt_ = 0;
+    dropped_at_ = std::chrono::steady_clock::now();
+    next_attempt_at_ = dropped_at_;
+}
+
+std::chrono::milliseconds ws_client::backoff_delay(int attempt) {
+    auto doublings = std::min(attempt - 1, 20);
+    std::chrono::milliseconds delay =
+        reconnect_.initial_delay * (std::int64_t{1} << doublings);
+    delay = std::min(delay, reconnect_.max_delay);
+    std::uniform_real_distribution<double> scale(1.0 - reconnect_.jitter,
+                                                 1.0);
+    return std::chrono::milliseconds(static_cast<std::int64_t>(
+        static_cast<double>(delay.count()) * scale(jitter_rng_)));
+}
+
+ws_client::decoded
+ws_client::reconnect(std::optional<std::chrono::milliseconds> timeout) {
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_attempt_at_) {
+        auto wait = next_attempt_at_ - now;
+        if (timeout && *timeout < wait) {
+            std::this_thread::sleep_for(*timeout);
+            return decoded::timeout;
+        }
+        std::this_thread::sleep_for(wait);
+    }
+
+    ++attempt_;
+    try {
+        open();
+    } catch (const std::exception &e) {
+        failed_attempts_.fetch_add(1, std::memory_order_relaxed);
+        spdlog::warn("ws_client: reconnect attempt {} failed: {}", attempt_,
+                     e.what());
+        if (reconnect_.max_attempts > 0 &&
+            attempt_ >= reconnect_.max_attempts) {
+            spdlog::error("ws_client: giving up after {} reconnect attempts",
+                          attempt_);
+            link_ = link_state::down;
+            return decoded::closed;
+        }
+        next_attempt_at_ =
+            std::chrono::steady_clock::now() + backoff_delay(attempt_);
+        return decoded::timeout;
+    }
+
+    auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - dropped_at_);
+    last_reconnect_ns_.store(took.count(), std::memory_order_relaxed);
+    reconnects_.fetch_add(1, std::memory_order_relaxed);
+    spdlog::info("ws_client: reconnected after {} attempts in {}ms", attempt_,
+                 std::chrono::duration_cast<std::chrono::milliseconds>(took)
+                     .count());
+    link_ = link_state::up;
+    gap_open_ = true;
+    return decoded::reconnected;
+}
+
 void ws_client::subscribe(int quote_id) {
-    if (std::ranges::find(subscribed_, quote_id) ==
-        std::ranges::end(subscribed_)) {
-        subscribed_.push_back(quote_id);
-        send({{"quoteId", quote_id},
-              {"priceGrouping", "Sampled"},
-              {"action", "subscribe"}});
+    subscribe(std::span<const int>(&quote_id, 1));
+}
+
+void ws_client::subscribe(std::span<const int> quote_ids) {
+    for (auto quote_id : quote_ids) {
+        if (wanted_.insert(quote_id).second) {
+            mark_dirty(quote_id);
+        }
     }
+    flush_subscriptions();
 }
 
 void ws_client::unsubscribe(int quote_id) {
-    auto pos = std::ranges::find(subscribed_, quote_id);
-    if (pos != std::ranges::end(subscribed_)) {
-        subscribed_.erase(pos);
-        send({{"quoteId", quote_id},
-              {"priceGrouping", "Sampled"},
-              {"action", "unsubscribe"}});
+    unsubscribe(std::span<const int>(&quote_id, 1));
+}
+
+void ws_client::unsubscribe(std::span<const int> quote_ids) {
+    for (auto quote_id : quote_ids) {
+        if (wanted_.erase(quote_id) != 0) {
+            mark_dirty(quote_id);
+        }
+    }
+    flush_subscriptions();
+}
+
+void ws_client::set_subscriptions(std::span<const int> quote_ids) {
+    std::unordered_set<int> next(quote_ids.begin(), quote_ids.end());
+    for (auto quote_id : wanted_) {
+        if (!next.contains(quote_id)) {
+            mark_dirty(quote_id);
+        }
+    }
+    for (auto quote_id : next) {
+        if (!wanted_.contains(quote_id)) {
+            mark_dirty(quote_id);
+        }
+    }
+    wanted_ = std::move(next);
+    flush_subscriptions();
+}
+
+void ws_client::set_subscription_pacing(std::size_t burst,
+                                        std::chrono::milliseconds interval) {
+    verify(burst > 0, "set_subscription_pacing: burst must be positive");
+    pacing_burst_ = burst;
+    pacing_interval_ = interval;
+}
+
+void ws_client::mark_dirty(int quote_id) { pending_.push_back(quote_id); }
+
+void ws_client::flush_subscriptions() {
+    if (pending_.empty() || !ws_) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - window_start_ >= pacing_interval_) {
+        window_start_ = now;
+        window_sent_ = 0;
+    }
+
+    while (!pending_.empty() && window_sent_ < pacing_burst_) {
+        auto quote_id = pending_.front();
+        pending_.pop_front();
+
+        // a quote subscribed and unsubscribed again before it was sent
+        // needs nothing on the wire
+        bool want = wanted_.contains(quote_id);
+        bool have = on_server_.contains(quote_id);
+        if (want && !have) {
+            ws_->send(encoder_.subscribe(quote_id));
+            on_server_.insert(quote_id);
+            ++window_sent_;
+        } else if (!want && have) {
+            ws_->send(encoder_.unsubscribe(quote_id));
+            on_server_.erase(quote_id);
+            ++window_sent_;
+        }
     }
 }
 
 void ws_client::send(const nlohmann::json &body) { ws_->send(body.dump()); }
 
+void ws_client::set_rx_timestamps(rx_timestamping mode) {
+    rx_mode_ = mode;
+    if (ws_) {
+        ws_->set_rx_timestamps(mode);
+    }
+}
+
+void ws_client::set_compression(const compression_options &opts) {
+    check_compression_options(opts);
+    if (ws_) {
+        ws_->set_compression(opts);
+    }
+    compression_ = opts;
+}
+
+void ws_client::set_frame_recorder(frame_recorder *recorder) {
+    recorder_ = recorder;
+    if (ws_) {
+        ws_->set_recorder(recorder);
+    }
+}
+
+void ws_client::set_spin_mode(const spin_options &opts) {
+    verify(ws_ != nullptr, "set_spin_mode: not connected");
+    if (opts.busy_poll_us) {
+        ws_->set_busy_poll(std::chrono::microseconds(*opts.busy_poll_us));
+    }
+    ws_->set_spin(true);
+}
+
+ws_client::decoded ws_client::read_and_decode(
+    std::optional<std::chrono::milliseconds> timeout) {
+    // gaps found in the last batch are reported before reading on
+    if (gaps_reported_ < gaps_.size()) {
+        gap_ = gaps_[gaps_reported_++];
+        if (gaps_reported_ == gaps_.size()) {
+            gaps_.clear();
+            gaps_reported_ = 0;
+        }
+        return decoded::gap;
+    }
+
+    if (link_ == link_state::reconnecting) {
+        return reconnect(timeout);
+    }
+    if (link_ == link_state::down) {
+        return decoded::closed;
+    }
+
+    flush_subscriptions();
+    if (!pending_.empty()) {
+        // come back when the pacing window reopens
+        if (!timeout || *timeout > pacing_interval_) {
+            timeout = pacing_interval_;
+        }
+    }
+
+    auto [ec, buf] = ws_->read_message(timeout);
+    if (ec) {
+        if (ec == boost::asio::error::operation_aborted ||
+            ec == boost::beast::error::timeout) {
+            return decoded::timeout;
+        }
+        connection_lost(ec);
+        if (link_ == link_state::reconnecting) {
+            return decoded::timeout;
+        }
+        if (is_error_continuable(ec)) {
+            return decoded::closed;
+        }
+        read_error_ = ec;
+        return decoded::error;
+    }
+
+    frame_rx_ = ws_->rx_timestamp();
+
+    // last_frame_at_ still holds the last frame before the drop
+    auto now = std::chrono::steady_clock::now();
+    if (gap_open_) {
+        gap_open_ = false;
+        last_gap_ns_.store(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - last_frame_at_)
+                .count(),
+            std::memory_order_relaxed);
+    }
+    last_frame_at_ = now;
+
+    if (!latency_) {
+        return decode(buf, true);
+    }
+    auto received = std::chrono::system_clock::now();
+    auto kind = decode(buf, true);
+    if (kind == decoded::ticks) {
+        latency_->record_ticks(ticks_, received);
+        latency_->record(latency_stage::receive_to_parse,
+                         decoded_at_ - received);
+        if (frame_rx_) {
+            for (const auto &t : ticks_) {
+                latency_->record(latency_stage::server_to_wire,
+                                 *frame_rx_ - t.timestamp);
+            }
+            latency_->record(latency_stage::wire_to_receive,
+                             received - *frame_rx_);
+        }
+    }
+    return kind;
+}
+
 event ws_client::read_and_process_message(
     std::optional<std::chrono::milliseconds> timeout) {
     auto start_time = std::chrono::steady_clock::now();
     auto deadline = timeout ? start_time + *timeout
                             : std::chrono::steady_clock::time_point::max();
 
+    // always read at least once, so a zero timeout picks up frames that
+    // have already arrived
     while (true) {
-        auto now = std::chrono::steady_clock::now();
-        auto remaining = deadline - now;
+        auto remaining = std::max(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()),
+            std::chrono::milliseconds(0));
+        auto read_timeout = timeout ? std::optional(remaining) : std::nullopt;
+
+        // a timeout here may just be the subscription pacing; the deadline
+        // check below decides
+        if (auto kind = read_and_decode(read_timeout);
+            kind != decoded::none && kind != decoded::timeout) {
+            return to_event(kind);
+        }
 
-        if (timeout && remaining <= std::chrono::milliseconds(0)) {
+        if (timeout && std::chrono::steady_clock::now() >= deadline) {
             return timeout_event{};
         }
+    }
+}
 
-        auto read_timeout =
-            timeout ? std::optional(
-                          std::chrono::duration_cast<std::chrono::milliseconds>(
-                              remaining))
-                    : std::nullopt;
-
-        auto [ec, buf] = ws_->read_message(read_timeout);
-        if (ec) {
-            if (ec == boost::asio::error::operation_aborted ||
-                ec == boost::beast::error::timeout) {
-                return timeout_event{};
-            }
-            if (is_error_continuable(ec)) {
-                return connection_closed_event{};
-            }
-            return error_event{ec.message(), std::current_exception()};
-        }
+std::optional<event> ws_client::process_message(std::string_view buf) {
+    frame_rx_.reset();
+    if (auto kind = decode(buf, false); kind != decoded::none) {
+        return to_event(kind);
+    }
+    return std::nullopt;
+}
 
-        auto msg = nlohmann::json::parse(buf);
-
-        std::optional<event> evt;
-        switch (string_to_payload_type(msg["t"].get<std::string>())) {
-        case payload_type::connect_response:
-            evt = process_connect_response(msg, login_id_, token_);
-            break;
-        case payload_type::reconnect_response:
-            evt = process_reconnect_response(msg);
-            break;
-        case payload_type::heartbeat:
-            evt = process_heartbeat(msg);
-            break;
-        case payload_type::authentication_response:
-            evt = process_authentication_response(msg);
-            break;
-        case payload_type::subscribe_response:
-            evt = process_subscribe_response(msg);
-            break;
-        case payload_type::price_data:
-            return process_price_data(msg);
-        case payload_type::account_summary:
-            return process_account_summary(msg);
-        case payload_type::account_details:
-            return process_account_details(msg);
-        case payload_type::trade_established:
-            return process_trade_established(msg);
-        default:
-            spdlog::warn("Unhandled message: {}", msg.dump());
-        }
+event ws_client::to_event(decoded kind) {
+    switch (kind) {
+    case decoded::ticks:
+        return tick_batch_event{ticks_, frame_rx_, exact_};
+    case decoded::account_summary:
+        return account_summary_event{std::move(summary_)};
+    case decoded::account_details:
+        return account_details_event{std::move(details_)};
+    case decoded::trade_established:
+        return trade_established_event{std::move(trade_)};
+    case decoded::reconnected:
+        return last_reconnect();
+    case decoded::gap:
+        return gap_;
+    case decoded::closed:
+        return connection_closed_event{};
+    case decoded::error:
+        return error_event{read_error_.message(), std::exception_ptr{}};
+    case decoded::none:
+    case decoded::timeout:
+        break;
+    }
+    return timeout_event{};
+}
 
-        if (evt) {
-            return *evt;
+ws_client::decoded ws_client::decode(std::string_view buf,
+                                     bool report_gaps) {
+    auto kind = decode_frame(buf);
+    if (kind == decoded::ticks) {
+        sequences_.check(ticks_,
+                         gap_events_ && report_gaps ? &gaps_ : nullptr);
+        if (quote_cache_) {
+            quote_cache_->update(ticks_);
+        }
+        if (latency_) {
+            decoded_at_ = std::chrono::system_clock::now();
         }
     }
+    return kind;
 }
 
-std::optional<event> ws_client::process_heartbeat(const nlohmann::json &j) {
-    send({
-        {"SentByServer", j["d"]["SentByServer"]},
-        {"MessagesReceived", j["d"]["MessagesReceived"]},
-        {"PricesReceived", j["d"]["PricesReceived"]},
-        {"MessagesSent", j["d"]["MessagesSent"]},
-        {"PricesSent", j["d"]["PricesSent"]},
-        {"Visible", true},
-        {"action", "heartbeat"},
-    });
-    return std::nullopt;
+ws_client::decoded ws_client::decode_frame(std::string_view buf) {
+    // price frames are nearly all of the traffic, keep them off the DOM
+    // stays empty in floating mode
+    exact_.clear();
+    if (parse_price_frame(buf, ticks_,
+                          price_mode_ == price_mode::fixed ? &exact_
+                                                           : nullptr)) {
+        return decoded::ticks;
+    }
+    // answered straight from the receive buffer, the reply echoes the raw
+    // counters
+    if (heartbeat_fields hb; parse_heartbeat_frame(buf, hb)) {
+        ws_->send(encoder_.heartbeat(hb));
+        return decoded::none;
+    }
+
+    auto msg = nlohmann::json::parse(buf);
+
+    switch (string_to_payload_type(msg["t"].get<std::string>())) {
+    case payload_type::connect_response:
+        return process_connect_response(msg, login_id_, token_);
+    case payload_type::reconnect_response:
+        return process_reconnect_response(msg);
+    case payload_type::heartbeat:
+        return process_heartbeat(msg);
+    case payload_type::authentication_response:
+        return process_authentication_response(msg);
+    case payload_type::subscribe_response:
+        return process_subscribe_response(msg);
+    case payload_type::price_data:
+        return process_price_data(msg);
+    case payload_type::account_summary:
+        return process_account_summary(msg);
+    case payload_type::account_details:
+        return process_account_details(msg);
+    case payload_type::trade_established:
+        return process_trade_established(msg);
+    default:
+        spdlog::warn("Unhandled message: {}", msg.dump());
+    }
+    return decoded::none;
+}
+
+ws_client::decoded ws_client::process_heartbeat(const nlohmann::json &j) {
+    const auto &d = j["d"];
+    auto sent_by_server = d["SentByServer"].dump();
+    auto messages_received = d["MessagesReceived"].dump();
+    auto prices_received = d["PricesReceived"].dump();
+    auto messages_sent = d["MessagesSent"].dump();
+    auto prices_sent = d["PricesSent"].dump();
+    ws_->send(encoder_.heartbeat({
+        .sent_by_server = sent_by_server,
+        .messages_received = messages_received,
+        .prices_received = prices_received,
+        .messages_sent = messages_sent,
+        .prices_sent = prices_sent,
+    }));
+    return decoded::none;
 }
 
-std::optional<event>
+ws_client::decoded
 ws_client::process_reconnect_response(const nlohmann::json &msg) {
     connection_id_ = msg["cid"].get<std::string>();
-    return std::nullopt;
+    return decoded::none;
 }
 
-std::optional<event>
+ws_client::decoded
 ws_client::process_connect_response(const nlohmann::json &,
                                     const std::string &login_id,
                                     const std::string &token) {
@@ -219,10 +585,10 @@ ws_client::process_connect_response(const nlohmann::json &,
           {"token", token},
           {"reason", "Connect"},
           {"clientVersion", supported_version_}});
-    return std::nullopt;
+    return decoded::none;
 }
 
-std::optional<event>
+ws_client::decoded
 ws_client::process_authentication_response(const nlohmann::json &msg) {
     if (!msg["d"]["Result"].get<bool>()) {
         throw std::runtime_error("Authentication failed");
@@ -234,68 +600,77 @@ ws_client::process_authentication_response(const nlohmann::json &msg) {
     connection_id_ = msg["cid"].get<std::string>();
 
     // subscribe to account summary
-    send({{"data", "{\"SubscribeToAccountSummary\":true,"
-                   "\"SubscribeToAccountDetails\":true}"},
-          {"action", "options"}});
+    ws_->send(outbound_encoder::account_options());
 
-    // re-establish previous quote subscriptions
-    for (auto quote_id : subscribed_) {
-        send({{"quoteId", quote_id},
-              {"priceGrouping", "Sampled"},
-              {"action", "subscribe"}});
-    }
-    return std::nullopt;
+    // re-establish previous quote subscriptions, paced like any other
+    on_server_.clear();
+    pending_.assign(wanted_.begin(), wanted_.end());
+    flush_subscriptions();
+    return decoded::none;
 }
 
-event ws_client::process_price_data(const nlohmann::json &msg) {
+tick_prices *ws_client::next_exact() {
+    return price_mode_ == price_mode::fixed ? &exact_.emplace_back() : nullptr;
+}
+
+ws_client::decoded ws_client::process_price_data(const nlohmann::json &msg) {
     const auto &data = msg["d"];
 
+    ticks_.clear();
     for (const auto &key : grouping_map) {
         if (auto it = data.find(key.first);
-            it != data.end() && it->is_array() && !it->empty()) {
-            auto prices = it->get<std::vector<std::string>>();
-            for (const auto &price : prices) {
-                return tick_event{parse_td_tick(price, key.second)};
+            it != data.end() && it->is_array()) {
+            for (const auto &price : *it) {
+                ticks_.push_back(
+                    parse_td_tick(price.get_ref<const std::string &>(),
+                                  key.second, next_exact()));
             }
         }
     }
-    throw std::runtime_error("process_price_data: no price data found");
+    verify(!ticks_.empty(), "process_price_data: no price data found");
+    return decoded::ticks;
 }
 
-std::optional<event>
+ws_client::decoded
 ws_client::process_subscribe_response(const nlohmann::json &msg) {
-    auto d = msg["d"];
+    const auto &d = msg["d"];
     verify(d["HasError"].get<bool>() == false, "HasError is true");
-    auto prices = d["Current"].get<std::vector<std::string>>();
     auto g = string_to_price_type(d["PriceGrouping"].get<std::string>());
-    if (!prices.empty()) {
-        return tick_event{parse_td_tick(prices[0], g)};
+
+    ticks_.clear();
+    for (const auto &price : d["Current"]) {
+        ticks_.push_back(parse_td_tick(price.get_ref<const std::string &>(),
+                                       g, next_exact()));
     }
-    return std::nullopt;
+    return ticks_.empty() ? decoded::none : decoded::ticks;
 }
 
-event ws_client::process_account_summary(const nlohmann::json &msg) {
+ws_client::decoded
+ws_client::process_account_summary(const nlohmann::json &msg) {
     spdlog::info("account summary received: {}", msg.dump());
     // - PlatformID: 0 - Basic/Standard platform
     // - PlatformID: 3 - Platform with Spread/CFD switching capability
     if (msg.at("d").at("PlatformID").get<int>() == 0) {
         spdlog::info("account summary: skip platform 0:", msg.dump());
         // throw std::runtime_error("Skipping platform 0 account summary");
-        return account_summary_event{};
+        summary_ = account_summary{};
+        return decoded::account_summary;
     }
-    auto summary = msg["d"].get<account_summary>();
-    return account_summary_event{std::move(summary)};
+    summary_ = msg["d"].get<account_summary>();
+    return decoded::account_summary;
 }
 
-event ws_client::process_account_details(const nlohmann::json &msg) {
+ws_client::decoded
+ws_client::process_account_details(const nlohmann::json &msg) {
     spdlog::info("account details received: {}", msg.dump());
-    auto details = msg["d"].get<account_details>();
-    return account_details_event{std::move(details)};
+    details_ = msg["d"].get<account_details>();
+    return decoded::account_details;
 }
 
-event ws_client::process_trade_established(const nlohmann::json &msg) {
+ws_client::decoded
+ws_client::process_trade_established(const nlohmann::json &msg) {
     spdlog::info("trade established received: {}", msg.dump());
-    auto details = msg["d"].get<trade_details>();
-    return trade_established_event{std::move(details)};
+    trade_ = msg["d"].get<trade_details>();
+    return decoded::trade_established;
 }
 } // namespace td365
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <functional>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <td365/memory_transport.h>
+
+// A price frame with a single tick of `quote_id`, with `seq` as its
+// sequence number (field13)
+inline std::string price_frame(int quote_id, int seq) {
+    return R"({"t":"p","d":{"sp":[")" + std::to_string(quote_id) +
+           R"(,104850.50,104910.50,-1147.00,d,1,)"
+           R"(106498.50,102786.50,)"
+           R"(O+E4W55s4o+2dEv3T2kaaz+lkLwePRX97aJOsVcIe6c=,)"
+           R"(0,104880.50,638854057031360000,)" +
+           std::to_string(seq) + R"("]}})";
+}
+
+// Answers ws_client's connect and login handshake on `server` the way
+// fake_ws_server does, without sockets. Beyond that, `on_action` gets each
+// frame with an "action" other than authentication, `on_open` each new
+// connection before it is sent connectResponse, and `on_other` frames
+// without an action. Handlers run on the thread of whichever client wrote
+// the frame.
+inline void serve_login(
+    td365::memory_server &server,
+    std::function<void(td365::memory_connection &, const nlohmann::json &)>
+        on_action = {},
+    std::function<void(td365::memory_connection &)> on_open = {},
+    std::function<void(td365::memory_connection &, std::string_view)>
+        on_other = {}) {
+    server.on_open([on_open = std::move(on_open)](
+                       td365::memory_connection &c) {
+        if (on_open) {
+            on_open(c);
+        }
+        c.send(nlohmann::json{{"t", "connectResponse"}}.dump());
+    });
+    server.on_frame([on_action = std::move(on_action),
+                     on_other = std::move(on_other)](
+                        td365::memory_connection &c, std::string_view frame) {
+        auto msg = nlohmann::json::parse(frame, nullptr, false);
+        if (msg.is_discarded() || !msg.contains("action")) {
+            if (on_other) {
+                on_other(c, frame);
+            }
+            return;
+        }
+        if (msg["action"] == "authentication") {
+            c.send(nlohmann::json{{"t", "authenticationResponse"},
+                                  {"cid", "fake-connection"},
+                                  {"d", {{"Result", true}}}}
+                       .dump());
+        } else if (on_action) {
+            on_action(c, msg);
+        }
+    });
+}
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <td365/types.h>
+
+// A tick of `quote_id` with `seq` as its sequence number (field13), and
+// everything else zeroed
+inline td365::tick make_tick(int quote_id, int seq) {
+    td365::tick t{};
+    t.quote_id = quote_id;
+    t.field13 = seq;
+    return t;
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <chrono>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+using nlohmann::json;
+
+// Fake WebSocket server for testing
+class fake_ws_server {
+  public:
+    fake_ws_server(net::io_context &ioc, unsigned short port)
+        : ioc_(ioc), acceptor_(ioc, tcp::endpoint(tcp::v4(), port)) {
+        // Get the actual port number assigned by the system
+        port_ = acceptor_.local_endpoint().port();
+    }
+
+    boost::asio::awaitable<void> run(std::atomic<bool> &shutdown) {
+        while (!shutdown.load()) {
+            try {
+                tcp::socket socket =
+                    co_await acceptor_.async_accept(boost::asio::use_awaitable);
+
+                // Handle WebSocket connection
+                co_await handle_websocket_connection(std::move(socket),
+                                                     shutdown);
+            } catch (const std::exception &e) {
+                if (!shutdown.load()) {
+                    // Only log if not shutting down
+                    spdlog::debug("Server accept error: {}", e.what());
+                }
+                break;
+            }
+        }
+    }
+
+    // Accept permessage-deflate when the client offers it
+    void set_permessage_deflate(bool enabled) { deflate_ = enabled; }
+
+    void set_disconnect_after_connect(bool disconnect) {
+        disconnect_after_connect_ = disconnect;
+    }
+
+    void set_disconnect_delay(std::chrono::milliseconds delay) {
+        disconnect_delay_ = delay;
+    }
+
+    // Once a client subscribes, send `count` single-price frames `interval`
+    // apart. Each price's field13 carries its index into sent_at().
+    void set_price_stream(std::size_t count,
+                          std::chrono::microseconds interval) {
+        stream_count_ = count;
+        stream_interval_ = interval;
+        sent_at_.assign(count, {});
+    }
+
+    // Only safe to read once the server's io_context has stopped
+    const std::vector<std::chrono::steady_clock::time_point> &sent_at() const {
+        return sent_at_;
+    }
+
+    int get_connection_count() const { return connection_count_.load(); }
+
+    // "reconnect" actions naming the connection id handed out earlier
+    int get_reconnect_requests() const { return reconnect_requests_.load(); }
+
+    int get_subscribe_requests() const { return subscribe_requests_.load(); }
+
+    // Refuse further connections. Call on the server's io_context.
+    void stop_accepting() {
+        boost::system::error_code ignored;
+        acceptor_.close(ignored);
+    }
+
+    unsigned short get_port() const { return port_; }
+
+  private:
+    boost::asio::awaitable<void>
+    handle_websocket_connection(tcp::socket socket,
+                                std::atomic<bool> &shutdown) {
+        try {
+            websocket::stream<tcp::socket> ws(std::move(socket));
+            if (deflate_) {
+                websocket::permessage_deflate pmd;
+                pmd.server_enable = true;
+                ws.set_option(pmd);
+            }
+
+            // Accept the WebSocket handshake
+            co_await ws.async_accept(boost::asio::use_awaitable);
+
+            connection_count_++;
+
+            json j = {{"t", "connectResponse"}};
+            co_await ws.async_write(
+                net::buffer(j.dump().c_str(), j.dump().size() + 1),
+                boost::asio::use_awaitable);
+
+            // Drop the TCP connection without a close frame once the delay
+            // is up, like a network failure would. The timer is declared
+            // after ws so it is cancelled first.
+            net::steady_timer drop_timer(ioc_);
+            if (disconnect_after_connect_) {
+                drop_timer.expires_after(disconnect_delay_);
+                drop_timer.async_wait([&ws](boost::system::error_code ec) {
+                    if (!ec) {
+                        boost::system::error_code ignored;
+                        ws.next_layer().close(ignored);
+                    }
+                });
+            }
+
+            // Handle messages until the client goes away
+            while (!shutdown.load()) {
+                try {
+                    beast::flat_buffer buffer;
+                    co_await ws.async_read(buffer, boost::asio::use_awaitable);
+
+                    auto msg = json::parse(
+                        beast::buffers_to_string(buffer.data()), nullptr,
+                        false);
+                    if (msg.is_discarded() || !msg.contains("action")) {
+                        // Echo back any other message
+                        co_await ws.async_write(buffer.data(),
+                                                boost::asio::use_awaitable);
+                        continue;
+                    }
+
+                    auto action = msg["action"].get<std::string>();
+                    if (action == "authentication") {
+                        json reply = {{"t", "authenticationResponse"},
+                                      {"cid", "fake-connection"},
+                                      {"d", {{"Result", true}}}};
+                        co_await ws.async_write(net::buffer(reply.dump()),
+                                                boost::asio::use_awaitable);
+                    } else if (action == "reconnect") {
+                        if (msg.value("originalConnectionId", "") ==
+                            "fake-connection") {
+                            reconnect_requests_++;
+                        }
+                    } else if (action == "subscribe") {
+                        subscribe_requests_++;
+                        if (stream_count_) {
+                            co_await stream_prices(ws);
+                        }
+                    }
+                    // options, heartbeats etc. need no reply
+                } catch (const std::exception &) {
+                    // Connection closed by client
+                    break;
+                }
+            }
+        } catch (const std::exception &e) {
+            spdlog::debug("WebSocket connection error: {}", e.what());
+        }
+    }
+
+    boost::asio::awaitable<void>
+    stream_prices(websocket::stream<tcp::socket> &ws) {
+        net::steady_timer timer(ioc_);
+        for (std::size_t i = 0; i < stream_count_; ++i) {
+            auto frame = json{{"t", "p"},
+                              {"d",
+                               {{"sp",
+                                 {"870964,104850.50,104910.50,-1147.00,d,1,"
+                                  "106498.50,102786.50,"
+                                  "O+E4W55s4o+2dEv3T2kaaz+lkLwePRX97aJOsVcIe6c"
+                                  "=,0,104880.50,638854057031360000," +
+                                  std::to_string(i)}}}}}
+                             .dump();
+
+            sent_at_[i] = std::chrono::steady_clock::now();
+            co_await ws.async_write(net::buffer(frame),
+                                    boost::asio::use_awaitable);
+
+            timer.expires_after(stream_interval_);
+            co_await timer.async_wait(boost::asio::use_awaitable);
+        }
+    }
+
+    net::io_context &ioc_;
+    tcp::acceptor acceptor_;
+    unsigned short port_;
+    std::atomic<bool> deflate_ = false;
+    std::atomic<bool> disconnect_after_connect_ = false;
+    std::chrono::milliseconds disconnect_delay_ =
+        std::chrono::milliseconds(1000);
+    std::atomic<int> connection_count_ = 0;
+    std::atomic<int> reconnect_requests_ = 0;
+    std::atomic<int> subscribe_requests_ = 0;
+
+    std::size_t stream_count_ = 0;
+    std::chrono::microseconds stream_interval_{};
+    std::vector<std::chrono::steady_clock::time_point> sent_at_;
+};
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include "fake_ticks.h"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <td365/conflator.h>
+#include <vector>
+
+TEST_CASE("conflator keeps the newest tick per quote", "[conflator]") {
+    td365::conflator c;
+    REQUIRE(c.take().empty());
+
+    std::vector<td365::tick> ticks = {
+        make_tick(2, 1), make_tick(1, 1), make_tick(2, 2),
+        make_tick(2, 3), make_tick(3, 1), make_tick(1, 2),
+    };
+    c.update(ticks);
+
+    auto out = c.take();
+    REQUIRE(out.size() == 3);
+    // in the order the quotes first changed
+    REQUIRE(out[0].quote_id == 2);
+    REQUIRE(out[0].field13 == 3);
+    REQUIRE(out[1].quote_id == 1);
+    REQUIRE(out[1].field13 == 2);
+    REQUIRE(out[2].quote_id == 3);
+    REQUIRE(out[2].field13 == 1);
+
+    // nothing changed since
+    REQUIRE(c.take().empty());
+
+    std::vector<td365::tick> more = {make_tick(1, 3)};
+    c.update(more);
+    out = c.take();
+    REQUIRE(out.size() == 1);
+    REQUIRE(out[0].field13 == 3);
+
+    auto m = c.metrics();
+    REQUIRE(m.updates == 7);
+    REQUIRE(m.delivered == 4);
+    REQUIRE(m.dropped == 3);
+    REQUIRE(m.quotes == 3);
+}
+
+TEST_CASE("conflator caps the per-quote delivery rate", "[conflator]") {
+    using namespace std::chrono_literals;
+    td365::conflator c({.min_interval = 10ms});
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<td365::tick> a = {make_tick(1, 1), make_tick(2, 1)};
+    c.update(a);
+    REQUIRE(c.take(t0).size() == 2);
+    REQUIRE_FALSE(c.holding());
+
+    // quote 1 changes again too soon and is held, with the newest value
+    std::vector<td365::tick> b = {make_tick(1, 2), make_tick(1, 3)};
+    c.update(b);
+    REQUIRE(c.take(t0 + 4ms).empty());
+    REQUIRE(c.holding());
+    REQUIRE(c.next_due() == t0 + 10ms);
+
+    auto out = c.take(t0 + 10ms);
+    REQUIRE(out.size() == 1);
+    REQUIRE(out[0].field13 == 3);
+    REQUIRE_FALSE(c.holding());
+    REQUIRE(c.metrics().dropped == 1);
+}
+
+TEST_CASE("Benchmark conflator", "[benchmark]") {
+    // 500 quotes updated 4 times per take
+    std::vector<td365::tick> ticks;
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < 500; ++i) {
+            ticks.push_back(make_tick(800000 + i * 13, round));
+        }
+    }
+
+    td365::conflator c;
+    BENCHMARK("update 2000 ticks + take") {
+        c.update(ticks);
+        return c.take().size();
+    };
+}
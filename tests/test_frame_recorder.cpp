@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <algorithm>
+#include <catch2/catch_all.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <td365/frame_recorder.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+// fresh directory per test, removed afterwards
+struct temp_dir {
+    fs::path path;
+
+    explicit temp_dir(const std::string &name)
+        : path(fs::temp_directory_path() / ("td365-" + name)) {
+        fs::remove_all(path);
+        fs::create_directories(path);
+    }
+    ~temp_dir() { fs::remove_all(path); }
+
+    std::vector<fs::path> files() const {
+        std::vector<fs::path> out;
+        for (const auto &e : fs::directory_iterator(path)) {
+            out.push_back(e.path());
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+};
+
+td365::capture_options options_for(const temp_dir &dir) {
+    td365::capture_options opts;
+    opts.directory = dir.path;
+    return opts;
+}
+
+std::vector<td365::captured_frame> read_all(td365::capture_reader &reader) {
+    std::vector<td365::captured_frame> frames;
+    while (auto f = reader.next()) {
+        frames.push_back(*f);
+    }
+    return frames;
+}
+} // namespace
+
+TEST_CASE("frame_recorder round-trips frames", "[capture]") {
+    temp_dir dir("capture-roundtrip");
+    auto t0 = std::chrono::steady_clock::now();
+    fs::path file;
+    {
+        td365::frame_recorder rec(options_for(dir));
+        rec.record(td365::capture::direction::outbound,
+                   R"({"action":"subscribe"})", t0);
+        rec.record(td365::capture::direction::inbound, "",
+                   t0 + std::chrono::microseconds(1));
+        rec.record(td365::capture::direction::inbound, "abc",
+                   t0 + std::chrono::microseconds(2));
+        file = rec.current_file();
+
+        auto m = rec.metrics();
+        REQUIRE(m.frames == 3);
+        REQUIRE(m.bytes == 25);
+        REQUIRE(m.files == 1);
+    }
+
+    td365::capture_reader reader(file);
+    auto frames = read_all(reader);
+    REQUIRE(frames.size() == 3);
+    REQUIRE(frames[0].dir == td365::capture::direction::outbound);
+    REQUIRE(frames[0].payload == R"({"action":"subscribe"})");
+    REQUIRE(frames[0].at == t0);
+    REQUIRE(frames[1].payload.empty());
+    REQUIRE(frames[2].dir == td365::capture::direction::inbound);
+    REQUIRE(frames[2].payload == "abc");
+    REQUIRE(frames[2].at == t0 + std::chrono::microseconds(2));
+
+    // the preallocated tail is dropped on close
+    REQUIRE(fs::file_size(file) == 32 + 16 + 24 + 16 + 16 + 8);
+}
+
+TEST_CASE("frame_recorder rotates by size", "[capture]") {
+    temp_dir dir("capture-rotate");
+    std::string payload(100, 'x');
+    auto opts = options_for(dir);
+    opts.prefix = "feed";
+    opts.max_file_size = 1024;
+    {
+        td365::frame_recorder rec(opts);
+        for (int i = 0; i < 30; ++i) {
+            rec.record(td365::capture::direction::inbound, payload);
+        }
+        // a frame bigger than a whole file still fits in a file of its own
+        rec.record(td365::capture::direction::inbound, std::string(4096, 'y'));
+        REQUIRE(rec.metrics().files > 1);
+    }
+
+    std::size_t small = 0;
+    std::size_t big = 0;
+    for (const auto &f : dir.files()) {
+        REQUIRE(f.filename().string().starts_with("feed-"));
+        td365::capture_reader reader(f);
+        for (const auto &frame : read_all(reader)) {
+            if (frame.payload.size() == 4096) {
+                ++big;
+            } else {
+                REQUIRE(frame.payload == payload);
+                ++small;
+            }
+        }
+    }
+    REQUIRE(small == 30);
+    REQUIRE(big == 1);
+}
+
+TEST_CASE("frame_recorder rotates by age", "[capture]") {
+    temp_dir dir("capture-age");
+    auto t0 = std::chrono::steady_clock::now();
+    auto opts = options_for(dir);
+    opts.max_file_age = std::chrono::seconds(60);
+    td365::frame_recorder rec(opts);
+    rec.record(td365::capture::direction::inbound, "a", t0);
+    auto first = rec.current_file();
+    rec.record(td365::capture::direction::inbound, "b",
+               t0 + std::chrono::seconds(61));
+    REQUIRE(rec.current_file() != first);
+    REQUIRE(rec.metrics().files == 2);
+}
+
+TEST_CASE("capture_reader rejects other files", "[capture]") {
+    temp_dir dir("capture-reject");
+    auto path = dir.path / "not-a-capture";
+    {
+        std::FILE *f = std::fopen(path.c_str(), "w");
+        std::fputs("definitely not a capture file header", f);
+        std::fclose(f);
+    }
+    REQUIRE_THROWS(td365::capture_reader(path));
+    REQUIRE_THROWS(td365::capture_reader(dir.path / "missing"));
+}
+
+TEST_CASE("Benchmark frame_recorder", "[benchmark][capture]") {
+    temp_dir dir("capture-bench");
+    td365::frame_recorder rec(options_for(dir));
+    // a typical price frame
+    std::string frame(180, 'p');
+
+    BENCHMARK("record 180 byte frame") {
+        rec.record(td365::capture::direction::inbound, frame);
+    };
+}
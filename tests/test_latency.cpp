@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <catch2/catch_all.hpp>
+#include <td365/latency.h>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("latency_histogram buckets stay within 1/16 of the value",
+          "[latency]") {
+    using h = td365::latency_histogram;
+    for (std::uint64_t ns = 0; ns < 16; ++ns) {
+        REQUIRE(h::bucket_of(ns) == ns);
+        REQUIRE(h::bucket_lower(ns) == ns);
+    }
+    REQUIRE(h::bucket_of(16) == 16);
+    REQUIRE(h::bucket_of(31) == 31);
+    REQUIRE(h::bucket_of(32) == 32);
+    REQUIRE(h::bucket_of(33) == 32);
+
+    for (std::uint64_t ns : {17ull, 1000ull, 123456ull, 987654321ull,
+                             (1ull << 39) + 12345}) {
+        auto b = h::bucket_of(ns);
+        auto lower = h::bucket_lower(b);
+        REQUIRE(lower <= ns);
+        REQUIRE(ns < h::bucket_lower(b + 1));
+        REQUIRE(ns - lower <= ns / 16);
+    }
+    REQUIRE(h::bucket_of(~0ull) == h::bucket_count - 1);
+}
+
+TEST_CASE("latency_histogram percentiles", "[latency]") {
+    td365::latency_histogram hist;
+    REQUIRE(hist.snapshot().count == 0);
+    REQUIRE(hist.snapshot().percentile(99) == 0ns);
+
+    for (int us = 1; us <= 1000; ++us) {
+        hist.record(std::chrono::microseconds(us));
+    }
+    hist.record(-5ns);
+
+    auto s = hist.snapshot();
+    REQUIRE(s.count == 1001);
+    REQUIRE(s.min == 0ns);
+    REQUIRE(s.max == 1000us);
+    REQUIRE(s.mean > 499us);
+    REQUIRE(s.mean < 501us);
+
+    auto near = [](std::chrono::nanoseconds got,
+                   std::chrono::nanoseconds want) {
+        return got >= want && got <= want + want / 16;
+    };
+    REQUIRE(near(s.percentile(50), 500us));
+    REQUIRE(near(s.percentile(90), 900us));
+    REQUIRE(near(s.percentile(99), 990us));
+    REQUIRE(s.percentile(100) == 1000us);
+    REQUIRE_FALSE(s.summary().empty());
+
+    hist.reset();
+    REQUIRE(hist.snapshot().count == 0);
+}
+
+TEST_CASE("latency_recorder tracks stages and quotes", "[latency]") {
+    td365::latency_recorder rec(2);
+    auto received = std::chrono::system_clock::now();
+
+    std::vector<td365::tick> ticks(3);
+    ticks[0].quote_id = 10;
+    ticks[0].timestamp = received - 2ms;
+    ticks[1].quote_id = 20;
+    ticks[1].timestamp = received - 4ms;
+    ticks[2].quote_id = 30;
+    ticks[2].timestamp = received - 8ms;
+    rec.record_ticks(ticks, received);
+    rec.record(td365::latency_stage::receive_to_parse, 3us);
+
+    auto total = rec.snapshot(td365::latency_stage::server_to_receive);
+    REQUIRE(total.count == 3);
+    REQUIRE(total.min == 2ms);
+    REQUIRE(total.max == 8ms);
+    REQUIRE(rec.snapshot(td365::latency_stage::receive_to_parse).count == 1);
+    REQUIRE(rec.snapshot(td365::latency_stage::parse_to_delivery).count == 0);
+
+    REQUIRE(rec.snapshot(10)->max == 2ms);
+    REQUIRE(rec.snapshot(20)->max == 4ms);
+    // only two quotes fit
+    REQUIRE_FALSE(rec.snapshot(30).has_value());
+
+    // once full, tracked quotes still record and new ones stay out
+    ticks[1].quote_id = 40;
+    rec.record_ticks(ticks, received);
+    REQUIRE(rec.snapshot(10)->count == 2);
+    REQUIRE(rec.snapshot(20)->count == 1);
+    REQUIRE_FALSE(rec.snapshot(30).has_value());
+    REQUIRE_FALSE(rec.snapshot(40).has_value());
+
+    rec.reset();
+    REQUIRE(rec.snapshot(td365::latency_stage::server_to_receive).count == 0);
+    REQUIRE(rec.snapshot(10)->count == 0);
+}
+
+TEST_CASE("latency_histogram records from several threads", "[latency]") {
+    td365::latency_histogram hist;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 100000; ++i) {
+                hist.record(std::chrono::nanoseconds(t * 1000 + i % 1000));
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    auto s = hist.snapshot();
+    REQUIRE(s.count == 400000);
+    REQUIRE(s.min == 0ns);
+    REQUIRE(s.max == 3999ns);
+}
+
+TEST_CASE("Benchmark latency_histogram", "[benchmark]") {
+    td365::latency_histogram hist;
+    std::int64_t n = 0;
+
+    BENCHMARK("record") {
+        hist.record(std::chrono::nanoseconds(++n * 7919 % 10000000));
+    };
+
+    BENCHMARK("snapshot + p99") { return hist.snapshot().percentile(99); };
+}
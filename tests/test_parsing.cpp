@@ -1,10 +1,16 @@
 // tests/td_resolve_host_port_tests.cpp
 
 #define CATCH_CONFIG_MAIN
+#include <boost/beast/core/buffers_to_string.hpp>
 #include <catch2/catch_all.hpp>
+#include <format>
+#include <nlohmann/json.hpp>
 #include <string>
+#include <td365/outbound.h>
 #include <td365/parsing.h>
+#include <td365/td365.h>
 #include <td365/types.h>
+#include <td365/ws_client.h>
 #include <vector>
 
 // clang-format off
@@ -81,6 +87,500 @@ TEST_CASE("Benchmark parse_td_tick()", "[benchmark]") {
     };
 }
 
+TEST_CASE("parse_td_tick() splits every field", "[parsing]") {
+    auto t = td365::parse_td_tick(lines[0], td365::grouping::sampled);
+    REQUIRE(t.quote_id == 870964);
+    REQUIRE(t.bid == Catch::Approx(104850.50));
+    REQUIRE(t.ask == Catch::Approx(104910.50));
+    REQUIRE(t.daily_change == Catch::Approx(-1147.00));
+    REQUIRE(t.dir == td365::direction::down);
+    REQUIRE(t.tradable == true);
+    REQUIRE(t.high == Catch::Approx(106498.50));
+    REQUIRE(t.low == Catch::Approx(102786.50));
+    REQUIRE(t.hash == "O+E4W55s4o+2dEv3T2kaaz+lkLwePRX97aJOsVcIe6c=");
+    REQUIRE(t.call_only == false);
+    REQUIRE(t.mid_price == Catch::Approx(104880.50));
+    REQUIRE(t.field13 == 455503);
+
+    REQUIRE_THROWS(td365::parse_td_tick("870964,104850.50,104910.50",
+                                        td365::grouping::sampled));
+    REQUIRE(td365::parse_td_tick(lines[0] + ",extra", td365::grouping::sampled)
+                .field13 == 455503);
+}
+
+TEST_CASE("fixed_price parsing and arithmetic", "[parsing][fixed_price]") {
+    auto p = td365::parse_fixed_price("104850.50");
+    REQUIRE(p.mantissa == 10485050);
+    REQUIRE(p.decimals == 2);
+    REQUIRE(p.to_string() == "104850.50");
+    REQUIRE(td365::parse_fixed_price("-0.000360").mantissa == -360);
+    REQUIRE(td365::parse_fixed_price("19").decimals == 0);
+    REQUIRE_THROWS(td365::parse_fixed_price("1.2.3"));
+    REQUIRE_THROWS(td365::parse_fixed_price(""));
+
+    // equal values at different scales compare equal
+    REQUIRE(p == td365::fixed_price{104850500, 3});
+    REQUIRE(td365::fixed_price{1, 1} < td365::fixed_price{11, 2});
+    REQUIRE((p - td365::fixed_price{5, 1}).to_string() == "104850.00");
+    REQUIRE(td365::fixed_price{125, 2}.rescale(1).mantissa == 13);
+
+    // decimals outside 0..18, and scaling past the int64 range, throw
+    REQUIRE_THROWS(td365::fixed_price{1, -1}.to_double());
+    REQUIRE_THROWS(td365::fixed_price{1, 19}.to_string());
+    REQUIRE_THROWS(p.rescale(19));
+    REQUIRE_THROWS(p.rescale(18));
+    REQUIRE_THROWS(td365::fixed_price::from_double(1.5, 20));
+    REQUIRE_THROWS(td365::fixed_price::from_double(1e300, 2));
+    REQUIRE(td365::fixed_price::from_double(104850.51, 2).mantissa ==
+            10485051);
+
+    SECTION("ticks in fixed mode match the double path") {
+        for (const auto &line : lines) {
+            auto d = td365::parse_td_tick(line, td365::grouping::sampled);
+            td365::tick_prices exact;
+            auto f =
+                td365::parse_td_tick(line, td365::grouping::sampled, &exact);
+            REQUIRE(f.bid == d.bid);
+            REQUIRE(f.ask == d.ask);
+            REQUIRE(f.high == d.high);
+            REQUIRE(f.low == d.low);
+            REQUIRE(f.mid_price == d.mid_price);
+            REQUIRE(exact.bid.to_double() == d.bid);
+            REQUIRE(exact.ask > exact.bid);
+            REQUIRE(exact.mid.to_double() == d.mid_price);
+        }
+    }
+
+    SECTION("price frames") {
+        std::vector<td365::tick> ticks;
+        std::vector<td365::tick_prices> exact;
+        REQUIRE(td365::parse_price_frame(
+            std::format(R"({{"t":"p","d":{{"sp":["{}","{}"]}}}})", lines[0],
+                        lines[1]),
+            ticks, &exact));
+        REQUIRE(exact.size() == 2);
+        REQUIRE(exact[0].ask == td365::fixed_price{10491050, 2});
+        REQUIRE(exact[1].mid == td365::fixed_price{63, 2});
+    }
+
+    SECTION("candles") {
+        td365::candle_prices exact;
+        auto c = td365::parse_candle(
+            "2025-06-16T07:32:00+00:00,107109.5,107155.5,107109.5,107128.5,29",
+            &exact);
+        REQUIRE(exact.close == td365::fixed_price{1071285, 1});
+        REQUIRE(c.close == Catch::Approx(107128.5));
+    }
+}
+
+TEST_CASE("Benchmark parse_td_tick() price modes", "[benchmark]") {
+    BENCHMARK("floating") {
+        td365::tick result;
+        for (const auto &line : lines) {
+            result = td365::parse_td_tick(line, td365::grouping::grouped);
+        }
+        return result;
+    };
+
+    BENCHMARK("fixed") {
+        td365::tick result;
+        td365::tick_prices exact;
+        for (const auto &line : lines) {
+            result =
+                td365::parse_td_tick(line, td365::grouping::grouped, &exact);
+        }
+        return result;
+    };
+}
+
+TEST_CASE("tick_hash is stored inline", "[tick]") {
+    STATIC_REQUIRE(std::is_trivially_copyable_v<td365::tick>);
+
+    td365::tick_hash h("O+E4W55s4o+2dEv3T2kaaz+lkLwePRX97aJOsVcIe6c=");
+    REQUIRE(h.size() == 44);
+    REQUIRE(h == "O+E4W55s4o+2dEv3T2kaaz+lkLwePRX97aJOsVcIe6c=");
+    REQUIRE(h.str() == "O+E4W55s4o+2dEv3T2kaaz+lkLwePRX97aJOsVcIe6c=");
+
+    // shorter values don't compare against stale bytes
+    h = "dGVzdF9oYXNo";
+    REQUIRE(h == td365::tick_hash("dGVzdF9oYXNo"));
+    REQUIRE_THROWS_AS(td365::tick_hash(std::string(45, 'a')),
+                      std::length_error);
+}
+
+TEST_CASE("Benchmark tick copy", "[benchmark]") {
+    std::vector<td365::tick> ticks;
+    for (const auto &line : lines) {
+        ticks.push_back(td365::parse_td_tick(line, td365::grouping::sampled));
+    }
+    std::vector<td365::tick> dest(ticks.size());
+
+    BENCHMARK("copy sample feed") {
+        std::ranges::copy(ticks, dest.begin());
+        return dest.back().quote_id;
+    };
+}
+
+TEST_CASE("packed_tick round-trips a tick", "[tick]") {
+    STATIC_REQUIRE(sizeof(td365::packed_tick) == 64);
+    STATIC_REQUIRE(alignof(td365::packed_tick) == 64);
+
+    for (const auto &line : lines) {
+        auto t = td365::parse_td_tick(line, td365::grouping::sampled);
+        auto back = td365::packed_tick::from(t).to_tick();
+        REQUIRE(back.quote_id == t.quote_id);
+        REQUIRE(back.bid == t.bid);
+        REQUIRE(back.ask == t.ask);
+        REQUIRE(back.high == t.high);
+        REQUIRE(back.low == t.low);
+        REQUIRE(back.mid_price == t.mid_price);
+        REQUIRE(back.daily_change ==
+                Catch::Approx(t.daily_change).epsilon(1e-6));
+        REQUIRE(back.dir == t.dir);
+        REQUIRE(back.tradable == t.tradable);
+        REQUIRE(back.call_only == t.call_only);
+        REQUIRE(back.timestamp == t.timestamp);
+        REQUIRE(back.field13 == t.field13);
+        REQUIRE(back.group == t.group);
+        REQUIRE(back.hash.empty());
+    }
+}
+
+TEST_CASE("Benchmark packed_tick copy", "[benchmark]") {
+    std::vector<td365::tick> ticks;
+    std::vector<td365::packed_tick> packed;
+    for (const auto &line : lines) {
+        ticks.push_back(td365::parse_td_tick(line, td365::grouping::sampled));
+        packed.push_back(td365::packed_tick::from(ticks.back()));
+    }
+    std::vector<td365::tick> tick_dest(ticks.size());
+    std::vector<td365::packed_tick> packed_dest(packed.size());
+
+    INFO("sizeof(tick)=" << sizeof(td365::tick) << " sizeof(packed_tick)="
+                         << sizeof(td365::packed_tick));
+
+    BENCHMARK("copy tick") {
+        std::ranges::copy(ticks, tick_dest.begin());
+        return tick_dest.back().quote_id;
+    };
+
+    BENCHMARK("copy packed_tick") {
+        std::ranges::copy(packed, packed_dest.begin());
+        return packed_dest.back().quote_id;
+    };
+
+    BENCHMARK("pack") {
+        for (size_t i = 0; i < ticks.size(); ++i) {
+            packed_dest[i] = td365::packed_tick::from(ticks[i]);
+        }
+        return packed_dest.back().quote_id;
+    };
+}
+
+// Builds a "p" frame carrying `n` prices taken from `lines`
+static std::string make_price_frame(std::string_view key, size_t first,
+                                    size_t n) {
+    auto prices = nlohmann::json::array();
+    for (size_t i = 0; i < n; ++i) {
+        prices.push_back(lines[(first + i) % lines.size()]);
+    }
+    return nlohmann::json{{"t", "p"}, {"d", {{key, prices}}}}.dump();
+}
+
+TEST_CASE("ws_client delivers every price in a frame", "[ws_client][parsing]") {
+    td365::ws_client client;
+
+    SECTION("price frame") {
+        auto frame = make_price_frame("sp", 0, 40);
+        auto evt = client.process_message(frame);
+        REQUIRE(evt.has_value());
+        auto *batch = std::get_if<td365::tick_batch_event>(&*evt);
+        REQUIRE(batch != nullptr);
+        REQUIRE(batch->data.size() == 40);
+        for (size_t i = 0; i < batch->data.size(); ++i) {
+            auto expected =
+                td365::parse_td_tick(lines[i], td365::grouping::sampled);
+            REQUIRE(batch->data[i].quote_id == expected.quote_id);
+            REQUIRE(batch->data[i].field13 == expected.field13);
+            REQUIRE(batch->data[i].group == td365::grouping::sampled);
+        }
+    }
+
+    SECTION("subscribe response") {
+        auto frame = nlohmann::json{
+            {"t", "subscribeResponse"},
+            {"d",
+             {{"HasError", false},
+              {"PriceGrouping", "Sampled"},
+              {"Current", {lines[0], lines[1], lines[2]}}}}}.dump();
+        auto evt = client.process_message(frame);
+        REQUIRE(evt.has_value());
+        auto *batch = std::get_if<td365::tick_batch_event>(&*evt);
+        REQUIRE(batch != nullptr);
+        REQUIRE(batch->data.size() == 3);
+        REQUIRE(batch->data[2].quote_id ==
+                td365::parse_td_tick(lines[2], td365::grouping::sampled)
+                    .quote_id);
+    }
+}
+
+namespace {
+struct tick_counter {
+    size_t ticks = 0;
+    size_t summaries = 0;
+    int last_field13 = 0;
+
+    void on_tick(td365::tick &&t) {
+        ++ticks;
+        last_field13 = t.field13;
+    }
+    void on_account_summary(td365::account_summary &&) { ++summaries; }
+    void on_account_details(td365::account_details &&) {}
+    void on_trade_established(td365::trade_details &&) {}
+};
+
+struct batch_counter {
+    size_t batches = 0;
+    size_t ticks = 0;
+
+    void on_ticks(std::span<const td365::tick> batch) {
+        ++batches;
+        ticks += batch.size();
+    }
+    void on_account_summary(td365::account_summary &&) {}
+    void on_account_details(td365::account_details &&) {}
+    void on_trade_established(td365::trade_details &&) {}
+};
+} // namespace
+
+TEST_CASE("ws_client::dispatch() calls the handlers directly",
+          "[ws_client][parsing]") {
+    STATIC_REQUIRE(td365::UserCallbacksLike<tick_counter>);
+    STATIC_REQUIRE(td365::BatchCallbacksLike<batch_counter>);
+    STATIC_REQUIRE(!td365::BatchCallbacksLike<tick_counter>);
+
+    td365::ws_client client;
+    auto frame = make_price_frame("sp", 0, 40);
+
+    SECTION("per tick") {
+        tick_counter h;
+        client.dispatch(frame, h);
+        REQUIRE(h.ticks == 40);
+        REQUIRE(h.last_field13 ==
+                td365::parse_td_tick(lines[39], td365::grouping::sampled)
+                    .field13);
+    }
+
+    SECTION("batched") {
+        batch_counter h;
+        client.dispatch(frame, h);
+        client.dispatch(frame, h);
+        REQUIRE(h.batches == 2);
+        REQUIRE(h.ticks == 80);
+    }
+}
+
+TEST_CASE("Benchmark event variant vs direct dispatch", "[benchmark]") {
+    td365::ws_client client;
+    auto frame = make_price_frame("sp", 0, 40);
+    tick_counter h;
+
+    BENCHMARK("process_message + visit") {
+        auto evt = client.process_message(frame);
+        std::visit(
+            [&h](auto &&e) {
+                using T = std::decay_t<decltype(e)>;
+                if constexpr (std::is_same_v<T, td365::tick_batch_event>) {
+                    for (const auto &t : e.data) {
+                        h.on_tick(td365::tick{t});
+                    }
+                }
+            },
+            *evt);
+        return h.ticks;
+    };
+
+    BENCHMARK("dispatch") {
+        client.dispatch(frame, h);
+        return h.ticks;
+    };
+}
+
+TEST_CASE("Benchmark multi-price frame decode", "[benchmark]") {
+    constexpr size_t prices_per_frame = 40;
+    td365::ws_client client;
+
+    std::vector<std::string> single_frames;
+    for (size_t i = 0; i < prices_per_frame; ++i) {
+        single_frames.push_back(make_price_frame("sp", i, 1));
+    }
+    auto multi_frame = make_price_frame("sp", 0, prices_per_frame);
+
+    BENCHMARK("40 frames x 1 price") {
+        size_t n = 0;
+        for (const auto &frame : single_frames) {
+            auto evt = client.process_message(frame);
+            n += std::get<td365::tick_batch_event>(*evt).data.size();
+        }
+        return n;
+    };
+
+    BENCHMARK("1 frame x 40 prices") {
+        auto evt = client.process_message(multi_frame);
+        return std::get<td365::tick_batch_event>(*evt).data.size();
+    };
+}
+
+TEST_CASE("parse_price_frame() matches the JSON parser", "[parsing]") {
+    std::vector<td365::tick> ticks;
+
+    SECTION("single group") {
+        auto frame = make_price_frame("gp", 3, 5);
+        REQUIRE(td365::parse_price_frame(frame, ticks));
+        REQUIRE(ticks.size() == 5);
+        for (size_t i = 0; i < ticks.size(); ++i) {
+            auto expected =
+                td365::parse_td_tick(lines[3 + i], td365::grouping::grouped);
+            REQUIRE(ticks[i].quote_id == expected.quote_id);
+            REQUIRE(ticks[i].bid == expected.bid);
+            REQUIRE(ticks[i].hash == expected.hash);
+            REQUIRE(ticks[i].group == td365::grouping::grouped);
+        }
+    }
+
+    SECTION("whitespace, unknown keys and \"d\" before \"t\"") {
+        auto frame = std::format(R"( {{ "d" : {{ "x": {{"a":[1,"]"]}}, )"
+                                 R"("dp" : [ "{}" ] }}, "t" : "p" }} )",
+                                 lines[0]);
+        REQUIRE(td365::parse_price_frame(frame, ticks));
+        REQUIRE(ticks.size() == 1);
+        REQUIRE(ticks[0].group == td365::grouping::delayed);
+    }
+
+    SECTION("falls back for control messages and escapes") {
+        REQUIRE_FALSE(td365::parse_price_frame(
+            R"({"t":"heartbeat","d":{"SentByServer":1}})", ticks));
+        REQUIRE_FALSE(td365::parse_price_frame(
+            R"({"t":"p","d":{"sp":["a\/b"]}})", ticks));
+        REQUIRE_FALSE(
+            td365::parse_price_frame(R"({"t":"p","d":{"sp":[)", ticks));
+        REQUIRE(ticks.empty());
+    }
+}
+
+TEST_CASE("Benchmark price frame decode", "[benchmark]") {
+    auto frame = make_price_frame("sp", 0, 40);
+    std::vector<td365::tick> ticks;
+
+    BENCHMARK("nlohmann::json DOM") {
+        auto msg = nlohmann::json::parse(frame);
+        ticks.clear();
+        if (msg["t"].get<std::string>() == "p") {
+            const auto &data = msg["d"];
+            for (const auto &key : td365::grouping_map) {
+                if (auto it = data.find(key.first);
+                    it != data.end() && it->is_array()) {
+                    for (const auto &price :
+                         it->get<std::vector<std::string>>()) {
+                        ticks.push_back(
+                            td365::parse_td_tick(price, key.second));
+                    }
+                }
+            }
+        }
+        return ticks.size();
+    };
+
+    BENCHMARK("parse_price_frame") {
+        td365::parse_price_frame(frame, ticks);
+        return ticks.size();
+    };
+}
+
+static const std::string heartbeat_frame =
+    R"({"t":"heartbeat","cid":"abc",)"
+    R"("d":{"SentByServer":"2025-09-03T23:59:58Z","MessagesReceived":12,)"
+    R"("PricesReceived":3456,"MessagesSent":7,)"
+    R"("PricesSent":3460}})";
+
+TEST_CASE("outbound_encoder matches nlohmann::json::dump()", "[outbound]") {
+    td365::outbound_encoder enc;
+
+    auto quote_action = [](std::string_view action, int quote_id) {
+        return nlohmann::json{{"quoteId", quote_id},
+                              {"priceGrouping", "Sampled"},
+                              {"action", action}}
+            .dump();
+    };
+    REQUIRE(enc.subscribe(870964) == quote_action("subscribe", 870964));
+    REQUIRE(enc.unsubscribe(-1) == quote_action("unsubscribe", -1));
+    REQUIRE(td365::outbound_encoder::account_options() ==
+            nlohmann::json{{"data", "{\"SubscribeToAccountSummary\":true,"
+                                    "\"SubscribeToAccountDetails\":true}"},
+                           {"action", "options"}}
+                .dump());
+
+    td365::heartbeat_fields hb;
+    REQUIRE(td365::parse_heartbeat_frame(heartbeat_frame, hb));
+    auto j = nlohmann::json::parse(heartbeat_frame);
+    auto expected = nlohmann::json{
+        {"SentByServer", j["d"]["SentByServer"]},
+        {"MessagesReceived", j["d"]["MessagesReceived"]},
+        {"PricesReceived", j["d"]["PricesReceived"]},
+        {"MessagesSent", j["d"]["MessagesSent"]},
+        {"PricesSent", j["d"]["PricesSent"]},
+        {"Visible", true},
+        {"action", "heartbeat"},
+    }.dump();
+    REQUIRE(boost::beast::buffers_to_string(enc.heartbeat(hb)) == expected);
+}
+
+TEST_CASE("parse_heartbeat_frame() only accepts heartbeats", "[parsing]") {
+    td365::heartbeat_fields hb;
+    REQUIRE_FALSE(
+        td365::parse_heartbeat_frame(make_price_frame("sp", 0, 1), hb));
+    REQUIRE_FALSE(td365::parse_heartbeat_frame(
+        R"({"t":"heartbeat","d":{"SentByServer":1}})", hb));
+    REQUIRE_FALSE(td365::parse_heartbeat_frame("not json", hb));
+}
+
+TEST_CASE("Benchmark heartbeat reply encoding", "[benchmark]") {
+    td365::outbound_encoder enc;
+
+    BENCHMARK("nlohmann::json parse + dump") {
+        auto j = nlohmann::json::parse(heartbeat_frame);
+        return nlohmann::json{
+            {"SentByServer", j["d"]["SentByServer"]},
+            {"MessagesReceived", j["d"]["MessagesReceived"]},
+            {"PricesReceived", j["d"]["PricesReceived"]},
+            {"MessagesSent", j["d"]["MessagesSent"]},
+            {"PricesSent", j["d"]["PricesSent"]},
+            {"Visible", true},
+            {"action", "heartbeat"},
+        }
+            .dump()
+            .size();
+    };
+
+    BENCHMARK("parse_heartbeat_frame + outbound_encoder") {
+        td365::heartbeat_fields hb;
+        td365::parse_heartbeat_frame(heartbeat_frame, hb);
+        return enc.heartbeat(hb).size();
+    };
+
+    BENCHMARK("subscribe: nlohmann::json") {
+        return nlohmann::json{{"quoteId", 870964},
+                              {"priceGrouping", "Sampled"},
+                              {"action", "subscribe"}}
+            .dump()
+            .size();
+    };
+
+    BENCHMARK("subscribe: outbound_encoder") {
+        return enc.subscribe(870964).size();
+    };
+}
+
 TEST_CASE("tick::parse() can parse CSV format", "[tick][parsing]") {
     SECTION("Parse real production data") {
         std::string_view csv_line = "5906,1.344040,1.344160,-0.000360,unchanged,true,1.344960,1.343730,99LYtEFhXIHWibMb+HeD4Rp0fkdqa5iDwwRrfSlc4gU=,false,1.344090,2025-09-03T23:59:58.069Z,1044784,Sampled,62707541";
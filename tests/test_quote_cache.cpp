@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <atomic>
+#include <catch2/catch_all.hpp>
+#include <td365/quote_cache.h>
+#include <thread>
+#include <vector>
+
+namespace {
+// every price field carries `n`, so a torn read shows up as a mismatch
+td365::tick filled_tick(int quote_id, int n) {
+    td365::tick t{};
+    t.quote_id = quote_id;
+    t.bid = n;
+    t.ask = n;
+    t.high = n;
+    t.low = n;
+    t.mid_price = n;
+    t.field13 = n;
+    t.hash = std::to_string(n);
+    return t;
+}
+
+bool consistent(const td365::tick &t) {
+    return t.bid == t.field13 && t.ask == t.field13 &&
+           t.mid_price == t.field13 && t.hash == std::to_string(t.field13);
+}
+} // namespace
+
+TEST_CASE("quote_cache returns the latest tick per quote", "[quote_cache]") {
+    td365::quote_cache cache(8);
+    REQUIRE_FALSE(cache.get_quote(870964).has_value());
+
+    std::vector<td365::tick> ticks = {filled_tick(870964, 1),
+                                      filled_tick(870965, 7),
+                                      filled_tick(870964, 2)};
+    cache.update(ticks);
+    REQUIRE(cache.size() == 2);
+
+    auto q = cache.get_quote(870964);
+    REQUIRE(q.has_value());
+    REQUIRE(q->bid == 2);
+    REQUIRE(q->hash == "2");
+    REQUIRE(cache.get_quote(870965)->field13 == 7);
+    REQUIRE_FALSE(cache.get_quote(1).has_value());
+}
+
+TEST_CASE("quote_cache stops caching new quotes when full", "[quote_cache]") {
+    td365::quote_cache cache(4);
+    for (int i = 0; i < 6; ++i) {
+        cache.update(filled_tick(100 + i, i));
+    }
+    REQUIRE(cache.size() == 4);
+    REQUIRE(cache.overflow() == 2);
+    REQUIRE_FALSE(cache.get_quote(105).has_value());
+
+    // known quotes still update
+    cache.update(filled_tick(100, 42));
+    REQUIRE(cache.get_quote(100)->field13 == 42);
+}
+
+TEST_CASE("quote_cache reads never tear", "[quote_cache]") {
+    td365::quote_cache cache(16);
+    cache.update(filled_tick(1, 0));
+
+    std::atomic<bool> done = false;
+    std::thread writer([&] {
+        for (int n = 1; n <= 200000; ++n) {
+            cache.update(filled_tick(1, n));
+        }
+        done = true;
+    });
+
+    std::atomic<int> torn = 0;
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&] {
+            int last = 0;
+            while (!done) {
+                auto q = cache.get_quote(1);
+                if (!q || !consistent(*q) || q->field13 < last) {
+                    ++torn;
+                    return;
+                }
+                last = q->field13;
+            }
+        });
+    }
+
+    writer.join();
+    for (auto &r : readers) {
+        r.join();
+    }
+    REQUIRE(torn == 0);
+    REQUIRE(cache.get_quote(1)->field13 == 200000);
+}
+
+TEST_CASE("Benchmark quote_cache", "[benchmark]") {
+    td365::quote_cache cache(512);
+    for (int i = 0; i < 500; ++i) {
+        cache.update(filled_tick(800000 + i * 13, 0));
+    }
+
+    BENCHMARK("get_quote, no writer") {
+        return cache.get_quote(800000 + 250 * 13)->bid;
+    };
+
+    BENCHMARK("update") {
+        cache.update(filled_tick(800000, 1));
+        return cache.size();
+    };
+
+    // one writer updating the quote being read, plus two more readers
+    std::atomic<bool> stop = false;
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        for (int n = 0; !stop.load(std::memory_order_relaxed); ++n) {
+            cache.update(filled_tick(800000, n));
+        }
+    });
+    for (int r = 0; r < 2; ++r) {
+        threads.emplace_back([&] {
+            double sink = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                sink += cache.get_quote(800000)->bid;
+            }
+            (void)sink;
+        });
+    }
+
+    BENCHMARK("get_quote, 1 writer + 2 readers on the same quote") {
+        return cache.get_quote(800000)->bid;
+    };
+
+    stop = true;
+    for (auto &t : threads) {
+        t.join();
+    }
+}
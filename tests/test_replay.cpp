@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include "fake_memory_server.h"
+
+#include <algorithm>
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <td365/frame_recorder.h>
+#include <td365/replay.h>
+#include <td365/ws_client.h>
+#include <thread>
+#include <variant>
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+namespace {
+// A session of `count` price frames `gap` apart, with a subscribe request
+// in between as the client would have sent it
+struct recorded_session {
+    fs::path dir;
+
+    recorded_session(const std::string &name, int count,
+                     std::chrono::milliseconds gap,
+                     std::size_t max_file_size = std::size_t{1} << 20)
+        : dir(fs::temp_directory_path() / ("td365-" + name)) {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+
+        td365::capture_options opts;
+        opts.directory = dir;
+        opts.max_file_size = max_file_size;
+        td365::frame_recorder rec(opts);
+        auto at = std::chrono::steady_clock::now();
+        rec.record(td365::capture::direction::outbound,
+                   R"({"action":"subscribe","quoteId":870964})", at);
+        for (int i = 0; i < count; ++i) {
+            rec.record(td365::capture::direction::inbound,
+                       price_frame(870964, i), at + i * gap);
+        }
+    }
+    ~recorded_session() { fs::remove_all(dir); }
+
+    td365::replay_options options(double speed = 0.0) const {
+        td365::replay_options opts;
+        opts.files = td365::capture_files(dir);
+        opts.speed = speed;
+        return opts;
+    }
+};
+
+// reads to the end of the replay, returns the sequence numbers seen
+std::vector<int> drain(td365::ws_client &client) {
+    std::vector<int> seen;
+    while (true) {
+        auto evt = client.read_and_process_message(1s);
+        if (auto *batch = std::get_if<td365::tick_batch_event>(&evt)) {
+            for (const auto &t : batch->data) {
+                seen.push_back(t.field13);
+            }
+        } else if (std::holds_alternative<td365::connection_closed_event>(
+                       evt)) {
+            return seen;
+        } else {
+            FAIL("unexpected event");
+        }
+    }
+}
+} // namespace
+
+TEST_CASE("Replay feeds captured frames through ws_client", "[replay]") {
+    // small files, so the session spans several
+    recorded_session session("replay-all", 200, 1ms, 4096);
+    auto opts = session.options();
+    REQUIRE(opts.files.size() > 1);
+
+    td365::ws_client client;
+    client.replay(opts);
+    auto seen = drain(client);
+
+    REQUIRE(seen.size() == 200);
+    for (int i = 0; i < 200; ++i) {
+        REQUIRE(seen[static_cast<std::size_t>(i)] == i);
+    }
+    REQUIRE(client.sequence_stats().gaps == 0);
+}
+
+TEST_CASE("Replay leaves the reconnect options alone", "[replay]") {
+    recorded_session session("replay-then-live", 3, 1ms);
+    td365::ws_client client;
+    td365::reconnect_options fast;
+    fast.initial_delay = 1ms;
+    client.set_reconnect_options(fast);
+    client.replay(session.options());
+    REQUIRE(drain(client).size() == 3);
+
+    // a live connection made afterwards still reconnects
+    td365::memory_server server("replay-then-live");
+    std::shared_ptr<td365::memory_connection> conn;
+    serve_login(server, {}, [&conn](td365::memory_connection &c) {
+        conn = c.shared_from_this();
+    });
+    client.connect(boost::urls::url(server.url()), "login", "token");
+    auto first = conn;
+    first->drop();
+
+    bool reconnected = false;
+    for (int i = 0; i < 100 && !reconnected; ++i) {
+        auto evt = client.read_and_process_message(100ms);
+        REQUIRE_FALSE(
+            std::holds_alternative<td365::connection_closed_event>(evt));
+        reconnected = std::holds_alternative<td365::reconnected_event>(evt);
+    }
+    REQUIRE(reconnected);
+    REQUIRE(conn != first);
+}
+
+TEST_CASE("Replay keeps the recorded gaps, sped up", "[replay]") {
+    // 20 frames 50ms apart at 10x: about 95ms instead of 950ms
+    recorded_session session("replay-paced", 20, 50ms);
+    td365::ws_client client;
+    client.replay(session.options(10.0));
+
+    auto start = std::chrono::steady_clock::now();
+    auto seen = drain(client);
+    auto took = std::chrono::steady_clock::now() - start;
+
+    REQUIRE(seen.size() == 20);
+    REQUIRE(took >= 90ms);
+    REQUIRE(took < 900ms);
+}
+
+TEST_CASE("Replay paces files from different boots by wall time",
+          "[replay]") {
+    auto dir = fs::temp_directory_path() / "td365-replay-boots";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    td365::capture_options opts;
+    opts.directory = dir;
+
+    // three frames 10ms apart in each file, the second file's 30ms after
+    // the first's, but on a steady clock an hour behind
+    auto record = [&](int first, std::chrono::milliseconds after,
+                      std::chrono::hours skew) {
+        auto at = std::chrono::steady_clock::now() + after;
+        td365::frame_recorder rec(opts);
+        for (int i = 0; i < 3; ++i) {
+            rec.record(td365::capture::direction::inbound,
+                       price_frame(870964, first + i), at + skew + i * 10ms);
+        }
+    };
+    record(0, 0ms, 0h);
+    // files are named by the millisecond they were opened in
+    std::this_thread::sleep_for(2ms);
+    record(3, 30ms, -1h);
+
+    auto files = td365::capture_files(dir);
+    REQUIRE(files.size() == 2);
+    {
+        std::fstream f(files[1],
+                       std::ios::in | std::ios::out | std::ios::binary);
+        td365::capture::file_header h{};
+        f.read(reinterpret_cast<char *>(&h), sizeof(h));
+        h.created_steady_ns -= std::chrono::nanoseconds(1h).count();
+        f.seekp(0);
+        f.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    }
+
+    td365::replay_feed feed({.files = files, .speed = 1.0});
+    std::vector<std::chrono::steady_clock::time_point> due;
+    while (auto frame = feed.next()) {
+        due.push_back(frame->due);
+    }
+    REQUIRE(due.size() == 6);
+    REQUIRE(std::ranges::is_sorted(due));
+    REQUIRE(due.back() - due.front() < 1s);
+    fs::remove_all(dir);
+}
+
+TEST_CASE("Paced replay times out between frames", "[replay]") {
+    recorded_session session("replay-timeout", 2, 1000ms);
+    td365::ws_client client;
+    client.replay(session.options(1.0));
+
+    auto first = client.read_and_process_message(100ms);
+    REQUIRE(std::holds_alternative<td365::tick_batch_event>(first));
+    auto second = client.read_and_process_message(10ms);
+    REQUIRE(std::holds_alternative<td365::timeout_event>(second));
+}
+
+TEST_CASE("Benchmark replay decode throughput", "[benchmark][replay]") {
+    constexpr int count = 10000;
+    recorded_session session("replay-bench", count, 0ms);
+    auto opts = session.options();
+
+    BENCHMARK("replay 10000 price frames") {
+        td365::ws_client client;
+        client.replay(opts);
+        return drain(client).size();
+    };
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include "fake_memory_server.h"
+#include "fake_ticks.h"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <td365/quote_index.h>
+#include <td365/sequence_tracker.h>
+#include <td365/ws_client.h>
+#include <vector>
+
+TEST_CASE("quote_index hands out dense slots", "[sequence]") {
+    td365::quote_index index(4);
+    REQUIRE(index.find(870964) == td365::quote_index::npos);
+
+    // enough sparse ids to force several resizes
+    for (int i = 0; i < 1000; ++i) {
+        REQUIRE(index.insert(870964 + i * 7919) == static_cast<unsigned>(i));
+    }
+    REQUIRE(index.size() == 1000);
+    for (int i = 0; i < 1000; ++i) {
+        REQUIRE(index.find(870964 + i * 7919) == static_cast<unsigned>(i));
+        REQUIRE(index.insert(870964 + i * 7919) == static_cast<unsigned>(i));
+    }
+    REQUIRE(index.find(-1) == td365::quote_index::npos);
+}
+
+TEST_CASE("sequence_tracker classifies each tick", "[sequence]") {
+    td365::sequence_tracker tracker;
+    std::vector<td365::gap_event> gaps;
+
+    std::vector<td365::tick> ticks = {
+        make_tick(1, 100), // first sighting
+        make_tick(2, 500), // first sighting
+        make_tick(1, 101), // in order
+        make_tick(1, 105), // gap of three
+        make_tick(2, 501), // in order, other quote unaffected
+        make_tick(1, 105), // duplicate
+        make_tick(1, 103), // out of order
+        make_tick(2, 510), // gap of eight
+    };
+    tracker.check(ticks, &gaps);
+
+    auto m = tracker.metrics();
+    REQUIRE(m.ticks == ticks.size());
+    REQUIRE(m.gaps == 2);
+    REQUIRE(m.missed == 11);
+    REQUIRE(m.duplicates == 1);
+    REQUIRE(m.out_of_order == 1);
+
+    REQUIRE(gaps.size() == 2);
+    REQUIRE(gaps[0].quote_id == 1);
+    REQUIRE(gaps[0].expected == 102);
+    REQUIRE(gaps[0].received == 105);
+    REQUIRE(gaps[1].quote_id == 2);
+    REQUIRE(gaps[1].expected == 502);
+    REQUIRE(gaps[1].received == 510);
+
+    // the late tick didn't move the quote backwards
+    std::vector<td365::tick> next = {make_tick(1, 106)};
+    tracker.check(next, nullptr);
+    REQUIRE(tracker.metrics().gaps == 2);
+}
+
+TEST_CASE("ws_client reports sequence gaps", "[sequence][ws_client]") {
+    auto frame = [](int seq) {
+        return nlohmann::json{
+            {"t", "p"},
+            {"d",
+             {{"sp",
+               {"870964,104850.50,104910.50,-1147.00,d,1,106498.50,"
+                "102786.50,O+E4W55s4o+2dEv3T2kaaz+lkLwePRX97aJOsVcIe6c=,0,"
+                "104880.50,638854057031360000," +
+                std::to_string(seq)}}}}}
+            .dump();
+    };
+
+    td365::ws_client client;
+    client.set_gap_events(true);
+    for (int seq : {455503, 455504, 455507, 455507}) {
+        auto evt = client.process_message(frame(seq));
+        REQUIRE(evt.has_value());
+        REQUIRE(std::holds_alternative<td365::tick_batch_event>(*evt));
+    }
+
+    auto m = client.sequence_stats();
+    REQUIRE(m.ticks == 4);
+    REQUIRE(m.gaps == 1);
+    REQUIRE(m.missed == 2);
+    REQUIRE(m.duplicates == 1);
+    REQUIRE(m.out_of_order == 0);
+
+    // a single frame makes a single event, so that gap was only counted;
+    // reading the connection reports them after their batch
+    td365::memory_server server("sequence-gaps");
+    std::shared_ptr<td365::memory_connection> conn;
+    serve_login(server, {}, [&conn](td365::memory_connection &c) {
+        conn = c.shared_from_this();
+    });
+    client.connect(boost::urls::url(server.url()), "login", "token");
+    conn->send(frame(455508));
+    conn->send(frame(455511));
+
+    using namespace std::chrono_literals;
+    auto evt = client.read_and_process_message(1s);
+    REQUIRE(std::holds_alternative<td365::tick_batch_event>(evt));
+    evt = client.read_and_process_message(1s);
+    REQUIRE(std::holds_alternative<td365::tick_batch_event>(evt));
+    evt = client.read_and_process_message(1s);
+    auto *gap = std::get_if<td365::gap_event>(&evt);
+    REQUIRE(gap != nullptr);
+    REQUIRE(gap->quote_id == 870964);
+    REQUIRE(gap->expected == 455509);
+    REQUIRE(gap->received == 455511);
+    REQUIRE(std::holds_alternative<td365::timeout_event>(
+        client.read_and_process_message(10ms)));
+    REQUIRE(client.sequence_stats().gaps == 2);
+}
+
+TEST_CASE("Benchmark sequence_tracker", "[benchmark]") {
+    // 500 quotes, one tick each per frame
+    std::vector<td365::tick> ticks(500);
+    for (int i = 0; i < 500; ++i) {
+        ticks[static_cast<std::size_t>(i)] = make_tick(800000 + i * 13, 0);
+    }
+
+    td365::sequence_tracker tracker;
+    int seq = 0;
+    BENCHMARK("check 500 ticks") {
+        ++seq;
+        for (auto &t : ticks) {
+            t.field13 = seq;
+        }
+        tracker.check(ticks, nullptr);
+        return tracker.metrics().ticks;
+    };
+    REQUIRE(tracker.metrics().gaps == 0);
+}
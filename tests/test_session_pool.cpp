@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include "fake_memory_server.h"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <td365/io_thread.h>
+#include <td365/memory_transport.h>
+#include <td365/session_pool.h>
+#include <td365/ws_client.h>
+#include <unistd.h>
+#include <variant>
+#include <vector>
+
+using nlohmann::json;
+using namespace std::chrono_literals;
+
+namespace {
+// Logs in any number of clients and remembers which connection subscribed
+// to which quote. Handlers run on the pool threads, hence the lock.
+struct pool_server {
+    td365::memory_server server;
+    std::mutex mutex;
+    std::map<int, std::shared_ptr<td365::memory_connection>> by_quote;
+    std::map<int, int> seq;
+
+    explicit pool_server(std::string name) : server(std::move(name)) {
+        serve_login(server, [this](td365::memory_connection &c,
+                                   const json &msg) {
+            if (msg["action"] == "subscribe") {
+                std::lock_guard lock(mutex);
+                by_quote[msg["quoteId"].get<int>()] = c.shared_from_this();
+            }
+        });
+    }
+
+    std::string url() const { return server.url(); }
+
+    std::size_t subscribed() {
+        std::lock_guard lock(mutex);
+        return by_quote.size();
+    }
+
+    std::shared_ptr<td365::memory_connection> conn(int quote_id) {
+        std::lock_guard lock(mutex);
+        return by_quote.at(quote_id);
+    }
+
+    void publish(int quote_id) {
+        std::lock_guard lock(mutex);
+        by_quote.at(quote_id)->send(price_frame(quote_id, seq[quote_id]++));
+    }
+};
+
+// One connection subscribed to quote `id`, read by a pool thread or, with
+// no pool, a thread of its own
+struct session {
+    std::unique_ptr<td365::ws_client> client;
+    std::unique_ptr<td365::io_thread> io;
+
+    session(td365::session_pool *pool, const std::string &url, int id,
+            std::size_t capacity = 256)
+        : client(pool ? std::make_unique<td365::ws_client>(pool->context())
+                      : std::make_unique<td365::ws_client>()) {
+        td365::reconnect_options no_reconnect;
+        no_reconnect.enabled = false;
+        client->set_reconnect_options(no_reconnect);
+
+        if (!pool) {
+            client->connect(boost::urls::url(url), "login", "token");
+            io = std::make_unique<td365::io_thread>(*client, capacity);
+        } else {
+            // the handshake runs on the pool thread, as td365 does it
+            io =
+                std::make_unique<td365::io_thread>(*client, *pool, capacity);
+            std::promise<void> done;
+            io->post([&](td365::ws_client &c) {
+                c.connect(boost::urls::url(url), "login", "token");
+                done.set_value();
+            });
+            done.get_future().get();
+        }
+        io->post([id](td365::ws_client &c) { c.subscribe(id); });
+    }
+
+    int next_quote() {
+        auto evt = io->wait(1s);
+        auto *batch = std::get_if<td365::tick_batch_event>(&evt);
+        if (!batch || batch->data.size() != 1) {
+            return -1;
+        }
+        return batch->data[0].quote_id;
+    }
+};
+
+std::vector<std::unique_ptr<session>>
+open_sessions(pool_server &server, td365::session_pool *pool, int count) {
+    std::vector<std::unique_ptr<session>> sessions;
+    for (int i = 0; i < count; ++i) {
+        sessions.push_back(std::make_unique<session>(pool, server.url(), i));
+    }
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (server.subscribed() < static_cast<std::size_t>(count) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(server.subscribed() == static_cast<std::size_t>(count));
+    return sessions;
+}
+
+std::size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    std::size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+// Measured in a child process, so both kinds of session start from the
+// same heap and neither reuses memory the other freed
+std::size_t resident_per_session(int count, bool pooled) {
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+    // or the child's logging flushes our pending output a second time
+    std::fflush(nullptr);
+    auto pid = ::fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+        std::size_t per_session = 0;
+        try {
+            pool_server server("pool-memory");
+            td365::session_pool pool(1);
+            auto before = resident_bytes();
+            auto sessions =
+                open_sessions(server, pooled ? &pool : nullptr, count);
+            auto after = resident_bytes();
+            per_session = after > before
+                              ? (after - before) /
+                                    static_cast<std::size_t>(count)
+                              : 0;
+        } catch (...) {
+        }
+        auto written = ::write(fds[1], &per_session, sizeof(per_session));
+        ::_exit(written == sizeof(per_session) ? 0 : 1);
+    }
+
+    ::close(fds[1]);
+    std::size_t per_session = 0;
+    auto got = ::read(fds[0], &per_session, sizeof(per_session));
+    ::close(fds[0]);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    REQUIRE(got == sizeof(per_session));
+    return per_session;
+}
+
+double process_cpu_ns() {
+    timespec ts{};
+    ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) * 1e9 +
+           static_cast<double>(ts.tv_nsec);
+}
+} // namespace
+
+TEST_CASE("session_pool reads many sessions on a few threads",
+          "[session_pool]") {
+    pool_server server("pool-many");
+    td365::session_pool pool(2);
+    auto sessions = open_sessions(server, &pool, 20);
+
+    // handed out round-robin
+    std::vector<std::size_t> even{10, 10};
+    REQUIRE(pool.sessions() == even);
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 20; ++i) {
+            server.publish(i);
+        }
+        for (int i = 0; i < 20; ++i) {
+            REQUIRE(sessions[static_cast<std::size_t>(i)]->next_quote() == i);
+        }
+    }
+    for (const auto &s : sessions) {
+        REQUIRE(s->client->sequence_stats().gaps == 0);
+        REQUIRE(s->io->metrics().dropped_batches == 0);
+    }
+}
+
+TEST_CASE("session_pool drops a session's connection when it leaves",
+          "[session_pool]") {
+    pool_server server("pool-leave");
+    td365::session_pool pool(1);
+    auto sessions = open_sessions(server, &pool, 3);
+    auto leaving = server.conn(1);
+    REQUIRE(leaving->is_open());
+
+    sessions[1]->io.reset();
+    REQUIRE_FALSE(leaving->is_open());
+    REQUIRE(pool.sessions().front() == 2);
+
+    // the others carry on
+    server.publish(0);
+    server.publish(2);
+    REQUIRE(sessions[0]->next_quote() == 0);
+    REQUIRE(sessions[2]->next_quote() == 2);
+
+    // and see their own connection close
+    server.conn(0)->close();
+    auto evt = sessions[0]->io->wait(1s);
+    REQUIRE(std::holds_alternative<td365::connection_closed_event>(evt));
+}
+
+TEST_CASE("session_pool holds a full ring's events in its session",
+          "[session_pool]") {
+    pool_server server("pool-full");
+    td365::session_pool pool(1);
+    session slow(&pool, server.url(), 0, 2);
+    session other(&pool, server.url(), 1);
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (server.subscribed() < 2 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(server.subscribed() == 2);
+
+    // more errors than the slow consumer's ring holds
+    constexpr int count = 10;
+    for (int i = 0; i < count; ++i) {
+        slow.io->post([i](td365::ws_client &) {
+            throw std::runtime_error(std::to_string(i));
+        });
+    }
+
+    // the pool thread doesn't wait for it to catch up
+    server.publish(1);
+    REQUIRE(other.next_quote() == 1);
+
+    // and it loses none of them, nor their order
+    for (int i = 0; i < count; ++i) {
+        auto evt = slow.io->wait(1s);
+        auto *err = std::get_if<td365::error_event>(&evt);
+        REQUIRE(err);
+        REQUIRE(err->message == std::to_string(i));
+    }
+    REQUIRE(slow.io->running());
+}
+
+TEST_CASE("session_pool only takes clients made on its contexts",
+          "[session_pool]") {
+    REQUIRE_THROWS(td365::session_pool(0));
+
+    td365::session_pool pool(1);
+    td365::ws_client own;
+    REQUIRE_THROWS(td365::io_thread(own, pool, 16));
+
+    td365::session_pool other(1);
+    td365::ws_client elsewhere(other.context());
+    REQUIRE_THROWS(td365::io_thread(elsewhere, pool, 16));
+}
+
+TEST_CASE("Benchmark session_pool", "[benchmark][session_pool]") {
+    constexpr int count = 200;
+
+    auto pooled = resident_per_session(count, true);
+    auto threaded = resident_per_session(count, false);
+    spdlog::info("resident memory per session: {} bytes pooled, {} bytes "
+                 "with a thread each",
+                 pooled, threaded);
+
+    pool_server server("pool-bench");
+    td365::session_pool pool(1);
+    auto sessions = open_sessions(server, &pool, count);
+
+    auto tick_all = [&] {
+        for (int i = 0; i < count; ++i) {
+            server.publish(i);
+        }
+        int seen = 0;
+        for (auto &s : sessions) {
+            seen += s->next_quote() >= 0;
+        }
+        return seen;
+    };
+
+    // CPU of the whole process, publisher and consumer included, so the
+    // sessions per core figure is a lower bound
+    constexpr int rounds = 100;
+    auto cpu_start = process_cpu_ns();
+    for (int r = 0; r < rounds; ++r) {
+        REQUIRE(tick_all() == count);
+    }
+    auto per_tick = (process_cpu_ns() - cpu_start) / (rounds * count);
+    constexpr double ticks_per_second = 50.0;
+    spdlog::info("{:.0f}ns CPU per session tick: {:.0f} sessions per core "
+                 "at {} ticks/s each",
+                 per_tick, 1e9 / (per_tick * ticks_per_second),
+                 ticks_per_second);
+
+    BENCHMARK("a tick to each of 200 sessions on one thread") {
+        return tick_all();
+    };
+}
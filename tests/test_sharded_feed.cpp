@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include "fake_memory_server.h"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <set>
+#include <string>
+#include <td365/memory_transport.h>
+#include <td365/sharded_feed.h>
+#include <thread>
+#include <variant>
+#include <vector>
+
+using nlohmann::json;
+using namespace std::chrono_literals;
+
+namespace {
+// Logs in any number of clients and keeps track of what each connection is
+// subscribed to. Handlers run on the shards' I/O threads, hence the lock.
+struct feed_server {
+    td365::memory_server server;
+    std::mutex mutex;
+    std::map<td365::memory_connection *,
+             std::shared_ptr<td365::memory_connection>>
+        conns;
+    std::map<td365::memory_connection *, std::set<int>> quotes;
+    std::map<int, int> seq;
+
+    explicit feed_server(std::string name) : server(std::move(name)) {
+        serve_login(
+            server,
+            [this](td365::memory_connection &c, const json &msg) {
+                std::lock_guard lock(mutex);
+                if (msg["action"] == "subscribe") {
+                    quotes[&c].insert(msg["quoteId"].get<int>());
+                } else if (msg["action"] == "unsubscribe") {
+                    quotes[&c].erase(msg["quoteId"].get<int>());
+                }
+            },
+            [this](td365::memory_connection &c) {
+                std::lock_guard lock(mutex);
+                conns[&c] = c.shared_from_this();
+                quotes[&c];
+            });
+    }
+
+    std::string url() const { return server.url(); }
+
+    // subscriptions over all connections
+    std::size_t subscribed() {
+        std::lock_guard lock(mutex);
+        std::size_t n = 0;
+        for (const auto &[c, ids] : quotes) {
+            n += ids.size();
+        }
+        return n;
+    }
+
+    // the connections subscribed to `quote_id`
+    std::vector<td365::memory_connection *> carrying(int quote_id) {
+        std::lock_guard lock(mutex);
+        std::vector<td365::memory_connection *> out;
+        for (const auto &[c, ids] : quotes) {
+            if (ids.contains(quote_id)) {
+                out.push_back(c);
+            }
+        }
+        return out;
+    }
+
+    // one tick of `quote_id` to each connection subscribed to it
+    void publish(int quote_id) {
+        std::lock_guard lock(mutex);
+        auto frame = price_frame(quote_id, seq[quote_id]++);
+        for (const auto &[c, ids] : quotes) {
+            if (ids.contains(quote_id)) {
+                conns[c]->send(frame);
+            }
+        }
+    }
+
+    void close_all() {
+        std::lock_guard lock(mutex);
+        for (auto &[p, c] : conns) {
+            c->close();
+        }
+    }
+};
+
+template <typename F> bool eventually(F &&done) {
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+std::unique_ptr<td365::sharded_feed> open_feed(feed_server &server,
+                                               std::size_t shards,
+                                               td365::shard_policy policy) {
+    td365::sharded_feed_options opts;
+    opts.shards = shards;
+    opts.policy = policy;
+    auto feed = std::make_unique<td365::sharded_feed>(opts);
+
+    td365::reconnect_options no_reconnect;
+    no_reconnect.enabled = false;
+    for (std::size_t i = 0; i < shards; ++i) {
+        feed->client(i).set_reconnect_options(no_reconnect);
+    }
+    feed->connect(boost::urls::url(server.url()), "login", "token");
+    return feed;
+}
+
+// quote id -> shard it arrived on, for `count` ticks
+std::vector<std::pair<int, std::size_t>>
+read_ticks(td365::sharded_feed &feed, std::size_t count) {
+    std::vector<std::pair<int, std::size_t>> seen;
+    while (seen.size() < count) {
+        auto evt = feed.wait(1s);
+        auto *batch = std::get_if<td365::tick_batch_event>(&evt);
+        if (!batch) {
+            FAIL("expected ticks");
+        }
+        for (const auto &t : batch->data) {
+            seen.emplace_back(t.quote_id, feed.shard());
+        }
+    }
+    return seen;
+}
+} // namespace
+
+TEST_CASE("sharded_feed spreads quotes over its connections",
+          "[sharded_feed]") {
+    feed_server server("sharded-spread");
+    auto feed = open_feed(server, 4, td365::shard_policy::hash);
+    REQUIRE(server.server.connections() == 4);
+
+    std::vector<int> ids(200);
+    std::iota(ids.begin(), ids.end(), 1000);
+    feed->subscribe(ids);
+    REQUIRE(eventually([&] { return server.subscribed() == ids.size(); }));
+
+    // every quote on exactly the connection of its shard, and every shard
+    // carrying some
+    auto metrics = feed->metrics();
+    REQUIRE(metrics.size() == 4);
+    std::map<std::size_t, td365::memory_connection *> conn_of_shard;
+    for (int id : ids) {
+        auto carriers = server.carrying(id);
+        REQUIRE(carriers.size() == 1);
+        auto shard = feed->shard_of(id);
+        REQUIRE(shard);
+        auto [it, fresh] = conn_of_shard.emplace(*shard, carriers[0]);
+        REQUIRE(it->second == carriers[0]);
+    }
+    REQUIRE(conn_of_shard.size() == 4);
+    for (const auto &m : metrics) {
+        REQUIRE(m.quotes > 0);
+    }
+
+    // the merged stream sees every tick, tagged with its shard
+    for (int id : ids) {
+        server.publish(id);
+    }
+    std::set<int> seen;
+    for (auto [id, shard] : read_ticks(*feed, ids.size())) {
+        REQUIRE(shard == feed->shard_of(id));
+        seen.insert(id);
+    }
+    REQUIRE(seen.size() == ids.size());
+
+    std::uint64_t ticks = 0;
+    for (const auto &m : feed->metrics()) {
+        ticks += m.ticks;
+        REQUIRE(m.sequence.gaps == 0);
+        REQUIRE(m.send.frames_sent > 0);
+    }
+    REQUIRE(ticks == ids.size());
+
+    feed->unsubscribe(std::span<const int>(ids).first(50));
+    REQUIRE(eventually([&] { return server.subscribed() == 150; }));
+    REQUIRE_FALSE(feed->shard_of(ids[0]));
+}
+
+TEST_CASE("sharded_feed rebalances by tick rate", "[sharded_feed]") {
+    feed_server server("sharded-rate");
+    auto feed = open_feed(server, 2, td365::shard_policy::rate);
+
+    // nothing has ticked yet, so new quotes alternate
+    std::vector<int> ids{1, 2, 3, 4};
+    feed->subscribe(ids);
+    REQUIRE(eventually([&] { return server.subscribed() == 4; }));
+    REQUIRE(feed->shard_of(1) == feed->shard_of(3));
+    REQUIRE(feed->shard_of(1) != feed->shard_of(2));
+
+    // both busy quotes on one connection
+    for (int i = 0; i < 100; ++i) {
+        server.publish(1);
+        server.publish(3);
+    }
+    read_ticks(*feed, 200);
+
+    REQUIRE(feed->rebalance() >= 1);
+    REQUIRE(feed->shard_of(1) != feed->shard_of(3));
+    // and the server follows; the old connection only drops a moved quote
+    // once the consumer sees its new one has subscribed, so it never goes
+    // unsubscribed in between
+    REQUIRE(eventually([&] {
+        (void)feed->try_pop();
+        REQUIRE(server.subscribed() >= 4);
+        return server.carrying(1).size() == 1 &&
+               server.carrying(3).size() == 1 &&
+               server.carrying(1) != server.carrying(3) &&
+               server.subscribed() == 4;
+    }));
+
+    // settled, nothing left to move
+    REQUIRE(feed->rebalance() == 0);
+}
+
+TEST_CASE("sharded_feed keeps a quote subscribed again mid-handover",
+          "[sharded_feed]") {
+    feed_server server("sharded-handover");
+    auto feed = open_feed(server, 2, td365::shard_policy::rate);
+
+    // 1 and 3 busy on shard 0
+    std::vector<int> ids{1, 2, 3, 4};
+    feed->subscribe(ids);
+    REQUIRE(eventually([&] { return server.subscribed() == 4; }));
+    REQUIRE(feed->shard_of(1) == 0u);
+    for (int i = 0; i < 100; ++i) {
+        server.publish(1);
+        server.publish(3);
+    }
+    read_ticks(*feed, 200);
+
+    // one of them moves to shard 1, and before the handover is done it is
+    // dropped and subscribed again, back onto the emptied shard 0
+    REQUIRE(feed->rebalance() >= 1);
+    int moved = feed->shard_of(1) == 1u ? 1 : 3;
+    REQUIRE(feed->shard_of(moved) == 1u);
+    feed->unsubscribe(ids);
+    feed->subscribe(moved);
+    REQUIRE(feed->shard_of(moved) == 0u);
+
+    // the handover's unsubscribe must not take it off shard 0 afterwards
+    auto until = std::chrono::steady_clock::now() + 200ms;
+    while (std::chrono::steady_clock::now() < until) {
+        (void)feed->try_pop();
+        std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(eventually([&] {
+        (void)feed->try_pop();
+        return server.carrying(moved).size() == 1 &&
+               server.subscribed() == 1;
+    }));
+}
+
+TEST_CASE("sharded_feed closes once every shard has", "[sharded_feed]") {
+    feed_server server("sharded-close");
+    auto feed = open_feed(server, 3, td365::shard_policy::hash);
+
+    server.close_all();
+    std::set<std::size_t> closed;
+    while (closed.size() < 3) {
+        auto evt = feed->wait(1s);
+        REQUIRE(std::holds_alternative<td365::connection_closed_event>(evt));
+        closed.insert(feed->shard());
+    }
+    REQUIRE(std::holds_alternative<td365::connection_closed_event>(
+        feed->wait(0ms)));
+}
+
+TEST_CASE("sharded_feed rejects bad use", "[sharded_feed]") {
+    td365::sharded_feed_options none;
+    none.shards = 0;
+    REQUIRE_THROWS(td365::sharded_feed(none));
+
+    td365::sharded_feed feed(td365::sharded_feed_options{});
+    REQUIRE_THROWS(feed.subscribe(1));
+    REQUIRE_THROWS(feed.client(4));
+}
+
+TEST_CASE("Benchmark sharded_feed", "[benchmark][sharded_feed]") {
+    constexpr int quotes = 100;
+    constexpr int rounds = 10;
+    std::vector<int> ids(quotes);
+    std::iota(ids.begin(), ids.end(), 1);
+
+    for (std::size_t shards : {1u, 4u}) {
+        feed_server server("sharded-bench-" + std::to_string(shards));
+        auto feed = open_feed(server, shards, td365::shard_policy::hash);
+        feed->subscribe(ids);
+        REQUIRE(eventually([&] { return server.subscribed() == quotes; }));
+
+        BENCHMARK("1000 ticks over " + std::to_string(shards) + " shards") {
+            for (int r = 0; r < rounds; ++r) {
+                for (int id : ids) {
+                    server.publish(id);
+                }
+            }
+            return read_ticks(*feed, quotes * rounds).size();
+        };
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdint>
+#include <td365/spsc_ring.h>
+#include <td365/wake_signal.h>
+#include <thread>
+
+TEST_CASE("spsc_ring fills, drains and tracks depth", "[spsc_ring]") {
+    td365::spsc_ring<int> ring(3);
+    REQUIRE(ring.capacity() == 4);
+    REQUIRE(ring.front() == nullptr);
+
+    for (int i = 0; i < 4; ++i) {
+        auto *s = ring.claim();
+        REQUIRE(s != nullptr);
+        *s = i;
+        ring.publish();
+    }
+    REQUIRE(ring.claim() == nullptr);
+    REQUIRE(ring.size() == 4);
+    REQUIRE(ring.high_water() == 4);
+
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(*ring.front() == i);
+        ring.pop();
+    }
+    REQUIRE(ring.front() == nullptr);
+    REQUIRE(ring.size() == 0);
+    REQUIRE(ring.high_water() == 4);
+}
+
+TEST_CASE("wake_signal wakes a consumer or times out", "[spsc_ring]") {
+    using namespace std::chrono_literals;
+    td365::wake_signal signal;
+
+    auto epoch = signal.epoch();
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE_FALSE(signal.wait_until(epoch, start + 20ms));
+    REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+
+    // a notify before the wait still counts
+    signal.notify();
+    REQUIRE(signal.wait_until(epoch, std::chrono::steady_clock::now() + 5s));
+
+    epoch = signal.epoch();
+    std::thread producer([&] {
+        std::this_thread::sleep_for(10ms);
+        signal.notify();
+    });
+    REQUIRE(signal.wait_until(epoch,
+                              std::chrono::steady_clock::time_point::max()));
+    producer.join();
+}
+
+TEST_CASE("Benchmark spsc_ring", "[benchmark]") {
+    td365::spsc_ring<std::uint64_t> ring(1024);
+
+    BENCHMARK("push + pop") {
+        *ring.claim() = 42;
+        ring.publish();
+        auto v = *ring.front();
+        ring.pop();
+        return v;
+    };
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include "fake_memory_server.h"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <ctime>
+#include <future>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <td365/io_thread.h>
+#include <td365/memory_transport.h>
+#include <td365/ws.h>
+#include <td365/ws_client.h>
+#include <thread>
+#include <variant>
+
+using nlohmann::json;
+using namespace std::chrono_literals;
+
+namespace {
+// Answers the handshake like fake_ws_server does, without sockets. Frames
+// without an action are echoed.
+struct fake_memory_server {
+    td365::memory_server server;
+    // the latest connection
+    std::shared_ptr<td365::memory_connection> conn;
+    int reconnect_requests = 0;
+    int subscribe_requests = 0;
+
+    explicit fake_memory_server(std::string name) : server(std::move(name)) {
+        serve_login(
+            server,
+            [this](td365::memory_connection &, const json &msg) {
+                if (msg["action"] == "reconnect") {
+                    ++reconnect_requests;
+                } else if (msg["action"] == "subscribe") {
+                    ++subscribe_requests;
+                }
+            },
+            [this](td365::memory_connection &c) {
+                conn = c.shared_from_this();
+            },
+            [](td365::memory_connection &c, std::string_view frame) {
+                c.send(std::string(frame));
+            });
+    }
+
+    std::string url() const { return server.url(); }
+};
+
+// connected and subscribed, with the subscription seen by the server
+void subscribe(td365::ws_client &client, fake_memory_server &server) {
+    client.connect(boost::urls::url(server.url()), "login", "token");
+    client.subscribe(870964);
+    while (server.subscribe_requests == 0) {
+        client.read_and_process_message(10ms);
+    }
+}
+
+// reads until `count` ticks arrived, returns their sequence numbers
+std::vector<int> read_ticks(td365::ws_client &client, std::size_t count) {
+    std::vector<int> seen;
+    while (seen.size() < count) {
+        auto evt = client.read_and_process_message(1s);
+        auto *batch = std::get_if<td365::tick_batch_event>(&evt);
+        if (!batch) {
+            FAIL("expected ticks");
+        }
+        for (const auto &t : batch->data) {
+            seen.push_back(t.field13);
+        }
+    }
+    return seen;
+}
+} // namespace
+
+TEST_CASE("ws echoes frames over memory_transport", "[transport]") {
+    fake_memory_server server("transport-echo");
+    td365::ws w;
+    w.connect(boost::urls::url(server.url()));
+    REQUIRE(server.server.connections() == 1);
+
+    auto [ec, connect_response] = w.read_message(1s);
+    REQUIRE_FALSE(ec);
+    REQUIRE(json::parse(connect_response)["t"] == "connectResponse");
+
+    constexpr int count = 100;
+    for (int i = 0; i < count; ++i) {
+        w.send(json{{"n", i}}.dump());
+    }
+    for (int i = 0; i < count; ++i) {
+        auto [read_ec, buf] = w.read_message(1s);
+        REQUIRE_FALSE(read_ec);
+        REQUIRE(json::parse(buf)["n"] == i);
+    }
+    REQUIRE(w.metrics().frames_sent == count);
+
+    // nothing more to read
+    auto [timeout_ec, empty] = w.read_message(0ms);
+    REQUIRE(timeout_ec == boost::beast::error::timeout);
+
+    w.close();
+    REQUIRE(server.server.connections() == 0);
+    REQUIRE_FALSE(server.conn->is_open());
+}
+
+TEST_CASE("memory_transport refuses unknown servers", "[transport]") {
+    td365::ws w;
+    REQUIRE_THROWS(w.connect(boost::urls::url("memory://nobody")));
+}
+
+TEST_CASE("ws_client decodes prices over memory_transport", "[transport]") {
+    fake_memory_server server("transport-prices");
+    td365::ws_client client;
+    subscribe(client, server);
+
+    for (int i = 0; i < 50; ++i) {
+        server.conn->send(price_frame(870964, i));
+    }
+    auto seen = read_ticks(client, 50);
+    for (int i = 0; i < 50; ++i) {
+        REQUIRE(seen[static_cast<std::size_t>(i)] == i);
+    }
+    REQUIRE(client.sequence_stats().gaps == 0);
+
+    // a close from the server is the end of the session
+    td365::reconnect_options no_reconnect;
+    no_reconnect.enabled = false;
+    client.set_reconnect_options(no_reconnect);
+    server.conn->close();
+    auto evt = client.read_and_process_message(1s);
+    REQUIRE(std::holds_alternative<td365::connection_closed_event>(evt));
+}
+
+TEST_CASE("ws_client reconnects over memory_transport", "[transport]") {
+    fake_memory_server server("transport-reconnect");
+    td365::ws_client client;
+    td365::reconnect_options fast;
+    fast.initial_delay = 1ms;
+    client.set_reconnect_options(fast);
+    subscribe(client, server);
+    auto first = server.conn;
+
+    first->drop();
+    bool reconnected = false;
+    while (!reconnected) {
+        auto evt = client.read_and_process_message(1s);
+        REQUIRE_FALSE(
+            std::holds_alternative<td365::connection_closed_event>(evt));
+        reconnected = std::holds_alternative<td365::reconnected_event>(evt);
+    }
+    REQUIRE(server.conn != first);
+    REQUIRE(server.server.connections() == 1);
+
+    // the new connection names the old one and gets the subscription back
+    while (server.subscribe_requests < 2) {
+        client.read_and_process_message(10ms);
+    }
+    REQUIRE(server.reconnect_requests == 1);
+    server.conn->send(price_frame(870964, 0));
+    REQUIRE(read_ticks(client, 1).size() == 1);
+}
+
+TEST_CASE("io_thread reports a command that throws", "[transport]") {
+    fake_memory_server server("transport-command");
+    td365::ws_client client;
+    subscribe(client, server);
+    td365::io_thread io(client, 16);
+
+    io.post([](td365::ws_client &c) {
+        td365::compression_options bad;
+        bad.mem_level = 0;
+        c.set_compression(bad);
+    });
+    auto evt = io.wait(1s);
+    REQUIRE(std::holds_alternative<td365::error_event>(evt));
+    REQUIRE(io.running());
+
+    // and carries on reading
+    server.conn->send(price_frame(870964, 0));
+    REQUIRE(std::holds_alternative<td365::tick_batch_event>(io.wait(1s)));
+}
+
+TEST_CASE("io_thread waits for a connect posted after it starts",
+          "[transport]") {
+    fake_memory_server server("transport-late-connect");
+    td365::ws_client client;
+    td365::io_thread io(client, 16);
+
+    // nothing to read yet, and no spinning while there isn't
+    auto cpu_start = std::clock();
+    std::this_thread::sleep_for(200ms);
+    auto cpu = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    REQUIRE(cpu < 0.1);
+
+    std::promise<void> connected;
+    io.post([&](td365::ws_client &c) {
+        c.connect(boost::urls::url(server.url()), "login", "token");
+        connected.set_value();
+    });
+    connected.get_future().get();
+    server.conn->send(price_frame(870964, 0));
+    REQUIRE(std::holds_alternative<td365::tick_batch_event>(io.wait(1s)));
+}
+
+TEST_CASE("io_thread hands on exact prices in fixed mode", "[transport]") {
+    fake_memory_server server("transport-fixed");
+    td365::ws_client client;
+    client.set_price_mode(td365::price_mode::fixed);
+    subscribe(client, server);
+    td365::io_thread io(client, 16);
+
+    server.conn->send(price_frame(870964, 0));
+    auto evt = io.wait(1s);
+    auto *batch = std::get_if<td365::tick_batch_event>(&evt);
+    REQUIRE(batch);
+    REQUIRE(batch->exact.size() == batch->data.size());
+    REQUIRE(batch->exact[0].bid == td365::fixed_price{10485050, 2});
+    REQUIRE(batch->exact[0].bid.to_double() == batch->data[0].bid);
+
+    // and nothing of the sort by default
+    td365::ws_client floating;
+    subscribe(floating, server);
+    server.conn->send(price_frame(870964, 1));
+    auto floating_evt = floating.read_and_process_message(1s);
+    batch = std::get_if<td365::tick_batch_event>(&floating_evt);
+    REQUIRE(batch);
+    REQUIRE(batch->exact.empty());
+}
+
+TEST_CASE("Benchmark ws_client over memory_transport",
+          "[benchmark][transport]") {
+    fake_memory_server server("transport-bench");
+    td365::ws_client client;
+    subscribe(client, server);
+
+    constexpr int count = 1000;
+    std::vector<std::string> frames;
+    for (int i = 0; i < count; ++i) {
+        frames.push_back(price_frame(870964, i));
+    }
+
+    BENCHMARK("decode 1000 price frames") {
+        for (const auto &f : frames) {
+            server.conn->send(f);
+        }
+        return read_ticks(client, count).size();
+    };
+}
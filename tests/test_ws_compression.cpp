@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include "fake_ws_server.h"
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/url.hpp>
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <string>
+#include <td365/ws.h>
+#include <td365/ws_client.h>
+#include <thread>
+
+namespace {
+// a fake server on its own thread for the lifetime of the object
+struct server_thread {
+    net::io_context ioc;
+    fake_ws_server server{ioc, 0};
+    std::atomic<bool> shutdown = false;
+    std::thread thread;
+
+    explicit server_thread(bool deflate) {
+        server.set_permessage_deflate(deflate);
+        boost::asio::co_spawn(
+            ioc,
+            [this]() -> boost::asio::awaitable<void> {
+                co_await server.run(shutdown);
+            },
+            boost::asio::detached);
+        thread = std::thread([this] { ioc.run(); });
+    }
+
+    ~server_thread() {
+        shutdown = true;
+        ioc.stop();
+        thread.join();
+    }
+
+    boost::urls::url url() const {
+        return boost::urls::url("ws://127.0.0.1:" +
+                                std::to_string(server.get_port()));
+    }
+};
+
+// A frame of `n` prices, the way the feed batches them
+std::string price_batch(int n) {
+    std::string prices;
+    for (int i = 0; i < n; ++i) {
+        prices += std::string(i ? "," : "") +
+                  R"("870964,104850.50,104910.50,-1147.00,d,1,)"
+                  R"(106498.50,102786.50,)"
+                  R"(O+E4W55s4o+2dEv3T2kaaz+lkLwePRX97aJOsVcIe6c=,)"
+                  R"(0,104880.50,638854057031360000,)" +
+                  std::to_string(i) + "\"";
+    }
+    return R"({"t":"p","d":{"sp":[)" + prices + "]}}";
+}
+
+td365::compression_options compressed() {
+    td365::compression_options opts;
+    opts.enabled = true;
+    return opts;
+}
+
+// subscribe and read `count` streamed prices
+td365::compression_metrics stream_prices(server_thread &st,
+                                         const td365::compression_options &opts,
+                                         std::size_t count) {
+    st.server.set_price_stream(count, std::chrono::microseconds(100));
+    td365::ws_client client;
+    client.set_compression(opts);
+    client.connect(st.url(), "login", "token");
+    client.subscribe(870964);
+
+    std::size_t received = 0;
+    auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (received < count && std::chrono::steady_clock::now() < give_up) {
+        auto evt =
+            client.read_and_process_message(std::chrono::milliseconds(100));
+        if (auto *batch = std::get_if<td365::tick_batch_event>(&evt)) {
+            received += batch->data.size();
+        }
+    }
+    REQUIRE(received == count);
+    return client.compression_stats();
+}
+} // namespace
+
+TEST_CASE("ws_client negotiates permessage-deflate", "[websocket][deflate]") {
+    server_thread st(true);
+    auto m = stream_prices(st, compressed(), 200);
+
+    REQUIRE(m.negotiated);
+    // connect and auth responses plus the prices
+    REQUIRE(m.messages >= 200);
+    // beast's server flushes its window after each message, so a lone
+    // price only shrinks a little
+    REQUIRE(m.payload_bytes > m.wire_bytes);
+    REQUIRE(m.inflate_cpu > std::chrono::nanoseconds::zero());
+}
+
+TEST_CASE("Batched prices compress several times over",
+          "[websocket][deflate]") {
+    server_thread st(true);
+    td365::ws w;
+    w.set_compression(compressed());
+    w.connect(st.url());
+    w.read_message(std::chrono::seconds(1));
+
+    // the fake server echoes frames it doesn't understand
+    auto batch = price_batch(50);
+    for (int i = 0; i < 10; ++i) {
+        w.send(batch);
+        auto [ec, buf] = w.read_message(std::chrono::seconds(1));
+        REQUIRE_FALSE(ec);
+        REQUIRE(buf == batch);
+    }
+
+    auto m = w.compression_stats();
+    REQUIRE(m.negotiated);
+    REQUIRE(m.payload_bytes > 5 * m.wire_bytes);
+}
+
+TEST_CASE("Compression is opt-in and may be declined",
+          "[websocket][deflate]") {
+    SECTION("not asked for") {
+        server_thread st(true);
+        auto m = stream_prices(st, {}, 50);
+        REQUIRE_FALSE(m.negotiated);
+        REQUIRE(m.wire_bytes > m.payload_bytes);
+        REQUIRE(m.inflate_cpu == std::chrono::nanoseconds::zero());
+    }
+    SECTION("declined by the server") {
+        server_thread st(false);
+        auto m = stream_prices(st, compressed(), 50);
+        REQUIRE_FALSE(m.negotiated);
+        REQUIRE(m.wire_bytes > m.payload_bytes);
+    }
+}
+
+TEST_CASE("set_compression rejects bad parameters", "[websocket][deflate]") {
+    td365::ws_client client;
+    auto opts = compressed();
+    opts.server_max_window_bits = 8;
+    REQUIRE_THROWS(client.set_compression(opts));
+    opts = compressed();
+    opts.mem_level = 0;
+    REQUIRE_THROWS(client.set_compression(opts));
+    // what td365 checks before posting to the I/O thread
+    REQUIRE_THROWS(td365::check_compression_options(opts));
+    REQUIRE_NOTHROW(td365::check_compression_options(compressed()));
+}
+
+TEST_CASE("Benchmark price batch round trip with permessage-deflate",
+          "[benchmark][websocket][deflate]") {
+    const auto batch = price_batch(20);
+
+    // the fake server echoes frames it doesn't understand
+    auto round_trip = [&batch](td365::ws &w) {
+        w.send(batch);
+        auto [ec, buf] = w.read_message(std::chrono::seconds(1));
+        return buf.size();
+    };
+
+    // the fake server handles one connection at a time
+    server_thread plain_server(true);
+    td365::ws plain;
+    plain.connect(plain_server.url());
+    plain.read_message(std::chrono::seconds(1));
+
+    server_thread deflate_server(true);
+    td365::ws deflated;
+    deflated.set_compression(compressed());
+    deflated.connect(deflate_server.url());
+    deflated.read_message(std::chrono::seconds(1));
+
+    BENCHMARK("round trip uncompressed") { return round_trip(plain); };
+    BENCHMARK("round trip compressed") { return round_trip(deflated); };
+}
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2025, Matt Wlazlo
+ *
+ * This file is part of the td365 project.
+ * Use in compliance with the Prosperity Public License 3.0.0.
+ */
+
+#include "fake_ws_server.h"
+
+#include <algorithm>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/url.hpp>
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <td365/conflator.h>
+#include <td365/io_thread.h>
+#include <td365/ws_client.h>
+#include <thread>
+#include <vector>
+
+namespace {
+struct latency_stats {
+    std::chrono::nanoseconds median;
+    std::chrono::nanoseconds p99;
+    std::size_t received;
+};
+
+// Stream `count` prices from a local fake server and measure the time from
+// the server's write to the tick coming out of read_and_process_message.
+latency_stats measure_delivery(bool spin, std::size_t count) {
+    net::io_context server_ioc;
+    fake_ws_server server(server_ioc, 0);
+    server.set_price_stream(count, std::chrono::microseconds(200));
+
+    std::atomic<bool> shutdown = false;
+    boost::asio::co_spawn(
+        server_ioc,
+        [&]() -> boost::asio::awaitable<void> {
+            co_await server.run(shutdown);
+        },
+        boost::asio::detached);
+    std::thread server_thread([&server_ioc] { server_ioc.run(); });
+
+    std::vector<std::chrono::steady_clock::time_point> received_at(count);
+    std::size_t received = 0;
+    {
+        td365::ws_client client;
+        client.connect(boost::urls::url("ws://127.0.0.1:" +
+                                        std::to_string(server.get_port())),
+                       "login", "token");
+        if (spin) {
+            client.set_spin_mode({});
+        }
+        client.subscribe(870964);
+
+        auto give_up =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (received < count &&
+               std::chrono::steady_clock::now() < give_up) {
+            auto evt = client.read_and_process_message(
+                std::chrono::milliseconds(100));
+            auto now = std::chrono::steady_clock::now();
+            if (auto *batch = std::get_if<td365::tick_batch_event>(&evt)) {
+                for (const auto &t : batch->data) {
+                    received_at[static_cast<std::size_t>(t.field13)] = now;
+                    ++received;
+                }
+            }
+        }
+    }
+
+    shutdown = true;
+    server_ioc.stop();
+    server_thread.join();
+
+    std::vector<std::chrono::nanoseconds> samples;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (received_at[i] != std::chrono::steady_clock::time_point{}) {
+            samples.push_back(received_at[i] - server.sent_at()[i]);
+        }
+    }
+    std::ranges::sort(samples);
+    if (samples.empty()) {
+        return {{}, {}, 0};
+    }
+    return {samples[samples.size() / 2], samples[samples.size() * 99 / 100],
+            received};
+}
+
+// Read until the client has written `frames` frames in total
+bool wait_for_sent(td365::ws_client &client, std::uint64_t frames) {
+    auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (client.write_metrics().frames_sent < frames) {
+        if (std::chrono::steady_clock::now() >= give_up) {
+            return false;
+        }
+        client.read_and_process_message(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+} // namespace
+
+TEST_CASE("Benchmark tick delivery latency", "[benchmark][websocket]") {
+    constexpr std::size_t count = 2000;
+
+    auto blocking = measure_delivery(false, count);
+    auto spinning = measure_delivery(true, count);
+
+    REQUIRE(blocking.received == count);
+    REQUIRE(spinning.received == count);
+
+    spdlog::info("blocking: median {}ns p99 {}ns", blocking.median.count(),
+                 blocking.p99.count());
+    spdlog::info("spin:     median {}ns p99 {}ns", spinning.median.count(),
+                 spinning.p99.count());
+}
+
+TEST_CASE("Benchmark subscribing 1000 quotes", "[benchmark][websocket]") {
+    net::io_context server_ioc;
+    fake_ws_server server(server_ioc, 0);
+    std::atomic<bool> shutdown = false;
+    boost::asio::co_spawn(
+        server_ioc,
+        [&]() -> boost::asio::awaitable<void> {
+            co_await server.run(shutdown);
+        },
+        boost::asio::detached);
+    std::thread server_thread([&server_ioc] { server_ioc.run(); });
+
+    {
+        td365::ws_client client;
+        client.connect(boost::urls::url("ws://127.0.0.1:" +
+                                        std::to_string(server.get_port())),
+                       "login", "token");
+        // authentication + account options
+        REQUIRE(wait_for_sent(client, 2));
+
+        std::vector<int> quotes(1000);
+        std::iota(quotes.begin(), quotes.end(), 1);
+
+        auto start = std::chrono::steady_clock::now();
+        client.set_subscriptions(quotes);
+        REQUIRE(wait_for_sent(client, 1002));
+        auto initial = std::chrono::steady_clock::now() - start;
+
+        // swap 100 quotes out: only the difference goes on the wire
+        std::iota(quotes.begin() + 900, quotes.end(), 5000);
+        start = std::chrono::steady_clock::now();
+        client.set_subscriptions(quotes);
+        REQUIRE(wait_for_sent(client, 1202));
+        auto diff = std::chrono::steady_clock::now() - start;
+
+        REQUIRE(client.subscriptions().size() == 1000);
+        REQUIRE(client.subscriptions().contains(5099));
+        REQUIRE_FALSE(client.subscriptions().contains(1000));
+
+        // nothing changed, nothing sent
+        client.set_subscriptions(quotes);
+        client.read_and_process_message(std::chrono::milliseconds(20));
+        REQUIRE(client.write_metrics().frames_sent == 1202);
+
+        spdlog::info("subscribe 1000 quotes: {}us, reconcile 100 changes: {}us",
+                     std::chrono::duration_cast<std::chrono::microseconds>(
+                         initial)
+                         .count(),
+                     std::chrono::duration_cast<std::chrono::microseconds>(diff)
+                         .count());
+    }
+
+    shutdown = true;
+    server_ioc.stop();
+    server_thread.join();
+}
+
+TEST_CASE("Conflation keeps a slow consumer on the newest price",
+          "[websocket][conflator]") {
+    constexpr int count = 500;
+
+    net::io_context server_ioc;
+    fake_ws_server server(server_ioc, 0);
+    server.set_price_stream(count, std::chrono::microseconds(100));
+    std::atomic<bool> shutdown = false;
+    boost::asio::co_spawn(
+        server_ioc,
+        [&]() -> boost::asio::awaitable<void> {
+            co_await server.run(shutdown);
+        },
+        boost::asio::detached);
+    std::thread server_thread([&server_ioc] { server_ioc.run(); });
+
+    td365::conflator conflate;
+    {
+        td365::ws_client client;
+        client.connect(boost::urls::url("ws://127.0.0.1:" +
+                                        std::to_string(server.get_port())),
+                       "login", "token");
+        client.subscribe(870964);
+        td365::io_thread io(client, 64, {}, &conflate);
+
+        int last = -1;
+        std::size_t batches = 0;
+        auto give_up =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (last != count - 1 &&
+               std::chrono::steady_clock::now() < give_up) {
+            auto evt = io.wait(std::chrono::milliseconds(100));
+            if (auto *batch = std::get_if<td365::tick_batch_event>(&evt)) {
+                REQUIRE(batch->data.size() == 1);
+                REQUIRE(batch->data[0].field13 > last);
+                last = batch->data[0].field13;
+                ++batches;
+                // far slower than the feed
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        }
+        REQUIRE(last == count - 1);
+        REQUIRE(batches < static_cast<std::size_t>(count));
+
+        auto m = conflate.metrics();
+        REQUIRE(m.updates == static_cast<std::uint64_t>(count));
+        REQUIRE(m.dropped > 0);
+        REQUIRE(m.delivered + m.dropped == m.updates);
+        spdlog::info("slow consumer: {} of {} ticks delivered, {} conflated",
+                     m.delivered, m.updates, m.dropped);
+    }
+
+    shutdown = true;
+    server_ioc.stop();
+    server_thread.join();
+}
+
+TEST_CASE("Kernel receive timestamps are attached to tick batches",
+          "[websocket][latency]") {
+    constexpr int count = 20;
+
+    net::io_context server_ioc;
+    fake_ws_server server(server_ioc, 0);
+    server.set_price_stream(count, std::chrono::microseconds(500));
+    std::atomic<bool> shutdown = false;
+    boost::asio::co_spawn(
+        server_ioc,
+        [&]() -> boost::asio::awaitable<void> {
+            co_await server.run(shutdown);
+        },
+        boost::asio::detached);
+    std::thread server_thread([&server_ioc] { server_ioc.run(); });
+
+    td365::latency_recorder recorder;
+    {
+        td365::ws_client client;
+        client.set_rx_timestamps(td365::rx_timestamping::software);
+        client.set_latency_recorder(&recorder);
+        client.connect(boost::urls::url("ws://127.0.0.1:" +
+                                        std::to_string(server.get_port())),
+                       "login", "token");
+        client.subscribe(870964);
+
+        int stamped = 0;
+        int batches = 0;
+        auto give_up =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (batches < count && std::chrono::steady_clock::now() < give_up) {
+            auto evt =
+                client.read_and_process_message(std::chrono::milliseconds(100));
+            if (auto *batch = std::get_if<td365::tick_batch_event>(&evt)) {
+                ++batches;
+                if (batch->received) {
+                    // taken before we got round to reading the frame
+                    auto now = std::chrono::system_clock::now();
+                    REQUIRE(*batch->received <= now);
+                    REQUIRE(*batch->received > now - std::chrono::seconds(10));
+                    ++stamped;
+                }
+            }
+        }
+        REQUIRE(batches == count);
+        REQUIRE(stamped == batches);
+
+        auto wire = recorder.snapshot(td365::latency_stage::wire_to_receive);
+        REQUIRE(wire.count == static_cast<std::uint64_t>(stamped));
+        REQUIRE(recorder.snapshot(td365::latency_stage::server_to_wire).count >=
+                wire.count);
+        spdlog::info("wire to receive: {}", wire.summary());
+    }
+
+    shutdown = true;
+    server_ioc.stop();
+    server_thread.join();
+}
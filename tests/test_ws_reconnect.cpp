@@ -5,6 +5,8 @@
  * Use in compliance with the Prosperity Public License 3.0.0.
  */
 
+#include "fake_ws_server.h"
+
 #include <atomic>
 #include <boost/asio.hpp>
 #include <boost/asio/co_spawn.hpp>
@@ -25,291 +27,179 @@
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 #include <td365/types.h>
+#include <td365/ws.h>
 #include <td365/ws_client.h>
 #include <thread>
 
-namespace beast = boost::beast;
-namespace http = beast::http;
-namespace websocket = beast::websocket;
-namespace net = boost::asio;
-using tcp = net::ip::tcp;
-using nlohmann::json;
-
-// Fake WebSocket server for testing
-class fake_ws_server {
-  public:
-    fake_ws_server(net::io_context &ioc, unsigned short port)
-        : ioc_(ioc), acceptor_(ioc, tcp::endpoint(tcp::v4(), port)) {
-        // Get the actual port number assigned by the system
-        port_ = acceptor_.local_endpoint().port();
-    }
-
-    boost::asio::awaitable<void> run(std::atomic<bool> &shutdown) {
-        while (!shutdown.load()) {
-            try {
-                tcp::socket socket =
-                    co_await acceptor_.async_accept(boost::asio::use_awaitable);
-
-                // Handle WebSocket connection
-                co_await handle_websocket_connection(std::move(socket),
-                                                     shutdown);
-            } catch (const std::exception &e) {
-                if (!shutdown.load()) {
-                    // Only log if not shutting down
-                    spdlog::debug("Server accept error: {}", e.what());
-                }
-                break;
-            }
-        }
-    }
-
-    void set_disconnect_after_connect(bool disconnect) {
-        disconnect_after_connect_ = disconnect;
-    }
-
-    void set_disconnect_delay(std::chrono::milliseconds delay) {
-        disconnect_delay_ = delay;
-    }
-
-    int get_connection_count() const { return connection_count_.load(); }
-
-    unsigned short get_port() const { return port_; }
-
-  private:
-    boost::asio::awaitable<void>
-    handle_websocket_connection(tcp::socket socket,
-                                std::atomic<bool> &shutdown) {
-        try {
-            websocket::stream<tcp::socket> ws(std::move(socket));
-
-            // Accept the WebSocket handshake
-            co_await ws.async_accept(boost::asio::use_awaitable);
-
-            connection_count_++;
-
-            json j = {{"t", "connectResponse"}};
-            co_await ws.async_write(
-                net::buffer(j.dump().c_str(), j.dump().size() + 1),
-                boost::asio::use_awaitable);
-
-            if (disconnect_after_connect_) {
-                // Wait for specified delay then disconnect
-                net::steady_timer timer(ioc_);
-                timer.expires_after(disconnect_delay_);
-                co_await timer.async_wait(boost::asio::use_awaitable);
-
-                // Close the connection
-                co_await ws.async_close(websocket::close_code::normal,
-                                        boost::asio::use_awaitable);
-            } else {
-                // Stay connected and handle messages
-                while (!shutdown.load()) {
-                    try {
-                        beast::flat_buffer buffer;
-                        co_await ws.async_read(buffer,
-                                               boost::asio::use_awaitable);
-
-                        // Echo back any received message
-                        co_await ws.async_write(buffer.data(),
-                                                boost::asio::use_awaitable);
-
-                    } catch (const std::exception &) {
-                        // Connection closed by client
-                        break;
-                    }
-                }
-            }
-        } catch (const std::exception &e) {
-            spdlog::debug("WebSocket connection error: {}", e.what());
-        }
-    }
-
-    net::io_context &ioc_;
-    tcp::acceptor acceptor_;
-    unsigned short port_;
-    std::atomic<bool> disconnect_after_connect_ = false;
-    std::chrono::milliseconds disconnect_delay_ =
-        std::chrono::milliseconds(1000);
-    std::atomic<int> connection_count_ = 0;
-};
-
-// NOTE: This test is disabled because it tests the old coroutine-based API.
-// Reconnection logic will need to be reimplemented for the new synchronous API.
-// TODO: Reimplement this test using the new synchronous API
-#if 0
-TEST_CASE("WebSocket client reconnection test - non-existent server",
-          "[websocket][reconnect][none]") {
-    // Create client with callbacks
-    td365::user_callbacks callbacks;
-    std::atomic<bool> connection_failed = false;
-
-    callbacks.tick_cb = [](td365::tick &&) {
-        // Do nothing - just a placeholder
-    };
-
-    // Create io_context for the client
-    net::io_context client_ioc;
+TEST_CASE("ws queues sends without blocking the reader",
+          "[websocket][send_queue]") {
+    net::io_context server_ioc;
+    fake_ws_server server(server_ioc, 0);
     std::atomic<bool> shutdown = false;
-
-    // Test connection with reconnection logic to a non-existent server
-    std::atomic<bool> coroutine_done = false;
-
-    // Create client on heap to ensure proper lifetime management
-    auto client = std::make_unique<td365::ws_client>(callbacks);
-
     boost::asio::co_spawn(
-        client_ioc,
+        server_ioc,
         [&]() -> boost::asio::awaitable<void> {
-            try {
-                // Try to connect to a non-existent server - this should fail
-                // and trigger reconnection
-                boost::urls::url url("wss://localhost:9999");
-                co_await client->run(url, "test_login", "test_token", shutdown);
-
-            } catch (const std::exception &e) {
-                connection_failed = true;
-                // This is expected when max reconnection attempts are reached
-            }
-            coroutine_done = true;
-            co_return;
+            co_await server.run(shutdown);
         },
         boost::asio::detached);
+    std::thread server_thread([&server_ioc] { server_ioc.run(); });
+
+    constexpr int count = 200;
+    {
+        td365::ws w;
+        w.connect(boost::urls::url("ws://127.0.0.1:" +
+                                   std::to_string(server.get_port())));
+        auto [ec, connect_response] = w.read_message(std::chrono::seconds(5));
+        REQUIRE_FALSE(ec);
+
+        // nothing runs the connection inside send(), so everything queues
+        for (int i = 0; i < count; ++i) {
+            w.send(json{{"n", i}}.dump());
+        }
+        REQUIRE(w.metrics().queue_depth == count);
 
-    // Run client in separate thread
-    std::thread client_thread([&client_ioc]() { client_ioc.run(); });
-
-    // Wait for reconnection attempts to be exhausted (5 attempts with
-    // exponential backoff) 1000ms + 2000ms + 3000ms + 4000ms = 10 seconds +
-    // some buffer
-    std::this_thread::sleep_for(std::chrono::seconds(12));
-
-    // Stop everything
-    shutdown = true;
-
-    // Wait for coroutine to complete
-    while (!coroutine_done) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
-
-    // Give some time for cleanup before stopping the context
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-    client_ioc.stop();
+        // the fake server echoes each frame; reading drives the writes
+        for (int i = 0; i < count; ++i) {
+            auto [read_ec, buf] = w.read_message(std::chrono::seconds(5));
+            REQUIRE_FALSE(read_ec);
+            REQUIRE(json::parse(buf)["n"] == i);
+        }
 
-    if (client_thread.joinable()) {
-        client_thread.join();
+        auto m = w.metrics();
+        REQUIRE(m.queue_depth == 0);
+        REQUIRE(m.high_water == count);
+        REQUIRE(m.frames_sent == count);
+        REQUIRE(m.max_latency > std::chrono::nanoseconds::zero());
+        REQUIRE(m.total_latency >= m.max_latency);
     }
 
-    // Now it's safe to destroy the client
-    client.reset();
-
-    // Verify that connection failed as expected and reconnection was attempted
-    REQUIRE(connection_failed == true);
+    shutdown = true;
+    server_ioc.stop();
+    server_thread.join();
 }
-#endif
 
-// NOTE: This test is disabled because it tests the old coroutine-based API.
-// Reconnection logic will need to be reimplemented for the new synchronous API.
-// TODO: Reimplement this test using the new synchronous API
-#if 0
-TEST_CASE("WebSocket client reconnection test - server disconnects",
+TEST_CASE("ws_client reconnects after the server drops the connection",
           "[websocket][reconnect][fake]") {
-    // Create server and client io_contexts
     net::io_context server_ioc;
-    net::io_context client_ioc;
-
-    // Create fake server that will disconnect after connection
-    fake_ws_server server(server_ioc, 0); // Use port 0 to let system assign
+    fake_ws_server server(server_ioc, 0);
     server.set_disconnect_after_connect(true);
-    server.set_disconnect_delay(std::chrono::milliseconds(500));
-
-    std::atomic<bool> server_shutdown = false;
-    std::atomic<bool> client_shutdown = false;
-
-    // Start server
+    server.set_disconnect_delay(std::chrono::milliseconds(300));
+    server.set_price_stream(5, std::chrono::microseconds(1000));
+    std::atomic<bool> shutdown = false;
     boost::asio::co_spawn(
         server_ioc,
         [&]() -> boost::asio::awaitable<void> {
-            co_await server.run(server_shutdown);
+            co_await server.run(shutdown);
         },
         boost::asio::detached);
+    std::thread server_thread([&server_ioc] { server_ioc.run(); });
+
+    {
+        td365::ws_client client;
+        client.set_reconnect_options({
+            .initial_delay = std::chrono::milliseconds(20),
+            .max_delay = std::chrono::milliseconds(100),
+        });
+        client.connect(boost::urls::url("ws://127.0.0.1:" +
+                                        std::to_string(server.get_port())),
+                       "login", "token");
+        client.subscribe(870964);
+
+        // ride out two drops and wait for prices on the third connection
+        int reconnected = 0;
+        std::size_t ticks_since_reconnect = 0;
+        auto give_up =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while ((reconnected < 2 || ticks_since_reconnect == 0) &&
+               std::chrono::steady_clock::now() < give_up) {
+            auto evt =
+                client.read_and_process_message(std::chrono::milliseconds(100));
+            if (auto *r = std::get_if<td365::reconnected_event>(&evt)) {
+                REQUIRE(r->attempts >= 1);
+                REQUIRE(r->downtime > std::chrono::nanoseconds::zero());
+                ++reconnected;
+                ticks_since_reconnect = 0;
+            } else if (auto *b = std::get_if<td365::tick_batch_event>(&evt)) {
+                ticks_since_reconnect += b->data.size();
+            }
+            REQUIRE_FALSE(
+                std::holds_alternative<td365::connection_closed_event>(evt));
+        }
+        REQUIRE(reconnected >= 2);
+        REQUIRE(ticks_since_reconnect > 0);
+
+        auto stats = client.reconnect_stats();
+        REQUIRE(stats.reconnects == static_cast<std::uint64_t>(reconnected));
+        REQUIRE(stats.last_reconnect_duration >
+                std::chrono::nanoseconds::zero());
+        REQUIRE(stats.last_gap >= stats.last_reconnect_duration);
+
+        // each reconnect names the old connection and replays the
+        // subscription
+        REQUIRE(server.get_connection_count() == reconnected + 1);
+        REQUIRE(server.get_reconnect_requests() == reconnected);
+        REQUIRE(server.get_subscribe_requests() == reconnected + 1);
+    }
 
-    // Run server in separate thread
-    std::thread server_thread([&server_ioc]() { server_ioc.run(); });
-
-    // Give server time to start
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-    // Get the actual port the server is listening on
-    unsigned short server_port = server.get_port();
-
-    // Create client with callbacks
-    td365::user_callbacks callbacks;
-    // std::atomic<bool> connection_succeeded = false;
-
-    // Create client on heap to ensure proper lifetime management
-    auto client = std::make_unique<td365::ws_client>(callbacks);
+    shutdown = true;
+    server_ioc.stop();
+    server_thread.join();
+}
 
-    // Test connection with reconnection logic to fake server
-    std::atomic<bool> client_coroutine_done = false;
+TEST_CASE("ws_client gives up once reconnect attempts are exhausted",
+          "[websocket][reconnect][none]") {
+    net::io_context server_ioc;
+    fake_ws_server server(server_ioc, 0);
+    server.set_disconnect_after_connect(true);
+    server.set_disconnect_delay(std::chrono::milliseconds(100));
+    std::atomic<bool> shutdown = false;
     boost::asio::co_spawn(
-        client_ioc,
+        server_ioc,
         [&]() -> boost::asio::awaitable<void> {
-            try {
-                boost::urls::url url("ws://localhost:" +
-                                     std::to_string(server_port));
-                co_await client->run(url, "test_login", "test_token",
-                                     client_shutdown);
-
-            } catch (const std::exception &e) {
-                // Expected when max reconnection attempts are reached
-                spdlog::debug("Client reconnection failed: {}", e.what());
-            }
-            client_coroutine_done = true;
-            co_return;
+            co_await server.run(shutdown);
         },
         boost::asio::detached);
+    std::thread server_thread([&server_ioc] { server_ioc.run(); });
+
+    {
+        td365::ws_client client;
+        client.set_reconnect_options({
+            .initial_delay = std::chrono::milliseconds(10),
+            .max_delay = std::chrono::milliseconds(40),
+            .max_attempts = 3,
+        });
+        client.connect(boost::urls::url("ws://127.0.0.1:" +
+                                        std::to_string(server.get_port())),
+                       "login", "token");
+
+        // nothing to come back to once the drop happens
+        net::post(server_ioc, [&server] { server.stop_accepting(); });
+
+        bool closed = false;
+        auto give_up =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!closed && std::chrono::steady_clock::now() < give_up) {
+            auto evt =
+                client.read_and_process_message(std::chrono::milliseconds(100));
+            REQUIRE_FALSE(
+                std::holds_alternative<td365::reconnected_event>(evt));
+            closed =
+                std::holds_alternative<td365::connection_closed_event>(evt);
+        }
+        REQUIRE(closed);
 
-    // Run client in separate thread
-    std::thread client_thread([&client_ioc]() { client_ioc.run(); });
-
-    // Wait for multiple connection attempts
-    // Server disconnects after 500ms, client should retry with exponential
-    // backoff
-    std::this_thread::sleep_for(std::chrono::seconds(8));
-
-    // Stop everything
-    client_shutdown = true;
-    server_shutdown = true;
+        auto stats = client.reconnect_stats();
+        REQUIRE(stats.reconnects == 0);
+        REQUIRE(stats.failed_attempts == 3);
+        REQUIRE(server.get_connection_count() == 1);
 
-    // Wait for client coroutine to complete
-    while (!client_coroutine_done) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        // stays closed
+        auto evt =
+            client.read_and_process_message(std::chrono::milliseconds(10));
+        REQUIRE(std::holds_alternative<td365::connection_closed_event>(evt));
     }
 
-    // Give some time for cleanup before stopping the contexts
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-    client_ioc.stop();
+    shutdown = true;
     server_ioc.stop();
-
-    if (client_thread.joinable()) {
-        client_thread.join();
-    }
-
-    if (server_thread.joinable()) {
-        server_thread.join();
-    }
-
-    // Now it's safe to destroy the client
-    client.reset();
-
-    // Verify that multiple connections were attempted
-    // Server should have received multiple connection attempts due to
-    // reconnection
-    REQUIRE(server.get_connection_count() > 1);
-
-    spdlog::info("Server received {} connection attempts",
-                 server.get_connection_count());
+    server_thread.join();
 }
-#endif